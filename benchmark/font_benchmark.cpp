@@ -0,0 +1,120 @@
+// Compares how long a CFF font and a glyf font take to load the same glyphs.
+//
+// Usage: zwidget_font_benchmark <cff font> <glyf font> [pixel height] [passes]
+//
+// The glyph set is every character from U+0020 to U+FFFF that both fonts have a glyph for. The first pass also
+// measures the subroutines being decoded for the first time, so it is printed separately from the passes after it.
+
+#include "core/truetypefont.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+static std::shared_ptr<TTFDataBuffer> ReadFontFile(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+		throw std::runtime_error(std::string("Could not open ") + filename);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return TTFDataBuffer::create(std::move(bytes));
+}
+
+struct PassTimes
+{
+	double first = 0.0;
+	double rest = 0.0;
+	int errors = 0;
+};
+
+static PassTimes LoadGlyphs(const TrueTypeFont& font, const std::vector<uint32_t>& glyphs, double height, int passes)
+{
+	PassTimes times;
+	for (int pass = 0; pass < passes; pass++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t glyph : glyphs)
+		{
+			try
+			{
+				font.LoadGlyph(glyph, height);
+			}
+			catch (const std::exception&)
+			{
+				if (pass == 0)
+					times.errors++;
+			}
+		}
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (pass == 0)
+			times.first = ms;
+		else
+			times.rest += ms;
+	}
+	if (passes > 1)
+		times.rest /= passes - 1;
+	return times;
+}
+
+static void PrintTimes(const char* name, const PassTimes& times, size_t count, int passes)
+{
+	printf("%-5s first pass %9.2f ms (%6.2f us/glyph)", name, times.first, times.first * 1000.0 / count);
+	if (passes > 1)
+		printf(", later passes %9.2f ms (%6.2f us/glyph)", times.rest, times.rest * 1000.0 / count);
+	if (times.errors > 0)
+		printf(", %d glyphs failed", times.errors);
+	printf("\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		printf("Usage: %s <cff font> <glyf font> [pixel height] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	double height = argc > 3 ? atof(argv[3]) : 13.0;
+	int passes = argc > 4 ? std::max(atoi(argv[4]), 1) : 20;
+
+	try
+	{
+		TrueTypeFont cff(ReadFontFile(argv[1]));
+		TrueTypeFont glyf(ReadFontFile(argv[2]));
+
+		std::vector<uint32_t> cffGlyphs, glyfGlyphs;
+		for (uint32_t c = 0x20; c < 0x10000; c++)
+		{
+			uint32_t cffGlyph = cff.GetGlyphIndex(c);
+			uint32_t glyfGlyph = glyf.GetGlyphIndex(c);
+			if (cffGlyph != 0 && glyfGlyph != 0)
+			{
+				cffGlyphs.push_back(cffGlyph);
+				glyfGlyphs.push_back(glyfGlyph);
+			}
+		}
+
+		if (cffGlyphs.empty())
+		{
+			printf("The fonts have no characters in common\n");
+			return 1;
+		}
+
+		printf("%d glyphs at %.1f px, %d passes\n", (int)cffGlyphs.size(), height, passes);
+		PassTimes cffTimes = LoadGlyphs(cff, cffGlyphs, height, passes);
+		PassTimes glyfTimes = LoadGlyphs(glyf, glyfGlyphs, height, passes);
+		PrintTimes("CFF", cffTimes, cffGlyphs.size(), passes);
+		PrintTimes("glyf", glyfTimes, glyfGlyphs.size(), passes);
+		if (passes > 1 && glyfTimes.rest > 0.0)
+			printf("CFF takes %.2fx as long as glyf\n", cffTimes.rest / glyfTimes.rest);
+	}
+	catch (const std::exception& e)
+	{
+		printf("%s\n", e.what());
+		return 1;
+	}
+	return 0;
+}
@@ -6,6 +6,8 @@
 #include <vector>
 #include <map>
 #include <cmath>
+#include <algorithm>
+#include <cstdint>
 #include "image.h"
 #include "rect.h"
 
@@ -15,6 +17,8 @@ class Rect;
 class Colorf;
 class DisplayWindow;
 class CanvasFontGroup;
+class CanvasGlyph;
+class TextRunCache;
 
 class CanvasTexture
 {
@@ -41,6 +45,41 @@ struct VerticalTextPosition
 	double bottom = 0.0;
 };
 
+// Text that has been converted to glyphs once so it can be measured, hit tested and drawn repeatedly.
+// All offsets are byte offsets into the string the run was created from.
+class TextRun
+{
+public:
+	size_t size() const { return positions.size() - 1; }
+	bool empty() const { return glyphs.empty(); }
+
+	double getWidth() const { return positions.back() / uiscale; }
+	double getWidth(size_t start, size_t end) const { return (positions[std::min(end, size())] - positions[std::min(start, size())]) / uiscale; }
+	double getPosition(size_t offset) const { return positions[std::min(offset, size())] / uiscale; }
+	double getHeight() const { return lineHeight / uiscale; }
+
+	size_t getCharacterIndex(double x) const;
+
+private:
+	std::vector<CanvasGlyph*> glyphs;  // One glyph per character
+	std::vector<uint32_t> offsets;     // Byte offset of each character
+	std::vector<int32_t> positions;    // Pixel position for each byte offset. Bytes inside a character map to the end of it
+	double uiscale = 1.0;
+	double lineHeight = 0.0;
+
+	friend class Canvas;
+	friend class TextRunCache;
+};
+
+struct TextRunCacheStats
+{
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t entries = 0;
+	size_t bytes = 0;
+	size_t budget = 0;
+};
+
 class Canvas
 {
 public:
@@ -55,6 +94,14 @@ public:
 	virtual void begin(const Colorf& color);
 	virtual void end() { }
 
+	// Starts a frame that keeps the pixels of the previous frame. Only the box, and areas moved by scrollRect, are presented by end.
+	// Returns false when the canvas has no pixels to keep, in which case the whole frame has to be painted after begin.
+	virtual bool beginPartial(const Rect& box) { return false; }
+
+	// Moves the pixels inside the box by dx, dy in a partial frame. The area the pixels moved away from is left as it was.
+	// Returns false when the move is not a whole number of pixels or the canvas cannot move its pixels.
+	bool scrollRect(const Rect& box, double dx, double dy);
+
 	virtual void begin3d() { }
 	virtual void end3d() { }
 
@@ -63,6 +110,7 @@ public:
 
 	void pushClip(const Rect& box);
 	void popClip();
+	Rect getClipBox() const; // Relative to the origin
 
 	void fillRect(const Rect& box, const Colorf& color);
 	void line(const Point& p0, const Point& p1, const Colorf& color);
@@ -74,11 +122,21 @@ public:
 	FontMetrics getFontMetrics(const std::shared_ptr<Font>& font);
 	int getCharacterIndex(const std::shared_ptr<Font>& font, const std::string& text, const Point& hitPoint);
 
+	std::shared_ptr<TextRun> shapeText(const std::shared_ptr<Font>& font, const std::string& text, uint32_t maskChar = 0);
+	std::shared_ptr<TextRun> shapeText(const std::shared_ptr<Font>& font, const std::string& text, const TextRun& previous, size_t unchangedBytes); // previous must be shaped with the same font and share the first unchangedBytes of text
+	std::shared_ptr<TextRun> shapeTextUncached(const std::shared_ptr<Font>& font, const std::string& text, uint32_t maskChar = 0); // Not kept in the text run cache, for text that is unlikely to be shaped again
+	void drawText(const TextRun& run, const Point& pos, const Colorf& color);
+	void drawText(const TextRun& run, const Point& pos, size_t start, size_t end, const Colorf& color);
+	void drawTextEllipsis(const TextRun& run, const Point& pos, const Rect& clipBox, size_t start, size_t end, const Colorf& color);
+
 	void drawImage(const std::shared_ptr<Image>& image, const Point& pos);
 	void drawImage(const std::shared_ptr<Image>& image, const Rect& box);
 	void drawImage(const std::shared_ptr<Image>& image, const Rect& src, const Rect& dest);
 
-	void setLanguage(const char* lang) { language = lang; }
+	void setLanguage(const char* lang);
+
+	TextRunCacheStats getTextRunCacheStats() const;
+	void setTextRunCacheBudget(size_t bytes);
 
 protected:
 	virtual std::unique_ptr<CanvasTexture> createTexture(int width, int height, const void* pixels, ImageFormat format = ImageFormat::B8G8R8A8) = 0;
@@ -86,13 +144,16 @@ protected:
 	virtual void fillTile(float x, float y, float width, float height, Colorf color) = 0;
 	virtual void drawTile(CanvasTexture* texture, float x, float y, float width, float height, float u, float v, float uvwidth, float uvheight, Colorf color) = 0;
 	virtual void drawGlyph(CanvasTexture* texture, float x, float y, float width, float height, float u, float v, float uvwidth, float uvheight, Colorf color) = 0;
+	virtual bool scrollTile(int x0, int y0, int x1, int y1, int dx, int dy) { return false; }
 
 	int getClipMinX() const;
 	int getClipMinY() const;
 	int getClipMaxX() const;
 	int getClipMaxY() const;
 
-	float gridFit(double v) { return (float)std::round(v * uiscale); }
+	// Halfway cases round up even when rounding errors put them slightly below. Otherwise content painted again after
+	// moving by whole pixels could land one pixel off from the pixels moved by scrollRect.
+	float gridFit(double v) { return (float)std::floor(v * uiscale + 0.5 + 1e-6); }
 
 	template<typename T>
 	static T clamp(T val, T minval, T maxval) { return std::max<T>(std::min<T>(val, maxval), minval); }
@@ -108,8 +169,11 @@ private:
 	void drawLineUnclipped(const Point& p0, const Point& p1, const Colorf& color);
 
 	CanvasFontGroup* GetFontGroup(const std::shared_ptr<Font>& font);
+	std::shared_ptr<TextRun> GetTextRun(CanvasFontGroup* canvasFont, const std::string& text, uint32_t maskChar = 0);
+	std::shared_ptr<TextRun> ShapeText(CanvasFontGroup* canvasFont, const std::string& text, uint32_t maskChar, const TextRun* previous = nullptr, size_t unchangedBytes = 0);
 
 	std::map<std::pair<std::string, double>, std::shared_ptr<CanvasFontGroup>> fontCache;
+	uint64_t fontGeneration = 0;
 
 	Point origin;
 	std::vector<Rect> clipStack;
@@ -117,5 +181,7 @@ private:
 	std::unordered_map<std::shared_ptr<Image>, std::unique_ptr<CanvasTexture>> imageTextures;
 	std::string language;
 
+	std::unique_ptr<TextRunCache> textRunCache;
+
 	friend class CanvasFont;
 };
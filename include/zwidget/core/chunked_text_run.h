@@ -0,0 +1,71 @@
+#pragma once
+
+#include "canvas.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// \brief A single line of text shaped in fixed-size chunks
+///
+/// Each chunk keeps its width and the position where it starts once it has been measured. Glyphs are only kept
+/// for the chunks used most recently, so a very long line is only shaped where it is drawn or hit tested.
+class ChunkedTextRun
+{
+public:
+	/// Replaces the text. Only the chunks covering bytes that changed are measured again.
+	void SetText(const std::string& text, const std::shared_ptr<Font>& font, uint32_t maskChar = 0);
+
+	/// Changes the font or mask character, keeping the text
+	void SetFont(const std::shared_ptr<Font>& font, uint32_t maskChar = 0);
+
+	/// Replaces length bytes at the offset. Unlike SetText this does not compare the rest of the text.
+	void ReplaceText(size_t offset, size_t length, const std::string& inserted);
+
+	const std::string& GetText() const { return text; }
+
+	double GetWidth(Canvas* canvas);
+	double GetWidth(Canvas* canvas, size_t start, size_t end);
+	double GetHeight(Canvas* canvas);
+
+	/// Position of the byte offset relative to the start of the text
+	double GetPosition(Canvas* canvas, size_t offset);
+
+	/// Byte offset of the character boundary closest to the position
+	size_t GetCharacterIndex(Canvas* canvas, double x);
+
+	/// Draws the bytes from start to end that fall between minX and maxX. Chunks outside that range are not shaped.
+	void Draw(Canvas* canvas, const Point& pos, size_t start, size_t end, double minX, double maxX, const Colorf& color);
+
+private:
+	struct Chunk
+	{
+		size_t start = 0;
+		size_t length = 0;
+		double x = 0.0;
+		double width = 0.0;
+		bool measured = false;
+		std::shared_ptr<TextRun> run;
+		uint64_t last_used = 0;
+	};
+
+	void Reset();
+	size_t CreateChunks(size_t index, size_t start, size_t end);
+	size_t FindChunk(size_t offset) const;
+	size_t FindChunkAt(Canvas* canvas, double x);
+	void Measure(Canvas* canvas, size_t index);
+	std::shared_ptr<TextRun> GetRun(Canvas* canvas, size_t index);
+	void ReleaseRuns();
+
+	static const size_t ChunkSize = 4096;
+	static const size_t MaxShapedChunks = 32;
+
+	std::string text;
+	std::shared_ptr<Font> font;
+	uint32_t mask_char = 0;
+	std::vector<Chunk> chunks;
+	size_t positioned = 0; // Chunks before this one have been measured and positioned
+	size_t shaped = 0;
+	uint64_t use_counter = 0;
+	double line_height = -1.0;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/// \brief Heights of a list of rows with prefix sums, finding the top of a row or the row at a position in O(log n)
+class RowHeightIndex
+{
+public:
+	void Clear();
+
+	size_t GetCount() const { return heights.size(); }
+	double GetHeight(size_t row) const { return heights[row]; }
+	double GetTotalHeight() const { return GetTop(heights.size()); }
+
+	/// Sum of the heights of the rows before this one
+	double GetTop(size_t row) const;
+
+	/// Row containing the position, or the row count when it is below the last row
+	size_t FindRow(double y) const;
+
+	void SetHeight(size_t row, double height);
+	void Append(double height);
+	void Insert(size_t row, const std::vector<double>& rowHeights);
+	void Remove(size_t row, size_t count);
+
+private:
+	void Rebuild();
+
+	std::vector<double> heights;
+	std::vector<double> tree; // Fenwick tree over the heights. Node i holds the sum of the lowbit(i) rows ending at row i - 1.
+};
@@ -46,6 +46,9 @@ public:
 	void Clear();
 
 	void AddText(const std::string& text, std::shared_ptr<Font> font, const Colorf& color = Colorf(), int id = -1);
+
+	/// Replace the content with a single text object. If the layout already holds one text object with the same font, color and id, only the lines from the first changed word onward are reflowed by the next Layout call.
+	void SetText(const std::string& text, std::shared_ptr<Font> font, const Colorf& color = Colorf(), int id = -1);
 	void AddImage(const std::shared_ptr<Image> image, double baseline_offset = 0, int id = -1);
 	void AddWidget(Widget* component, double baseline_offset = 0, int id = -1);
 
@@ -72,6 +75,10 @@ public:
 	void SetSelectionRange(std::string::size_type start, std::string::size_type end);
 	void SetSelectionColors(const Colorf& foreground, const Colorf& background);
 
+	/// Ranges drawn with the highlight background, for example search matches
+	void SetHighlightRanges(std::vector<std::pair<std::string::size_type, std::string::size_type>> ranges);
+	void SetHighlightColor(const Colorf& background);
+
 	void ShowCursor();
 	void HideCursor();
 
@@ -87,12 +94,6 @@ public:
 	double GetLastBaselineOffset();
 
 private:
-	struct TextBlock
-	{
-		size_t start = 0;
-		size_t end = 0;
-	};
-
 	enum ObjectType
 	{
 		object_text,
@@ -113,6 +114,7 @@ private:
 		FloatType float_type = float_none;
 
 		std::shared_ptr<Font> font;
+		std::shared_ptr<TextRun> run;
 		Colorf color;
 		size_t start = 0, end = 0;
 
@@ -126,8 +128,8 @@ private:
 	struct LineSegment
 	{
 		ObjectType type = object_text;
+		size_t object_index = 0;
 
-		std::shared_ptr<Font> font;
 		Colorf color;
 		size_t start = 0;
 		size_t end = 0;
@@ -135,10 +137,9 @@ private:
 		double descender = 0;
 
 		double x_position = 0;
+		double unaligned_x = 0; // x_position before the alignment moved the segment
 		double width = 0;
 
-		std::shared_ptr<Image> image;
-		Widget* component = nullptr;
 		double baseline_offset = 0;
 
 		int id = -1;
@@ -149,6 +150,7 @@ private:
 		double width = 0;	// Width of the entire line (including spaces)
 		double height = 0;
 		double ascender = 0;
+		size_t first_block = 0;
 		std::vector<LineSegment> segments;
 	};
 
@@ -164,9 +166,21 @@ private:
 		std::vector<LineSegment> segments;
 	};
 
+	struct TextBlock
+	{
+		size_t start = 0;
+		size_t end = 0;
+
+		// Layout state cached between Layout calls
+		size_t object_index = 0;
+		bool measured = false;
+		TextSizeResult size;
+	};
+
 	struct CurrentLine
 	{
 		std::vector<SpanObject>::size_type object_index = 0;
+		std::vector<TextBlock>::size_type next_block = 0;
 		Line cur_line;
 		double x_position = 0;
 		double y_position = 0;
@@ -182,9 +196,13 @@ private:
 	};
 
 	TextSizeResult FindTextSize(Canvas* canvas, const TextBlock& block, size_t object_index);
-	std::vector<TextBlock> FindTextBlocks();
+	void FindTextBlocks(size_t pos);
 	void LayoutLines(Canvas* canvas, double max_width);
-	void LayoutText(Canvas* canvas, std::vector<TextBlock> blocks, std::vector<TextBlock>::size_type block_index, CurrentLine& current_line, double max_width);
+	size_t FindFirstChangedLine(double max_width);
+	bool IsLineUnchanged(size_t first_block, size_t next_block, double max_width);
+	void InvalidateBlocks(size_t pos);
+	TextRun* GetTextRun(Canvas* canvas, size_t object_index);
+	void LayoutText(Canvas* canvas, std::vector<TextBlock>& blocks, std::vector<TextBlock>::size_type block_index, CurrentLine& current_line, double max_width);
 	void LayoutBlock(CurrentLine& current_line, double max_width, std::vector<TextBlock>& blocks, std::vector<TextBlock>::size_type block_index);
 	void LayoutFloatBlock(CurrentLine& current_line, double max_width);
 	void LayoutInlineBlock(CurrentLine& current_line, double max_width, std::vector<TextBlock>& blocks, std::vector<TextBlock>::size_type block_index);
@@ -213,12 +231,23 @@ private:
 
 	std::string::size_type sel_start = 0, sel_end = 0;
 	Colorf sel_foreground, sel_background;
+	std::vector<std::pair<std::string::size_type, std::string::size_type>> highlight_ranges;
+	Colorf highlight_background;
 
 	std::string text;
 	std::vector<SpanObject> objects;
 	std::vector<Line> lines;
 	Point position;
 
+	// Blocks from dirty_block onward must be found and measured again. Lines are kept up to the one containing the block before it.
+	std::vector<TextBlock> blocks;
+	std::vector<TextBlock>::size_type dirty_block = 0;
+	double layout_width = -1.0;
+
+	// Run of the text before SetText changed it. The next shaping reuses its glyphs up to the first changed byte.
+	std::shared_ptr<TextRun> previous_run;
+	size_t previous_run_unchanged = (size_t)-1;
+
 	std::vector<FloatBox> floats_left, floats_right;
 
 	SpanAlign alignment = span_left;
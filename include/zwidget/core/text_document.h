@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/// \brief Read-only text storage referenced by TextDocument without copying
+class TextBuffer
+{
+public:
+	virtual ~TextBuffer() = default;
+
+	virtual const char* GetData() const = 0;
+	virtual size_t GetSize() const = 0;
+
+	static std::shared_ptr<TextBuffer> Create(std::string text);
+
+	/// Maps the file into memory. The file must not be modified while the buffer exists.
+	static std::shared_ptr<TextBuffer> MapFile(const std::string& filename);
+};
+
+/// \brief Describes an edit: the removed range and what replaced it
+struct TextChange
+{
+	size_t start = 0;
+	size_t removed_length = 0;
+	size_t inserted_length = 0;
+
+	// Empty when inserted_omitted is set: the whole text was set or appended to, and copying it for each change would be too expensive.
+	// The inserted text can be read back from the widget instead.
+	std::string inserted;
+	bool inserted_omitted = false;
+
+	// Lines first_line to last_line of the old text were replaced by lines first_line to new_last_line
+	int first_line = 0;
+	int last_line = 0;
+	int new_last_line = 0;
+};
+
+/// \brief Read-only copy of a document's text, usable from other threads while the document is edited
+class TextSnapshot
+{
+public:
+	struct Span
+	{
+		const char* data = nullptr;
+		size_t length = 0;
+	};
+
+	size_t GetSize() const { return size; }
+	const std::vector<Span>& GetSpans() const { return spans; }
+
+private:
+	std::vector<std::shared_ptr<TextBuffer>> buffers;
+	std::vector<Span> spans;
+	size_t size = 0;
+
+	friend class TextDocument;
+};
+
+/// \brief Piece table text document with a line index
+///
+/// The document is a sequence of pieces referring to read-only buffers or to append-only blocks holding all inserted text.
+/// Text is never modified once it is in a buffer, which makes snapshots cheap.
+/// Newline positions are indexed once per buffer, and the pieces are kept in a balanced tree (a treap) where each node
+/// knows the size and newline count of its subtree. Edits and offset/line conversions are therefore O(log n).
+class TextDocument
+{
+public:
+	TextDocument();
+
+	size_t GetSize() const;
+	size_t GetLineCount() const;
+
+	/// Offset of the first character in the line
+	size_t GetLineStart(size_t line) const;
+
+	/// Length of the line, excluding the newline
+	size_t GetLineLength(size_t line) const;
+
+	/// Line containing the offset. An offset at a newline belongs to the line it ends.
+	size_t GetLineFromOffset(size_t offset) const;
+
+	std::string GetText() const;
+	std::string GetText(size_t offset, size_t length) const;
+	std::string GetLineText(size_t line) const;
+
+	void Clear();
+	void Append(std::shared_ptr<TextBuffer> buffer);
+	void Append(const std::string& text);
+	void Insert(size_t offset, const std::string& text);
+	void Erase(size_t offset, size_t length);
+
+	/// Captures the current text without copying it
+	TextSnapshot CreateSnapshot() const;
+
+private:
+	struct Source
+	{
+		std::shared_ptr<TextBuffer> buffer;
+		std::vector<size_t> newlines;
+	};
+
+	struct Piece
+	{
+		uint32_t source = 0;
+		size_t start = 0;
+		size_t length = 0;
+		size_t newlines = 0;
+	};
+
+	struct Node
+	{
+		Piece piece;
+		uint32_t priority = 0;
+		int left = -1;
+		int right = -1;
+
+		// Totals for the subtree
+		size_t length = 0;
+		size_t newlines = 0;
+	};
+
+	const char* GetSourceData(uint32_t source) const;
+	size_t CountNewlines(uint32_t source, size_t start, size_t end) const;
+	Piece CreatePiece(uint32_t source, size_t start, size_t length) const;
+
+	int CreateNode(const Piece& piece);
+	void FreeNodes(int node);
+	void UpdateNode(int node);
+	void Split(int node, size_t offset, int& left, int& right);
+	int Merge(int left, int right);
+	void GetText(int node, size_t offset, size_t length, std::string& text) const;
+	void CreateSnapshot(int node, TextSnapshot& snapshot) const;
+
+	std::vector<Source> sources;
+	uint32_t append_source = 0xffffffff; // Source currently receiving inserted text
+	std::vector<Node> nodes;
+	std::vector<int> free_nodes;
+	int root = -1;
+	uint32_t random_seed = 0x12345678;
+};
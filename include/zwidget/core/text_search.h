@@ -0,0 +1,63 @@
+#pragma once
+
+#include "text_document.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TextSearchOptions
+{
+	bool match_case = true;
+	bool whole_word = false; // Letters, digits, '_' and non-ASCII characters form words
+};
+
+/// \brief Finds all occurrences of a string in a document, optionally on a worker thread
+///
+/// Case insensitive matching only folds ASCII letters.
+class TextSearch
+{
+public:
+	struct Match
+	{
+		size_t offset = 0;
+		size_t length = 0;
+	};
+
+	TextSearch() = default;
+	~TextSearch();
+
+	static std::vector<Match> FindAll(const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options);
+
+	/// Finds the matches starting at or after start and before end. Whole words are still checked against the text outside the range.
+	static std::vector<Match> FindRange(const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options, size_t start, size_t end);
+
+	/// Updates the matches of a finished search after length bytes at offset were replaced by inserted bytes.
+	/// Only the text around the edit is searched again. Returns true if matches were added or removed.
+	static bool UpdateMatches(std::vector<Match>& matches, const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options, size_t offset, size_t length, size_t inserted);
+
+	/// Starts searching the snapshot on a worker thread, stopping any search already running
+	void Start(TextSnapshot snapshot, const std::string& pattern, const TextSearchOptions& options);
+	void Stop();
+
+	/// Waits for the search to finish, keeping the matches for Poll
+	void Wait();
+
+	/// Appends the matches found since the last call. Returns false once the search has finished and everything was taken.
+	bool Poll(std::vector<Match>& matches);
+
+private:
+	TextSearch(const TextSearch&) = delete;
+	TextSearch& operator=(const TextSearch&) = delete;
+
+	static void Search(const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options, size_t start, size_t end, const std::atomic<bool>& stop, const std::function<void(std::vector<Match>& batch)>& onBatch);
+
+	std::thread worker;
+	std::atomic<bool> stop_flag = false;
+
+	std::mutex mutex;
+	std::vector<Match> found;
+	bool running = false;
+};
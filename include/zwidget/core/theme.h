@@ -4,6 +4,8 @@
 #include <string>
 #include <variant>
 #include <unordered_map>
+#include <vector>
+#include <cstdint>
 #include "rect.h"
 #include "colorf.h"
 
@@ -11,6 +13,88 @@ class Widget;
 class Canvas;
 class Font;
 class Image;
+class WidgetStyle;
+
+typedef uint32_t StylePropertyID;
+
+// Interned style property names. The built-in properties have fixed IDs while other names are assigned one on first use.
+namespace StyleProperty
+{
+	enum : StylePropertyID
+	{
+		BackgroundColor,
+		Color,
+		BorderLeftColor,
+		BorderTopColor,
+		BorderRightColor,
+		BorderBottomColor,
+		BorderLeftWidth,
+		BorderTopWidth,
+		BorderRightWidth,
+		BorderBottomWidth,
+		BorderImageSource,
+		BorderLeftImageWidth,
+		BorderTopImageWidth,
+		BorderRightImageWidth,
+		BorderBottomImageWidth,
+		BorderLeftImageSlice,
+		BorderTopImageSlice,
+		BorderRightImageSlice,
+		BorderBottomImageSlice,
+		BorderCenterImageSlice,
+		NoncontentLeft,
+		NoncontentTop,
+		NoncontentRight,
+		NoncontentBottom,
+		FontFamily,
+		FontSize,
+		SelectionColor,
+		NoFocusSelectionColor,
+		WindowBackground,
+		WindowBorder,
+		WindowCaptionColor,
+		WindowCaptionTextColor,
+		SpacerLeft,
+		SpacerRight,
+		ArrowColor,
+		TrackColor,
+		ThumbColor,
+		CheckedColor,
+		CheckedImage,
+		CheckedAlign,
+		CheckedOuterBorderColor,
+		CheckedInnerBorderColor,
+		UncheckedImage,
+		UncheckedAlign,
+		UncheckedOuterBorderColor,
+		UncheckedInnerBorderColor,
+		GridColor,
+		HeaderColor,
+		HeaderBackgroundColor,
+		BuiltinCount
+	};
+
+	StylePropertyID Intern(const std::string& name);
+	const std::string& GetName(StylePropertyID id);
+}
+
+typedef std::variant<bool, int, double, std::string, Colorf, std::shared_ptr<Font>, std::shared_ptr<Image>> StylePropertyVariant;
+
+// All properties of a style class in a single state with the state and parent style fallbacks already applied
+class ResolvedWidgetStyle
+{
+public:
+	const StylePropertyVariant* Find(StylePropertyID id) const { return id < Properties.size() ? Properties[id] : nullptr; }
+
+	WidgetStyle* Style = nullptr;
+	std::shared_ptr<Font> StyleFont;
+
+private:
+	int Generation = 0;
+	std::vector<const StylePropertyVariant*> Properties; // Indexed by StylePropertyID
+
+	friend class WidgetStyle;
+};
 
 class WidgetStyle
 {
@@ -21,6 +105,7 @@ public:
 	virtual void Paint(Widget* widget, Canvas* canvas, Size size) = 0;
 
 	std::shared_ptr<Font> GetFont(const std::string& state);
+	const ResolvedWidgetStyle* GetResolvedStyle(const std::string& state);
 
 	void SetBool(const std::string& state, const std::string& propertyName, bool value);
 	void SetInt(const std::string& state, const std::string& propertyName, int value);
@@ -46,13 +131,15 @@ private:
 	std::shared_ptr<Image> GetImage(const std::string& state, const std::string& propertyName) const;
 
 	WidgetStyle* ParentStyle = nullptr;
-	typedef std::variant<bool, int, double, std::string, Colorf, std::shared_ptr<Font>, std::shared_ptr<Image>> PropertyVariant;
+	typedef StylePropertyVariant PropertyVariant;
 	std::unordered_map<std::string, std::unordered_map<std::string, PropertyVariant>> StyleProperties;
 	std::unordered_map<std::string, std::shared_ptr<Font>> Fonts;
+	std::unordered_map<std::string, std::unique_ptr<ResolvedWidgetStyle>> ResolvedStyles;
 
 	const PropertyVariant* FindProperty(const std::string& state, const std::string& propertyName) const;
 
 	friend class Widget;
+	friend class WidgetTheme;
 };
 
 class BasicWidgetStyle : public WidgetStyle
@@ -73,7 +160,12 @@ public:
 	static void SetTheme(std::unique_ptr<WidgetTheme> theme);
 	static WidgetTheme* GetTheme();
 
+	// Incremented every time the theme, one of its registered styles or a style property changes
+	static int GetGeneration();
+
 private:
+	void ResolveStyles();
+
 	std::unordered_map<std::string, std::unique_ptr<WidgetStyle>> Styles;
 };
 
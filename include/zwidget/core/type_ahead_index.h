@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/// \brief Finds the rows whose text starts with or contains a string
+///
+/// Case insensitive matching only folds ASCII letters. Prefixes are found in a list of the rows sorted by their text,
+/// substrings through the lists of rows containing each sequence of three bytes.
+class TypeAheadIndex
+{
+public:
+	/// Clears the index when the mode changes
+	void SetMatchSubstring(bool enable);
+	bool IsMatchSubstring() const { return match_substring; }
+
+	void Clear();
+	void Build(int count, const std::function<std::string(int row)>& getText);
+
+	/// Rows matching the pattern in ascending order. An empty pattern matches all rows.
+	std::vector<int> FindAll(const std::string& pattern) const;
+
+	/// First row at or after the start row matching the pattern, wrapping around at the end. Returns -1 when no row matches.
+	int FindNext(const std::string& pattern, int start) const;
+
+	/// Matches a single text without an index
+	static bool Matches(const std::string& text, const std::string& pattern, bool matchSubstring);
+
+private:
+	std::string_view GetText(int row) const { return std::string_view(texts.data() + offsets[row], offsets[row + 1] - offsets[row] - 1); }
+	int GetCount() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+
+	static std::string Fold(std::string text);
+	static uint32_t GetTrigram(const char* text) { return (uint8_t)text[0] | ((uint8_t)text[1] << 8) | ((uint8_t)text[2] << 16); }
+
+	bool match_substring = false;
+	std::string texts; // Folded text of all rows, each followed by a zero byte
+	std::vector<size_t> offsets;
+	std::vector<int> sorted; // Rows in the order of their text when matching prefixes
+	std::unordered_map<uint32_t, std::vector<int>> trigrams; // Rows containing each sequence when matching substrings
+};
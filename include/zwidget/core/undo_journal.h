@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+/// \brief Undo/redo history storing each edit as the text it removed and inserted at an offset
+class UndoJournal
+{
+public:
+	struct Edit
+	{
+		size_t offset = 0;
+		std::string removed;
+		std::string inserted;
+	};
+
+	/// Records an edit that has been applied. Typing edits continuing the previous typing edit are merged into it.
+	void Record(size_t offset, std::string removed, std::string inserted, bool typingEdit = false);
+
+	/// Stops the next typing edit from being merged with the previous one (the cursor moved, etc.)
+	void EndTyping();
+
+	void Clear();
+
+	bool CanUndo() const;
+	bool CanRedo() const;
+
+	/// Returns the edit to revert, or null if there is nothing to undo
+	const Edit* Undo();
+
+	/// Returns the edit to apply again, or null if there is nothing to redo
+	const Edit* Redo();
+
+	/// Oldest edits are discarded when the journal holds more text than this
+	void SetMemoryLimit(size_t bytes);
+	size_t GetMemoryUsage() const { return memory_used; }
+
+private:
+	void DiscardOldEdits();
+
+	std::deque<Edit> edits;
+	size_t position = 0; // Number of edits currently applied
+	size_t memory_used = 0;
+	size_t memory_limit = 16 * 1024 * 1024;
+	bool typing = false;
+};
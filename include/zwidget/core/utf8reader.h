@@ -22,6 +22,7 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 /// \brief UTF8 reader helper functions.
 class UTF8Reader
@@ -59,17 +60,15 @@ public:
 		return utf8_length(text.data(), text.size());
 	}
 
-	static size_t utf8_length(const std::string::value_type* text, std::string::size_type length)
-	{
-		UTF8Reader reader(text, length);
-		size_t i = 0; 
-		while (!reader.is_end())
-		{
-			reader.next();
-			i++;
-		}
-		return i;
-	}
+	static size_t utf8_length(const std::string::value_type* text, std::string::size_type length);
+
+	/// \brief Decodes all characters in the text
+	///
+	/// Gives the same result as stepping through the text with character() and next(), with ASCII runs converted in bulk.
+	/// \param out Receives the characters. Must have room for length entries.
+	/// \param byteOffsets Receives the byte offset of each character. Can be null.
+	/// \return Number of characters decoded
+	static size_t decode(const std::string::value_type* text, std::string::size_type length, uint32_t* out, uint32_t* byteOffsets);
 
 private:
 	std::string::size_type current_position = 0;
@@ -10,6 +10,7 @@
 #include "canvas.h"
 #include "rect.h"
 #include "colorf.h"
+#include "theme.h"
 
 class Canvas;
 class Timer;
@@ -51,10 +52,10 @@ public:
 
 	// Widget noncontent area
 	void SetNoncontentSizes(double left, double top, double right, double bottom);
-	double GetNoncontentLeft() const { return GridFitSize(GetStyleDouble("noncontent-left")); }
-	double GetNoncontentTop() const { return GridFitSize(GetStyleDouble("noncontent-top")); }
-	double GetNoncontentRight() const { return GridFitSize(GetStyleDouble("noncontent-right")); }
-	double GetNoncontentBottom() const { return GridFitSize(GetStyleDouble("noncontent-bottom")); }
+	double GetNoncontentLeft() const { return GridFitSize(GetStyleDouble(StyleProperty::NoncontentLeft)); }
+	double GetNoncontentTop() const { return GridFitSize(GetStyleDouble(StyleProperty::NoncontentTop)); }
+	double GetNoncontentRight() const { return GridFitSize(GetStyleDouble(StyleProperty::NoncontentRight)); }
+	double GetNoncontentBottom() const { return GridFitSize(GetStyleDouble(StyleProperty::NoncontentBottom)); }
 
 	// Get the DPI scale factor for the window the widget is located on
 	double GetDpiScale() const;
@@ -74,8 +75,11 @@ public:
 	void SetFrameGeometry(const Rect& geometry);
 	void SetFrameGeometry(double x, double y, double width, double height) { SetFrameGeometry(Rect::xywh(x, y, width, height)); }
 
+	// Moves the frame box without changing its size. The widget is only laid out again if its content box changes size.
+	void SetFramePosition(const Point& pos);
+
 	// Get the UI font for this widget
-	std::shared_ptr<Font> GetFont() const;
+	const std::shared_ptr<Font>& GetFont() const;
 
 	// Style properties
 	void SetStyleClass(const std::string& styleClass);
@@ -95,6 +99,20 @@ public:
 	Colorf GetStyleColor(const std::string& propertyName) const;
 	std::shared_ptr<Image> GetStyleImage(const std::string& propertyName) const;
 
+	// Style properties by interned ID (see StyleProperty)
+	void SetStyleBool(StylePropertyID id, bool value);
+	void SetStyleInt(StylePropertyID id, int value);
+	void SetStyleDouble(StylePropertyID id, double value);
+	void SetStyleString(StylePropertyID id, const std::string& value);
+	void SetStyleColor(StylePropertyID id, const Colorf& value);
+	void SetStyleImage(StylePropertyID id, const std::shared_ptr<Image>& value);
+	bool GetStyleBool(StylePropertyID id) const;
+	int GetStyleInt(StylePropertyID id) const;
+	double GetStyleDouble(StylePropertyID id) const;
+	std::string GetStyleString(StylePropertyID id) const;
+	Colorf GetStyleColor(StylePropertyID id) const;
+	std::shared_ptr<Image> GetStyleImage(StylePropertyID id) const;
+
 	void SetWindowBackground(const Colorf& color);
 	void SetWindowBorderColor(const Colorf& color);
 	void SetWindowCaptionColor(const Colorf& color);
@@ -118,6 +136,13 @@ public:
 	void Update();
 	void Repaint();
 
+	// Only repaints the part of the widget in the box, given in content coordinates
+	void Update(const Rect& box);
+
+	// Moves the pixels already painted in the box by dx, dy and only repaints the area they moved away from.
+	// The widget must paint the same pixels at their new position. The whole box is repainted while a widget is on top of it.
+	void ScrollRect(const Rect& box, double dx, double dy);
+
 	bool HasFocus();
 	bool IsEnabled();
 	bool IsVisible();
@@ -238,6 +263,9 @@ private:
 	void Paint(Canvas* canvas);
 	void DetachFromParent();
 	void CheckInitialShow();
+	void UpdateContentGeometry();
+	bool MapToWindowBox(const Rect& box, Rect& result) const;
+	bool IsCoveredInWindow(const Rect& windowBox) const;
 
 	WidgetType Type = {};
 
@@ -257,6 +285,18 @@ private:
 	std::vector<std::shared_ptr<Image>> WindowIcon;
 	std::unique_ptr<DisplayWindow> DispWindow;
 	std::unique_ptr<Canvas> DispCanvas;
+
+	// What the next frame of a window has to paint. Update repaints everything, while Update(box) and ScrollRect only repaint areas of it.
+	// The areas are kept as a few separate boxes, so that a scrollbar and the strip a scroll exposes do not merge into the box around both.
+	struct RepaintScroll
+	{
+		Rect box;
+		double dx = 0.0;
+		double dy = 0.0;
+	};
+	bool RepaintAll = true;
+	std::vector<Rect> RepaintBoxes;
+	std::vector<RepaintScroll> RepaintScrolls;
 	bool DispGeometrySet = false;
 	Widget* FocusWidget = nullptr;
 	Widget* KeyboardLockWidget = nullptr;
@@ -273,7 +313,11 @@ private:
 	std::string StyleClass = "widget";
 	std::string StyleState;
 	typedef std::variant<bool, int, double, std::string, Colorf, std::shared_ptr<Image>> PropertyVariant;
-	std::unordered_map<std::string, PropertyVariant> StyleProperties;
+	std::unordered_map<StylePropertyID, PropertyVariant> StyleProperties;
+
+	const ResolvedWidgetStyle* GetResolvedStyle() const;
+	mutable const ResolvedWidgetStyle* ResolvedStyle = nullptr;
+	mutable int ResolvedStyleGeneration = 0;
 
 	Widget(const Widget&) = delete;
 	Widget& operator=(const Widget&) = delete;
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "../../core/widget.h"
+#include "../../core/row_height_index.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Scrollbar;
+class DataGrid;
+
+/// \brief Cells shown by a DataGrid
+///
+/// Grids only ask for the cells they show. Models tell their grids about changes through the protected notification functions.
+class DataGridModel
+{
+public:
+	virtual ~DataGridModel() = default;
+
+	virtual int GetRowCount() const = 0;
+	virtual int GetColumnCount() const = 0;
+	virtual std::string GetCellText(int row, int column) const = 0;
+	virtual std::string GetColumnTitle(int column) const { return {}; }
+
+	/// Draws a cell instead of its text. Returns false to let the grid draw the text.
+	virtual bool PaintCell(Canvas* canvas, int row, int column, const Rect& box) const { return false; }
+
+protected:
+	void CellsChanged();
+	void ModelReset(); // The number of rows or columns changed
+
+private:
+	std::vector<DataGrid*> views;
+
+	friend class DataGrid;
+};
+
+/// \brief Grid of cells that scrolls in both directions
+///
+/// Only the cells in view are asked for and drawn. Column widths are kept with their prefix sums, so finding the
+/// columns in view takes O(log n) however many columns there are. The first rows and columns can be frozen so that
+/// they stay in view when scrolling.
+class DataGrid : public Widget
+{
+public:
+	DataGrid(Widget* parent = nullptr);
+	~DataGrid();
+
+	void SetModel(std::shared_ptr<DataGridModel> model);
+	DataGridModel* GetModel() const { return model.get(); }
+
+	/// Shows the column titles above the cells
+	void ShowHeader(bool value);
+
+	void SetFrozenRows(int count);
+	void SetFrozenColumns(int count);
+	int GetFrozenRows() const { return frozenRows; }
+	int GetFrozenColumns() const { return frozenColumns; }
+
+	/// Width of the columns that have not been given one with SetColumnWidth or by resizing them, including columns added later
+	void SetDefaultColumnWidth(double width);
+	void SetColumnWidth(int column, double width);
+	double GetColumnWidth(int column) const { return columnWidths.GetHeight(column); }
+
+	int GetRowCount() const { return rowCount; }
+	int GetColumnCount() const { return (int)columnWidths.GetCount(); }
+
+	int GetSelectedRow() const { return selectedRow; }
+	int GetSelectedColumn() const { return selectedColumn; }
+	void SetSelectedCell(int row, int column, bool notify = true);
+
+	void ScrollToCell(int row, int column);
+
+	/// Finds the cell at a position. Returns false when the position is not over a cell.
+	bool GetCellAt(const Point& pos, int& row, int& column);
+
+	static double GetRowHeight() { return 20.0; }
+
+	std::function<void(int row, int column)> OnChanged;
+	std::function<void(int row, int column)> OnActivated;
+
+protected:
+	void OnPaint(Canvas* canvas) override;
+	bool OnMouseDown(const Point& pos, InputKey key) override;
+	bool OnMouseDoubleclick(const Point& pos, InputKey key) override;
+	bool OnMouseUp(const Point& pos, InputKey key) override;
+	void OnMouseMove(const Point& pos) override;
+	bool OnMouseWheel(const Point& pos, InputKey key) override;
+	void OnKeyDown(InputKey key) override;
+	void OnGeometryChanged() override;
+
+private:
+	void PaintCells(Canvas* canvas, const Rect& region, int firstRow, int endRow, int firstColumn, int endColumn, double scrollX, double scrollY);
+	void PaintHeader(Canvas* canvas, const Rect& clip, int firstColumn, int endColumn, double scrollX);
+
+	double GetViewWidth() const;
+	double GetViewHeight() const;
+	double GetHeaderHeight() const { return headerVisible ? GetRowHeight() : 0.0; }
+	double GetFrozenWidth() const;
+	double GetFrozenHeight() const;
+	int GetColumnResizeHandle(const Point& pos);
+
+	void UpdateColumnCount();
+	void UpdateScrollRanges();
+	void ScrollPaintedCells();
+	void OnScrollbarScroll();
+
+	void OnCellsChanged();
+	void OnModelReset();
+
+	Scrollbar* vertScrollbar = nullptr;
+	Scrollbar* horzScrollbar = nullptr;
+
+	std::shared_ptr<DataGridModel> model;
+	int rowCount = 0;
+	RowHeightIndex columnWidths; // Used with the columns as its rows
+	std::vector<bool> columnWidthSet; // Columns whose width no longer follows the default width
+	double defaultColumnWidth = 100.0;
+
+	bool headerVisible = true;
+	int frozenRows = 0;
+	int frozenColumns = 0;
+
+	int selectedRow = -1;
+	int selectedColumn = -1;
+
+	// Scroll position of the cells on screen, so that scrolling can move them instead of painting them again
+	double paintedScrollX = 0.0;
+	double paintedScrollY = 0.0;
+
+	int resizeColumn = -1; // Column whose width is being dragged in the header
+	double resizeStartX = 0.0;
+	double resizeStartWidth = 0.0;
+
+	friend class DataGridModel;
+};
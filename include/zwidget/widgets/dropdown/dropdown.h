@@ -7,12 +7,44 @@
 #include "../../core/widget.h"
 #include "../../widgets/listview/listview.h"
 
+class Dropdown;
+
+/// \brief Shows the items of a Dropdown in its list without copying them
+class DropdownItemModel : public ListViewModel
+{
+public:
+	DropdownItemModel(const std::vector<std::string>& items) : items(items) { }
+
+	int GetRowCount() const override { return (int)items.size(); }
+	std::string GetCellText(int row, int column) const override { return column == 0 ? items[row] : std::string(); }
+
+	using ListViewModel::RowsAboutToChange;
+	using ListViewModel::RowsChanged;
+	using ListViewModel::RowsInserted;
+	using ListViewModel::RowsRemoved;
+	using ListViewModel::ModelReset;
+
+private:
+	const std::vector<std::string>& items;
+};
+
+class DropdownPopup : public Widget
+{
+public:
+	DropdownPopup(Widget* parent, Dropdown* owner);
+	~DropdownPopup();
+
+private:
+	Dropdown* owner = nullptr;
+};
+
 class DropdownList : public ListView
 {
 public:
 	DropdownList(Widget* parent, Dropdown* owner);
 protected:
 	void OnKeyDown(InputKey key) override;
+	void OnKeyChar(std::string chars) override;
 	Dropdown* owner;
 };
 
@@ -20,6 +52,7 @@ class Dropdown : public Widget
 {
 public:
 	Dropdown(Widget* parent);
+	~Dropdown();
 
 	void AddItem(const std::string& text, int index = -1);
 	bool UpdateItem(const std::string& text, int index);
@@ -30,6 +63,9 @@ public:
 	void SetMaxDisplayItems(int items);
 	void SetDropdownDirection(bool below);
 
+	/// Typing selects the next matching item, or opens the list with only the matching items shown
+	void SetTypeAhead(ListViewTypeAhead mode, bool matchSubstring = false);
+
 	int GetSelectedItem() const { return selectedItem; }
 	void SetSelectedItem(int index);
 
@@ -42,6 +78,7 @@ protected:
 	void OnPaint(Canvas* canvas) override;
 	bool OnMouseDown(const Point& pos, InputKey key) override;
 	void OnKeyDown(InputKey key) override;
+	void OnKeyChar(std::string chars) override;
 	void OnGeometryChanged() override;
 	void OnLostFocus() override;
 	void Notify(Widget* source, const WidgetEvent type) override;
@@ -51,19 +88,30 @@ private:
 	bool OpenDropdown();
 	bool CloseDropdown();
 	void OnDropdownActivated();
+	void MoveSelection(int delta);
+	void SetTypeAheadText(const std::string& text);
+	int FindTypeAheadMatch();
 
 	size_t GetDisplayItems();
 
 	std::vector<std::string> items;
+	std::shared_ptr<DropdownItemModel> itemModel;
 	int selectedItem = -1;
 	std::string text;
 
 	bool dropdownOpen = false;
-	Widget* dropdown = nullptr;
+	DropdownPopup* dropdown = nullptr; // Hidden while the dropdown is closed
 	DropdownList* listView = nullptr;
 
 	int maxDisplayItems = 0;
 	bool dropdownDirection = true;
 
+	ListViewTypeAhead typeAheadMode = ListViewTypeAhead::Select;
+	std::string typeAheadText;
+	std::chrono::steady_clock::time_point typeAheadTime;
+	TypeAheadIndex typeAheadIndex;
+	bool typeAheadIndexChanged = true;
+
 	friend DropdownList;
+	friend DropdownPopup;
 };
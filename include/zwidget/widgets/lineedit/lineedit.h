@@ -3,6 +3,9 @@
 
 #include "../../core/widget.h"
 #include "../../core/timer.h"
+#include "../../core/undo_journal.h"
+#include "../../core/text_document.h"
+#include "../../core/chunked_text_run.h"
 #include <functional>
 
 class LineEdit : public Widget
@@ -63,10 +66,16 @@ public:
 	void SetInputMask(const std::string& mask);
 	void SetDecimalCharacter(const std::string& decimal_char);
 
+	bool CanUndo() const;
+	bool CanRedo() const;
+	void Undo();
+	void Redo();
+
 	std::function<bool(InputKey key)> FuncIgnoreKeyDown;
 	std::function<std::string(std::string text)> FuncFilterKeyChar;
 	std::function<void()> FuncBeforeEditChanged;
 	std::function<void()> FuncAfterEditChanged;
+	std::function<void(const TextChange& change)> FuncTextChanged;
 	std::function<void()> FuncSelectionChanged;
 	std::function<void()> FuncFocusGained;
 	std::function<void()> FuncFocusLost;
@@ -93,17 +102,16 @@ private:
 
 	void Move(int steps, bool ctrl, bool shift);
 	bool InsertText(int pos, const std::string& str);
+	void ApplyEdit(size_t offset, size_t length, const std::string& newtext);
+	void NotifyTextChanged(size_t offset, size_t length, const std::string& newtext);
 	void Backspace();
 	void Del();
 	int GetCharacterIndex(double x);
 	int FindNextBreakCharacter(int pos);
 	int FindPreviousBreakCharacter(int pos);
-	std::string GetVisibleTextBeforeSelection();
-	std::string GetVisibleTextAfterSelection();
-	std::string GetVisibleSelectedText();
-	std::string CreatePassword(std::string::size_type num_letters) const;
-	Size GetVisualTextSize(Canvas* canvas, int pos, int npos) const;
-	Size GetVisualTextSize(Canvas* canvas) const;
+	ChunkedTextRun& GetTextRun(Canvas* canvas);
+	Size GetVisualTextSize(Canvas* canvas, int pos, int npos);
+	Size GetVisualTextSize(Canvas* canvas);
 	Rect GetCursorRect();
 	Rect GetSelectionRect();
 	bool InputMaskAcceptsInput(int cursor_pos, const std::string& str);
@@ -142,19 +150,9 @@ private:
 	int clip_start_offset = 0;
 	int clip_end_offset = 0;
 
-	struct UndoInfo
-	{
-		/* set undo text when:
-		   - added char after moving
-		   - destructive block operation (del, cut etc)
-		   - beginning erase
-		*/
-		std::string undo_text;
-		bool first_erase = false;
-		bool first_text_insert = false;
-	};
-	
-	UndoInfo undo_info;
+	ChunkedTextRun text_run;
+
+	UndoJournal undo_journal;
 
 	bool select_all_on_focus_gain = true;
 
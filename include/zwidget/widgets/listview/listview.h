@@ -2,20 +2,132 @@
 #pragma once
 
 #include "../../core/widget.h"
+#include "../../core/row_height_index.h"
+#include "../../core/type_ahead_index.h"
 #include <vector>
+#include <memory>
 #include <functional>
 #include <initializer_list>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
 
+class Timer;
 class Scrollbar;
 class Dropdown;
+class ListView;
 class ListViewItem;
+class ListViewItemModel;
 class ListViewHeader;
 class ListViewBody;
 
+/// \brief Rows shown by a ListView
+///
+/// Views only ask for the rows they show. Models tell their views about changes through the protected notification functions.
+/// A view that sorts or filters reads GetCellText from a worker thread, so models call RowsAboutToChange before changing any rows.
+class ListViewModel
+{
+public:
+	virtual ~ListViewModel() = default;
+
+	virtual int GetRowCount() const = 0;
+	virtual std::string GetCellText(int row, int column) const = 0;
+
+	/// Only used by views with variable row heights
+	virtual double GetRowHeight(int row) const;
+
+	/// Draws a cell instead of its text. Returns false to let the view draw the text.
+	virtual bool PaintCell(Canvas* canvas, int row, int column, const Rect& box) const { return false; }
+
+protected:
+	void RowsAboutToChange();
+	void RowsChanged(int first, int count);
+	void RowsInserted(int first, int count);
+	void RowsRemoved(int first, int count);
+	void ModelReset();
+
+private:
+	std::vector<ListView*> views;
+
+	friend class ListView;
+};
+
+/// \brief Sorts and filters the rows of a model on a worker thread
+class ListViewSorter
+{
+public:
+	struct Options
+	{
+		int column = -1; // Rows keep the model order when negative
+		bool ascending = true;
+		std::function<bool(const std::string& a, const std::string& b)> less; // Compares the bytes when not set
+		std::function<bool(int row)> filter; // Called on the worker thread
+	};
+
+	ListViewSorter() = default;
+	~ListViewSorter();
+
+	/// Starts arranging the rows, stopping the request that is still running
+	void Start(std::shared_ptr<ListViewModel> model, const Options& options);
+	void Stop();
+
+	bool IsRunning() const { return worker.joinable(); }
+
+	/// Gets the progress from 0 to 1. Returns true with the model rows in view order once the worker has finished.
+	bool Poll(double& progress, std::vector<int>& rows);
+
+private:
+	ListViewSorter(const ListViewSorter&) = delete;
+	ListViewSorter& operator=(const ListViewSorter&) = delete;
+
+	static bool Arrange(const ListViewModel* model, int rowCount, const Options& options, const std::atomic<bool>& stop, const std::function<void(double)>& onProgress, std::vector<int>& rows);
+
+	std::thread worker;
+	std::atomic<bool> stopFlag = false;
+
+	std::mutex mutex;
+	double progress = 0.0;
+	bool finished = false;
+	std::vector<int> result;
+};
+
+enum class ListViewTypeAhead
+{
+	None,
+	Select, // Typing selects the next row matching the typed text
+	Filter // Typing hides the rows not matching the typed text
+};
+
 class ListView : public Widget
 {
 public:
 	ListView(Widget* parent = nullptr);
+	~ListView();
+
+	/// Shows the rows of the model. The item functions edit the built-in model, which is shown again when the model is set to null.
+	void SetModel(std::shared_ptr<ListViewModel> model);
+	ListViewModel* GetModel() const { return model.get(); }
+
+	/// Rows take the height the model gives them instead of all having the same height
+	void SetVariableRowHeight(bool enable);
+	bool IsVariableRowHeight() const { return variableRowHeight; }
+
+	/// Sorts the rows by the text of a column on a worker thread. The rows are shown in model order when the column is negative.
+	void SortByColumn(int column, bool ascending = true, std::function<bool(const std::string& a, const std::string& b)> less = {});
+	int GetSortColumn() const { return sortOptions.column; }
+	bool IsSortAscending() const { return sortOptions.ascending; }
+
+	/// Only shows the model rows the filter accepts. The filter is called on a worker thread. All rows are shown when it is null.
+	void SetFilter(std::function<bool(int row)> filter);
+
+	/// Matches typed text against the start of a column, or anywhere in it, ignoring the case of ASCII letters
+	void SetTypeAhead(ListViewTypeAhead mode, bool matchSubstring = false, int column = 0);
+	ListViewTypeAhead GetTypeAhead() const { return typeAheadMode; }
+
+	const std::string& GetTypeAheadText() const { return typeAheadText; }
+	void SetTypeAheadText(const std::string& text);
 
 	void ClearColumns();
 	void SetColumn(int index, const std::string& text, double width);
@@ -28,9 +140,15 @@ public:
 	void AddItem(std::initializer_list<std::string> columns, int index = -1);
 	void AddItem(const std::string& text, int index = -1, int column = 0);
 	void UpdateItem(const std::string& text, int index, int column = 0);
+	void SetItemHeight(int index, double height);
 	void RemoveItem(int index = -1);
 
-	size_t GetItemCount() const { return items.size(); }
+	size_t GetItemCount() const { return model->GetRowCount(); }
+	size_t GetShownItemCount() const { return GetViewRowCount(); }
+
+	/// Model row shown at a position, and the position a model row is shown at or -1 when it is filtered out
+	int GetShownItem(int position) const { return ToModelRow(position); }
+	int GetShownPosition(int index) const { return ToViewRow(index); }
 
 	int GetSelectedItem() const { return selectedItem; }
 	void SetSelectedItem(int index, bool notify = true);
@@ -45,23 +163,74 @@ public:
 
 	std::function<void(int)> OnChanged;
 	std::function<void()> OnActivated;
+	std::function<void(double)> OnSortProgress; // Called with 1 once the new order is shown
 
 protected:
 	void OnGeometryChanged() override;
 	void OnKeyDown(InputKey key) override;
+	void OnKeyChar(std::string chars) override;
 	void OnScrollbarScroll();
 
 private:
 	double GetHeaderHeight();
+	void UpdateScrollRanges();
+	void UpdateRowHeights();
+	void ScrollPaintedRows();
+
+	double GetRowTop(int row);
+	double GetRowHeight(int row);
+	int GetRowAt(double y);
+
+	int GetViewRowCount() const;
+	int ToModelRow(int viewRow) const;
+	int ToViewRow(int modelRow) const;
+	void SetViewRows(std::vector<int> rows);
+	void UpdateViewPositions();
+	bool IsSortedOrFiltered() const;
+	ListViewSorter::Options GetSorterOptions() const;
+	void RestartSort();
+	void OnSortTimerExpired();
+
+	void UpdateTypeAheadIndex();
+	int FindTypeAheadMatch();
+
+	void OnRowsAboutToChange();
+	void OnRowsChanged(int first, int count);
+	void OnRowsInserted(int first, int count);
+	void OnRowsRemoved(int first, int count);
+	void OnModelReset();
 
 	ListViewHeader* header = nullptr;
 	ListViewBody* body = nullptr;
 	Scrollbar* scrollbar = nullptr;
 
-	std::vector<std::unique_ptr<ListViewItem>> items;
-	int selectedItem = 0;
+	std::shared_ptr<ListViewItemModel> items;
+	std::shared_ptr<ListViewModel> model;
+	bool scrollRangesChanged = false;
+	double paintedScroll = 0.0; // Scroll position of the rows on screen, so that scrolling can move them instead of painting them again
+	int selectedItem = 0; // Model row, which stays selected when rows are sorted, filtered, inserted or removed
+
+	bool variableRowHeight = false;
+	bool rowHeightsChanged = false;
+	RowHeightIndex rowHeights; // Rows appended to the model since the last update are not in the index yet
+
+	ListViewSorter sorter;
+	ListViewSorter::Options sortOptions;
+	Timer* sortTimer = nullptr;
+	bool sortPending = false; // Waiting for the next timer tick to start the sorter, so that a burst of changes only sorts once
+	bool sorted = false; // Rows are shown in the order of viewRows instead of the model order
+	std::vector<int> viewRows; // Model row shown at each position
+	std::vector<int> viewPositions; // Position of each model row, or -1 when it is filtered out
+
+	ListViewTypeAhead typeAheadMode = ListViewTypeAhead::Select;
+	int typeAheadColumn = 0;
+	std::string typeAheadText;
+	std::chrono::steady_clock::time_point typeAheadTime;
+	TypeAheadIndex typeAheadIndex;
+	bool typeAheadIndexChanged = true;
 
 	friend class ListViewBody;
+	friend class ListViewModel;
 };
 
 class ListViewBody : public Widget
@@ -77,6 +246,7 @@ private:
 	bool OnMouseDoubleclick(const Point& pos, InputKey key) override;
 	bool OnMouseWheel(const Point& pos, InputKey key) override;
 	void OnKeyDown(InputKey key) override;
+	void OnKeyChar(std::string chars) override;
 
 	ListView* listview = nullptr;
 };
@@ -111,4 +281,22 @@ class ListViewItem
 {
 public:
 	std::vector<std::string> columns;
+	double height = 0.0; // Default height if zero
+};
+
+/// \brief Model holding the rows added with the ListView item functions
+class ListViewItemModel : public ListViewModel
+{
+public:
+	int GetRowCount() const override { return (int)items.size(); }
+	std::string GetCellText(int row, int column) const override;
+	double GetRowHeight(int row) const override;
+
+	void AddItem(ListViewItem item, int index = -1);
+	void UpdateItem(const std::string& text, int index, int column);
+	void SetItemHeight(int index, double height);
+	void RemoveItem(int index);
+
+private:
+	std::vector<ListViewItem> items;
 };
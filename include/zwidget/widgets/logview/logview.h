@@ -0,0 +1,116 @@
+#pragma once
+
+#include "../../core/widget.h"
+#include "../../core/timer.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Scrollbar;
+
+enum class LogSeverity
+{
+	Debug,
+	Info,
+	Warning,
+	Error
+};
+
+/// \brief Read-only view of an append-only log
+///
+/// Lines are kept in a bounded ring buffer. Once it reaches the line or byte limit the oldest lines are dropped.
+/// Lines can be added from any thread. They are queued and moved into the view once per frame, and only the
+/// visible lines are drawn.
+class LogView : public Widget
+{
+public:
+	LogView(Widget* parent);
+	~LogView();
+
+	/// Adds text that may contain several lines. A trailing partial line is kept until the text completing it arrives.
+	void AddText(const std::string& text, LogSeverity severity = LogSeverity::Info);
+	void AddLine(const std::string& text, LogSeverity severity = LogSeverity::Info);
+	void AddLine(const std::string& text, const Colorf& color);
+	void Clear();
+
+	/// Maximum number of lines and total bytes of text kept
+	void SetLimits(size_t maxLines, size_t maxBytes);
+	size_t GetMaxLines() const { return max_lines; }
+	size_t GetMaxBytes() const { return max_bytes; }
+
+	void SetSeverityColor(LogSeverity severity, const Colorf& color);
+
+	/// Keeps the last line in view as lines are added. Scrolling to the end turns it back on.
+	void SetFollowTail(bool enable = true);
+	bool IsFollowingTail() const { return follow_tail; }
+
+	size_t GetLineCount() const { return line_count; }
+	std::string GetLineText(size_t index) const;
+	LogSeverity GetLineSeverity(size_t index) const;
+
+protected:
+	void OnPaint(Canvas* canvas) override;
+	bool OnMouseDown(const Point& pos, InputKey key) override;
+	bool OnMouseWheel(const Point& pos, InputKey key) override;
+	void OnKeyDown(InputKey key) override;
+	void OnGeometryChanged() override;
+
+private:
+	struct Line
+	{
+		size_t offset = 0;
+		uint32_t length = 0;
+		LogSeverity severity = LogSeverity::Info;
+		bool custom_color = false;
+		uint32_t color = 0;
+	};
+
+	void QueueLine(const char* text, size_t length, LogSeverity severity, bool customColor, uint32_t color);
+	void OnFlushTimerExpired();
+	void Append(const char* text, size_t length, const Line& info);
+	void RemoveFirstLine();
+	const Line& GetLine(size_t index) const { return lines[(first_line + index) % lines.size()]; }
+	Colorf GetLineColor(const Line& line);
+	double GetLineHeight() const;
+	void UpdateScrollbar();
+	void ScrollTo(double position);
+	void ScrollPaintedLines();
+	void OnVerticalScroll();
+	double GetTextWidth();
+
+	static const size_t MaxDrawnBytes = 4096;
+	static const int FlushInterval = 16; // Once per frame while lines are arriving
+	static const int IdleInterval = 250; // Picks up lines queued from other threads, which cannot start timers
+
+	Scrollbar* vert_scrollbar = nullptr;
+	Timer* flush_timer = nullptr;
+	bool flushing = false; // flush_timer runs at FlushInterval
+	std::thread::id ui_thread;
+	VerticalTextPosition vertical_text_align;
+
+	size_t max_lines = 100000;
+	size_t max_bytes = 16 * 1024 * 1024;
+	Colorf severity_colors[4];
+	bool follow_tail = true;
+
+	// Text of the lines, wrapping around to the start once it has grown to max_bytes
+	std::vector<char> arena;
+	size_t write_pos = 0;
+
+	// Ring of lines in arena order
+	std::vector<Line> lines;
+	size_t first_line = 0;
+	size_t line_count = 0;
+	size_t lines_removed = 0; // Lines removed from the front, so that lines can be told apart after the ring moved
+
+	// First line on screen, counting the removed lines. Scrolling moves the painted lines instead of painting them again.
+	double painted_top = 0.0;
+
+	// Lines added since the last flush, possibly from other threads
+	std::mutex pending_mutex;
+	std::string pending_text;
+	std::vector<Line> pending_lines;
+	std::string partial_line;
+};
@@ -36,6 +36,7 @@ private:
 	std::vector<MenubarItem*> menuItems;
 	int currentMenubarItem = -1;
 	Menu* openMenu = nullptr;
+	Menu* menuPopup = nullptr; // Hidden between openings, so that the native popup window is only created once
 	bool modalMode = false;
 
 	friend class MenubarItem;
@@ -76,6 +77,9 @@ public:
 	MenuItem* AddItem(std::shared_ptr<Image> icon, std::string text, std::function<void()> onClick = {});
 	MenuItemSeparator* AddSeparator();
 
+	/// Removes all items
+	void Clear();
+
 	double GetPreferredWidth() override;
 	double GetPreferredHeight() override;
 
@@ -61,6 +61,7 @@ private:
 	double CalculateThumbPosition(double thumb_size, double track_size);
 	Rect CreateRect(double start, double end);
 	void InvokeScrollEvent(std::function<void()>* event_ptr);
+	void UpdateBar();
 	void OnTimerExpired();
 
 	bool vertical = true;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "../../core/widget.h"
+#include <functional>
+#include <vector>
+
+class Scrollbar;
+
+/// \brief Scrolls a content widget, or a list of rows that are created on demand
+///
+/// With a content widget every child exists all the time. With rows the view only keeps enough row widgets to cover
+/// what is in view. Scrolling binds the widgets that leave the view to the rows that come into it, so the number of
+/// widgets does not grow with the number of rows.
+class ScrollView : public Widget
+{
+public:
+	ScrollView(Widget* parent = nullptr);
+
+	/// Scrolls a widget shown at its preferred height. The scroll view takes ownership of it.
+	void SetContent(Widget* content);
+	Widget* GetContent() const { return content; }
+
+	/// Measures the content again, for when its preferred height changed
+	void UpdateContentHeight();
+
+	/// Shows rows of the same height instead of a content widget. createRow makes an unbound row widget with the
+	/// given parent. bindRow sets up a row widget for a row index, replacing whatever it showed before.
+	void SetRows(int count, double rowHeight, std::function<Widget*(Widget* parent)> createRow, std::function<void(Widget* widget, int row)> bindRow);
+	void SetRowCount(int count);
+	int GetRowCount() const { return rowCount; }
+
+	/// Binds the rows in view again, for when the data they show changed
+	void RebindRows();
+
+	/// Widget showing a row, or null when the row is not in view
+	Widget* GetRowWidget(int row) const;
+
+	double GetScrollPosition() const;
+	void SetScrollPosition(double position);
+	void ScrollToRow(int row);
+
+protected:
+	void OnGeometryChanged() override;
+	bool OnMouseWheel(const Point& pos, InputKey key) override;
+
+private:
+	void ClearRows();
+	void UpdateScrollRanges();
+	void LayoutContent();
+	static void PlaceWidget(Widget* widget, const Rect& box);
+	void ScrollPaintedContent();
+	void OnScrollbarScroll();
+
+	Widget* viewport = nullptr;
+	Scrollbar* scrollbar = nullptr;
+	Widget* content = nullptr;
+	double contentHeight = 0.0; // Preferred height of the content including its noncontent area
+
+	int rowCount = 0;
+	double rowHeight = 0.0;
+	std::function<Widget*(Widget* parent)> createRow;
+	std::function<void(Widget* widget, int row)> bindRow;
+	std::vector<Widget*> rowWidgets; // Row i is shown by rowWidgets[i % rowWidgets.size()] while it is in view
+	std::vector<int> boundRows; // Row each row widget is bound to, or -1
+	double paintedScroll = 0.0; // Scroll position of what is on screen, so that scrolling can move it instead of painting it again
+};
@@ -4,8 +4,13 @@
 #include "../../core/widget.h"
 #include "../../core/timer.h"
 #include "../../core/span_layout.h"
+#include "../../core/text_document.h"
+#include "../../core/undo_journal.h"
+#include "../../core/text_search.h"
+#include "../../core/chunked_text_run.h"
 #include "../../core/font.h"
 #include <functional>
+#include <map>
 
 class Scrollbar;
 
@@ -18,8 +23,10 @@ public:
 	bool IsReadOnly() const;
 	bool IsLowercase() const;
 	bool IsUppercase() const;
+	bool IsWordWrap() const;
 	int GetMaxLength() const;
 	std::string GetText() const;
+	std::string GetText(size_t offset, size_t length) const;
 	int GetLineCount() const;
 	std::string GetLineText(int line) const;
 	std::string GetSelection() const;
@@ -34,9 +41,16 @@ public:
 	void SetReadOnly(bool enable = true);
 	void SetLowercase(bool enable = true);
 	void SetUppercase(bool enable = true);
+
+	/// Long lines wrap by default. Without wrapping the text scrolls horizontally and only the visible part of each line is shaped.
+	void SetWordWrap(bool enable = true);
 	void SetMaxLength(int length);
 	void SetText(const std::string& text);
 	void AddText(const std::string& text);
+
+	/// Uses the buffer as document text without copying it
+	void SetText(std::shared_ptr<TextBuffer> buffer);
+	void AddText(std::shared_ptr<TextBuffer> buffer);
 	void SetSelection(int pos, int length);
 	void ClearSelection();
 	void SetCursorPos(int pos);
@@ -44,13 +58,30 @@ public:
 	void SetInputMask(const std::string& mask);
 	void SetCursorDrawingEnabled(bool enable);
 
+	bool CanUndo() const;
+	bool CanRedo() const;
+	void Undo();
+	void Redo();
+
+	/// Highlights all occurrences of the text. The search runs on a worker thread and matches arrive in batches.
+	void Find(const std::string& text, const TextSearchOptions& options = {});
+	void ClearFind();
+	int GetFindMatchCount() const;
+	bool FindNext();
+	bool FindPrevious();
+
+	/// Replaces all occurrences of the text being searched for as a single edit and returns the number of replacements
+	int ReplaceAll(const std::string& replacement);
+
 	std::function<std::string(std::string text)> FuncFilterKeyChar;
 	std::function<void()> FuncBeforeEditChanged;
 	std::function<void()> FuncAfterEditChanged;
+	std::function<void(const TextChange& change)> FuncTextChanged;
 	std::function<void()> FuncSelectionChanged;
 	std::function<void()> FuncFocusGained;
 	std::function<void()> FuncFocusLost;
 	std::function<void()> FuncEnterPressed;
+	std::function<void()> FuncFindResultsChanged;
 
 protected:
 	void OnPaint(Canvas* canvas) override;
@@ -72,22 +103,38 @@ private:
 
 	void OnTimerExpired();
 	void OnScrollTimerExpired();
+	void OnSearchTimerExpired();
+	void RestartSearch();
+	void UpdateSearchAfterEdit(size_t offset, size_t removed, size_t inserted);
+	void SelectMatch(const TextSearch::Match& match);
 	void CreateComponents();
 	void OnVerticalScroll();
 	void UpdateVerticalScroll();
 	void MoveVerticalScroll();
+	void ScrollPaintedLines();
+	void OnHorizontalScroll();
+	void UpdateHorizontalScroll();
 	double GetTotalLineHeight();
+	int GetLineLength(int line) const;
+	void SetLineHeight(int line, double height);
+	void InvalidateLines(int first, int last, int new_last);
 
 	struct Line
 	{
-		std::string text;
 		SpanLayout layout;
 		Rect box;
 		bool invalidated = true;
 
+		// Used instead of the layout when word wrap is off
+		ChunkedTextRun run;
+		std::vector<std::pair<std::string::size_type, std::string::size_type>> highlights;
+		std::pair<std::string::size_type, std::string::size_type> selection;
+		int cursor = -1;
+
 		Line(const TextEdit *self)
 		{
 			layout.SetSelectionColors(self->selectionFG, self->selectionBG);
+			layout.SetHighlightColor(Colorf(self->selectionBG.r, self->selectionBG.g, self->selectionBG.b, self->selectionBG.a * 0.5f));
 		}
 	};
 
@@ -104,8 +151,23 @@ private:
 
 	Colorf selectionBG, selectionFG;
 	Scrollbar* vert_scrollbar;
+	Scrollbar* horiz_scrollbar;
 	Timer* timer = nullptr;
-	std::vector<Line> lines = { Line{this} };
+	TextDocument document;
+	std::map<int, Line> lines; // Layouts for the lines in view, created on demand
+	int visible_lines = 0;
+	int painted_first_line = 0; // First line on screen, so that scrolling can move the lines instead of painting them again
+
+	// Height of each line when it was last laid out, or zero if it never was
+	std::vector<double> line_heights = { 0.0 };
+	double measured_height = 0.0;
+	int measured_lines = 0;
+
+	bool word_wrap = true;
+	double scroll_x = 0.0;
+	double max_line_width = 0.0; // Widest line laid out so far
+	ivec2 scrolled_cursor_pos = { -1, -1 }; // Cursor position last scrolled into view
+
 	ivec2 cursor_pos = { 0, 0 };
 	int max_length = -1;
 	bool mouse_selecting = false;
@@ -118,8 +180,12 @@ private:
 
 	static std::string break_characters;
 
+	void DrawUnwrappedLine(Canvas* canvas, Line& line);
 	void Move(int steps, bool shift, bool ctrl);
 	void InsertText(ivec2 pos, const std::string& str);
+	void ApplyEdit(size_t offset, size_t length, const std::string& text, bool updateSearch = true);
+	void NotifyTextChanged(size_t offset, size_t length, const std::string& text, int first, int last, int new_last);
+	void NotifyTextChanged(size_t offset, size_t length, size_t inserted_length, int first, int last, int new_last);
 	void Backspace();
 	void Del();
 	ivec2 GetCharacterIndex(Point mouse_wincoords);
@@ -138,18 +204,13 @@ private:
 	int clip_start_offset = 0;
 	bool ignore_mouse_events = false;
 
-	struct UndoInfo
-	{
-		/* set undo text when:
-		   - added char after moving
-		   - destructive block operation (del, cut etc)
-		   - beginning erase
-		*/
-
-		std::string undo_text;
-		bool first_erase = false;
-		bool first_text_insert = false;
-	} undo_info;
+	UndoJournal undo_journal;
+
+	TextSearch search;
+	Timer* search_timer = nullptr;
+	std::string search_text;
+	TextSearchOptions search_options;
+	std::vector<TextSearch::Match> search_matches;
 
 	bool select_all_on_focus_gain = false;
 
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "../../core/widget.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Timer;
+class Scrollbar;
+
+/// \brief A node as given to a TreeView by its model
+struct TreeViewItem
+{
+	std::string text;
+	bool hasChildren = false; // Shows an expander. The children are only fetched when the node is expanded.
+	uint64_t id = 0; // Identifies the node to the model
+};
+
+/// \brief Request for the children of a node
+///
+/// The model completes it once, either before FetchChildren returns or later from any thread.
+class TreeViewFetch
+{
+public:
+	/// The node whose children are wanted. The top level nodes are wanted when this is the root.
+	const TreeViewItem& GetParent() const { return parent; }
+	bool IsRoot() const { return root; }
+
+	/// Set when the view no longer needs the children, so the model can stop fetching them
+	bool IsCancelled() const { return cancelled; }
+
+	void Complete(std::vector<TreeViewItem> children);
+
+private:
+	TreeViewItem parent;
+	bool root = false;
+	std::atomic<bool> cancelled = false;
+
+	std::mutex mutex;
+	bool completed = false;
+	std::vector<TreeViewItem> children;
+	size_t applied = 0; // Children the view has added so far
+
+	friend class TreeView;
+};
+
+/// \brief Nodes shown by a TreeView
+class TreeViewModel
+{
+public:
+	virtual ~TreeViewModel() = default;
+
+	virtual void FetchChildren(std::shared_ptr<TreeViewFetch> fetch) = 0;
+};
+
+/// \brief Hierarchy of nodes whose children are fetched from a model when they are first expanded
+///
+/// Nodes are referred to by handles that stay valid until the node is removed by Reload or SetModel. The root has
+/// the handle 0 and is not shown. The rows shown are kept as a flat list, so painting, scrolling and keyboard
+/// navigation only look at the rows in view however large the tree is.
+class TreeView : public Widget
+{
+public:
+	TreeView(Widget* parent = nullptr);
+	~TreeView();
+
+	/// Removes all nodes and fetches the top level nodes from the model
+	void SetModel(std::shared_ptr<TreeViewModel> model);
+	TreeViewModel* GetModel() const { return model.get(); }
+
+	int GetRootNode() const { return 0; }
+	int GetParentNode(int node) const { return nodes[node].parent; }
+	int GetChildCount(int node) const { return (int)nodes[node].children.size(); }
+	int GetChildNode(int node, int index) const { return nodes[node].children[index]; }
+	int GetNodeDepth(int node) const { return nodes[node].depth; }
+	const TreeViewItem& GetNodeItem(int node) const { return nodes[node].item; }
+
+	bool IsExpanded(int node) const { return nodes[node].expanded; }
+	bool IsFetching(int node) const { return nodes[node].fetch != nullptr; }
+
+	void Expand(int node);
+	void Collapse(int node);
+
+	/// Removes the children of the node and fetches them again
+	void Reload(int node);
+
+	/// Text shown in place of the children of a node while they are being fetched
+	void SetFetchingText(const std::string& text);
+
+	/// Number of rows shown, including the rows for nodes whose children are being fetched
+	int GetRowCount() const { return (int)rows.size(); }
+
+	/// Node shown at a row, or -1 for a row shown while children are being fetched
+	int GetRowNode(int row) const { return rows[row] >= 0 ? rows[row] : -1; }
+
+	/// Row a node is shown at, or -1 when one of its parents is collapsed
+	int GetNodeRow(int node) const { return nodes[node].row; }
+
+	/// Selects the node, expanding its parents so that it is shown
+	void SetSelectedNode(int node, bool notify = true);
+	int GetSelectedNode() const { return selectedRow >= 0 ? rows[selectedRow] : -1; }
+
+	void ScrollToNode(int node);
+
+	void Activate();
+
+	std::function<void(int)> OnChanged;
+	std::function<void(int)> OnActivated;
+
+protected:
+	void OnPaint(Canvas* canvas) override;
+	bool OnMouseDown(const Point& pos, InputKey key) override;
+	bool OnMouseDoubleclick(const Point& pos, InputKey key) override;
+	bool OnMouseWheel(const Point& pos, InputKey key) override;
+	void OnKeyDown(InputKey key) override;
+	void OnGeometryChanged() override;
+
+private:
+	struct Node
+	{
+		TreeViewItem item;
+		int parent = -1;
+		int depth = -1;
+		bool expanded = false;
+		bool fetched = false;
+		bool queued = false; // In fetchingNodes, which holds each node only once
+		int row = -1; // Row the node is shown at
+		int fetchingRow = -1; // Row shown while the children are being fetched
+		std::vector<int> children;
+		std::shared_ptr<TreeViewFetch> fetch;
+	};
+
+	static double GetRowHeight() { return 20.0; }
+	static const size_t MaxChildrenPerTick = 16384;
+
+	void Expand(int node, int row);
+	void Collapse(int node, int row);
+
+	int CreateNode(TreeViewItem item, int parent);
+	void FreeChildren(int node);
+	void StartFetch(int node);
+	bool ApplyFetch(int node, size_t maxCount);
+	void OnFetchTimerExpired();
+
+	void AppendRows(int node, std::vector<int>& result) const;
+	int GetRowDepth(int row) const;
+	int GetSubtreeRowCount(int row) const;
+	void InsertRows(int position, const std::vector<int>& newRows);
+	void EraseRows(int position, int count);
+	void UpdateNodeRows(int position);
+
+	void SelectRow(int row, bool notify = true);
+	void MoveSelection(int row, int direction);
+	int GetRowAt(double y);
+	void ScrollToRow(int row);
+	void UpdateScrollRanges();
+	void ScrollPaintedRows();
+	void OnScrollbarScroll();
+
+	Scrollbar* scrollbar = nullptr;
+	Timer* fetchTimer = nullptr;
+
+	std::shared_ptr<TreeViewModel> model;
+	std::vector<Node> nodes;
+	std::vector<int> freeNodes;
+	std::vector<int> fetchingNodes;
+
+	std::vector<int> rows; // Node shown at each row. A row shown while the children of a node are being fetched holds -1 - node.
+	int selectedRow = -1;
+	std::string fetchingText = "Loading...";
+	double paintedScroll = 0.0; // Scroll position of the rows on screen, so that scrolling can move them instead of painting them again
+};
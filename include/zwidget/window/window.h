@@ -363,6 +363,9 @@ public:
 
 	virtual void PresentBitmap(int width, int height, const uint32_t* pixels) = 0;
 
+	// Presents a bitmap where only the given area changed since the last one. Backends without a way to update part of the window present all of it.
+	virtual void PresentBitmapRegion(int width, int height, const uint32_t* pixels, int x, int y, int regionWidth, int regionHeight) { PresentBitmap(width, height, pixels); }
+
 	virtual std::string GetClipboardText() = 0;
 	virtual void SetClipboardText(const std::string& text) = 0;
 
@@ -11,6 +11,9 @@
 #include "window/window.h"
 #include <vector>
 #include <unordered_map>
+#include <list>
+#include <string_view>
+#include <atomic>
 #include <stdexcept>
 #include <cstring>
 #include <iostream>
@@ -46,6 +49,7 @@ public:
 	~CanvasFont();
 
 	CanvasGlyph* getGlyph(Canvas* canvas, uint32_t utfchar);
+	CanvasGlyph* getGlyphByIndex(Canvas* canvas, uint32_t glyphIndex);
 
 private:
 	std::unique_ptr<TrueTypeFont> ttf;
@@ -71,12 +75,62 @@ public:
 	CanvasFontGroup(const std::string& fontname, double height);
 
 	CanvasGlyph* getGlyph(Canvas* canvas, uint32_t utfchar, const char* lang = nullptr);
+	void getGlyphs(Canvas* canvas, const uint32_t* utfchars, size_t count, const char* lang, CanvasGlyph** glyphs);
 	TrueTypeTextMetrics& GetTextMetrics();
 
 	double height;
 	std::vector<SingleFont> fonts;
 };
 
+// Least recently used cache of shaped text runs
+class TextRunCache
+{
+public:
+	std::shared_ptr<TextRun> find(CanvasFontGroup* group, uint32_t maskChar, const std::string& text);
+	void insert(CanvasFontGroup* group, uint32_t maskChar, const std::string& text, std::shared_ptr<TextRun> run);
+	void clear();
+
+	bool isCacheable(const std::string& text) const { return text.size() * sizeof(int32_t) * 4 < budget; }
+
+	size_t budget = 4 * 1024 * 1024;
+	size_t bytes = 0;
+	size_t hits = 0;
+	size_t misses = 0;
+
+	size_t size() const { return entries.size(); }
+
+private:
+	struct Key
+	{
+		CanvasFontGroup* group = nullptr;
+		uint32_t maskChar = 0;
+		size_t hash = 0;
+		std::string_view text;
+
+		bool operator==(const Key& other) const { return hash == other.hash && group == other.group && maskChar == other.maskChar && text == other.text; }
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const { return key.hash; }
+	};
+
+	struct Entry
+	{
+		CanvasFontGroup* group = nullptr;
+		uint32_t maskChar = 0;
+		std::string text;
+		std::shared_ptr<TextRun> run;
+		size_t bytes = 0;
+	};
+
+	static Key makeKey(CanvasFontGroup* group, uint32_t maskChar, std::string_view text);
+	void evict();
+
+	std::list<Entry> entries; // Most recently used first
+	std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> lookup;
+};
+
 ////////////////////////////////////////////////////////////////////////////
 
 CanvasFont::CanvasFont(const std::string& fontname, double height, std::vector<uint8_t> data) : fontname(fontname), height(height)
@@ -91,7 +145,11 @@ CanvasFont::~CanvasFont()
 
 CanvasGlyph* CanvasFont::getGlyph(Canvas* canvas, uint32_t utfchar)
 {
-	uint32_t glyphIndex = ttf->GetGlyphIndex(utfchar);
+	return getGlyphByIndex(canvas, ttf->GetGlyphIndex(utfchar));
+}
+
+CanvasGlyph* CanvasFont::getGlyphByIndex(Canvas* canvas, uint32_t glyphIndex)
+{
 	if (glyphIndex == 0) return nullptr;
 
 	auto& glyph = glyphs[glyphIndex];
@@ -178,6 +236,35 @@ CanvasGlyph* CanvasFontGroup::getGlyph(Canvas* canvas, uint32_t utfchar, const c
 	return nullptr;
 }
 
+void CanvasFontGroup::getGlyphs(Canvas* canvas, const uint32_t* utfchars, size_t count, const char* lang, CanvasGlyph** glyphs)
+{
+	std::fill(glyphs, glyphs + count, nullptr);
+
+	// Resolve the whole string against one font at a time, only falling back to the next font for the characters still missing
+	std::vector<uint32_t> glyphIndices(count);
+	size_t remaining = count;
+	for (int i = 0; i < 2 && remaining > 0; i++)
+	{
+		for (auto& fd : fonts)
+		{
+			if (i == 1 || lang == nullptr || *lang == 0 || fd.language.empty() || fd.language == lang)
+			{
+				fd.font->ttf->GetGlyphIndices(utfchars, glyphIndices.data(), count);
+				for (size_t j = 0; j < count; j++)
+				{
+					if (!glyphs[j] && glyphIndices[j] != 0)
+					{
+						glyphs[j] = fd.font->getGlyphByIndex(canvas, glyphIndices[j]);
+						remaining--;
+					}
+				}
+				if (remaining == 0)
+					break;
+			}
+		}
+	}
+}
+
 TrueTypeTextMetrics& CanvasFontGroup::GetTextMetrics()
 {
 	return fonts[0].font->textmetrics;
@@ -185,8 +272,71 @@ TrueTypeTextMetrics& CanvasFontGroup::GetTextMetrics()
 
 ////////////////////////////////////////////////////////////////////////////
 
-Canvas::Canvas()
+TextRunCache::Key TextRunCache::makeKey(CanvasFontGroup* group, uint32_t maskChar, std::string_view text)
 {
+	Key key;
+	key.group = group;
+	key.maskChar = maskChar;
+	key.text = text;
+	key.hash = std::hash<std::string_view>()(text) ^ (std::hash<const void*>()(group) * 31 + maskChar);
+	return key;
+}
+
+std::shared_ptr<TextRun> TextRunCache::find(CanvasFontGroup* group, uint32_t maskChar, const std::string& text)
+{
+	auto it = lookup.find(makeKey(group, maskChar, text));
+	if (it == lookup.end())
+	{
+		misses++;
+		return nullptr;
+	}
+
+	hits++;
+	entries.splice(entries.begin(), entries, it->second);
+	return it->second->run;
+}
+
+void TextRunCache::insert(CanvasFontGroup* group, uint32_t maskChar, const std::string& text, std::shared_ptr<TextRun> run)
+{
+	Entry entry;
+	entry.group = group;
+	entry.maskChar = maskChar;
+	entry.text = text;
+	entry.run = std::move(run);
+	entry.bytes = sizeof(Entry) + text.size() * (sizeof(char) + sizeof(int32_t)) + entry.run->glyphs.size() * (sizeof(CanvasGlyph*) + sizeof(uint32_t));
+	entries.push_front(std::move(entry));
+
+	Entry& e = entries.front();
+	lookup[makeKey(group, maskChar, e.text)] = entries.begin();
+	bytes += e.bytes;
+
+	evict();
+}
+
+void TextRunCache::evict()
+{
+	while (bytes > budget && !entries.empty())
+	{
+		Entry& e = entries.back();
+		lookup.erase(makeKey(e.group, e.maskChar, e.text));
+		bytes -= e.bytes;
+		entries.pop_back();
+	}
+}
+
+void TextRunCache::clear()
+{
+	lookup.clear();
+	entries.clear();
+	bytes = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////
+
+Canvas::Canvas() : textRunCache(std::make_unique<TextRunCache>())
+{
+	static std::atomic<uint64_t> nextFontGeneration;
+	fontGeneration = ++nextFontGeneration;
 }
 
 Canvas::~Canvas()
@@ -207,6 +357,7 @@ void Canvas::detach()
 
 void Canvas::begin(const Colorf& color)
 {
+	double oldUiscale = uiscale;
 	if (window)
 	{
 		uiscale = window->GetDpiScale();
@@ -219,6 +370,37 @@ void Canvas::begin(const Colorf& color)
 		width = 32;
 		height = 32;
 	}
+
+	// Shaped runs store positions in device pixels
+	if (uiscale != oldUiscale)
+		textRunCache->clear();
+}
+
+void Canvas::setLanguage(const char* lang)
+{
+	if (language != lang)
+	{
+		language = lang;
+		textRunCache->clear();
+	}
+}
+
+TextRunCacheStats Canvas::getTextRunCacheStats() const
+{
+	TextRunCacheStats stats;
+	stats.hits = textRunCache->hits;
+	stats.misses = textRunCache->misses;
+	stats.entries = textRunCache->size();
+	stats.bytes = textRunCache->bytes;
+	stats.budget = textRunCache->budget;
+	return stats;
+}
+
+void Canvas::setTextRunCacheBudget(size_t bytes)
+{
+	textRunCache->budget = bytes;
+	if (textRunCache->bytes > bytes)
+		textRunCache->clear();
 }
 
 Point Canvas::getOrigin()
@@ -263,6 +445,30 @@ void Canvas::popClip()
 	clipStack.pop_back();
 }
 
+Rect Canvas::getClipBox() const
+{
+	Rect clip = clipStack.empty() ? Rect::xywh(0.0, 0.0, width / uiscale, height / uiscale) : clipStack.back();
+	return Rect::xywh(clip.x - origin.x, clip.y - origin.y, clip.width, clip.height);
+}
+
+bool Canvas::scrollRect(const Rect& box, double dx, double dy)
+{
+	// Painting rounds every position to pixels, so moved pixels only match a repaint when the move is whole pixels
+	double pixelDx = dx * uiscale;
+	double pixelDy = dy * uiscale;
+	if (std::abs(pixelDx - std::round(pixelDx)) > 0.001 || std::abs(pixelDy - std::round(pixelDy)) > 0.001)
+		return false;
+
+	int x0 = std::max((int)gridFit(origin.x + box.x), getClipMinX());
+	int y0 = std::max((int)gridFit(origin.y + box.y), getClipMinY());
+	int x1 = std::min((int)gridFit(origin.x + box.x + box.width), getClipMaxX());
+	int y1 = std::min((int)gridFit(origin.y + box.y + box.height), getClipMaxY());
+	if (x0 >= x1 || y0 >= y1)
+		return true;
+
+	return scrollTile(x0, y0, x1, y1, (int)std::round(pixelDx), (int)std::round(pixelDy));
+}
+
 void Canvas::fillRect(const Rect& box, const Colorf& color)
 {
 	fillTile(gridFit(origin.x + box.x), gridFit(origin.y + box.y), gridFit(box.width), gridFit(box.height), color);
@@ -387,30 +593,8 @@ void Canvas::line(const Point& p0, const Point& p1, const Colorf& color)
 
 void Canvas::drawText(const std::shared_ptr<Font>& font, const Point& pos, const std::string& text, const Colorf& color)
 {
-	CanvasFontGroup* canvasFont = GetFontGroup(font);
-
-	double x = gridFit(origin.x + pos.x);
-	double y = gridFit(origin.y + pos.y);
-
-	UTF8Reader reader(text.data(), text.size());
-	while (!reader.is_end())
-	{
-		CanvasGlyph* glyph = canvasFont->getGlyph(this, reader.character(), language.c_str());
-		if (!glyph || !glyph->texture)
-		{
-			glyph = canvasFont->getGlyph(this, 32);
-		}
-
-		if (glyph->texture)
-		{
-			double gx = std::round(x + glyph->metrics.leftSideBearing);
-			double gy = std::round(y + glyph->metrics.yOffset);
-			drawGlyph(glyph->texture.get(), (float)gx, (float)gy, (float)glyph->uvwidth, (float)glyph->uvheight, (float)glyph->u, (float)glyph->v, (float)glyph->uvwidth, (float)glyph->uvheight, color);
-		}
-
-		x += std::round(glyph->metrics.advanceWidth);
-		reader.next();
-	}
+	std::shared_ptr<TextRun> run = GetTextRun(GetFontGroup(font), text);
+	drawText(*run, pos, color);
 }
 
 void Canvas::drawTextEllipsis(const std::shared_ptr<Font>& font, const Point& pos, const Rect& clipBox, const std::string& text, const Colorf& color)
@@ -420,25 +604,8 @@ void Canvas::drawTextEllipsis(const std::shared_ptr<Font>& font, const Point& po
 
 Rect Canvas::measureText(const std::shared_ptr<Font>& font, const std::string& text)
 {
-	CanvasFontGroup* canvasFont = GetFontGroup(font);
-	const TrueTypeTextMetrics& tm = canvasFont->GetTextMetrics();
-	double lineHeight = tm.ascent + tm.descent + tm.lineGap;
-	double x = 0.0;
-
-	UTF8Reader reader(text.data(), text.size());
-	while (!reader.is_end())
-	{
-		CanvasGlyph* glyph = canvasFont->getGlyph(this, reader.character(), language.c_str());
-		if (!glyph || !glyph->texture)
-		{
-			glyph = canvasFont->getGlyph(this, 32);
-		}
-
-		x += std::round(glyph->metrics.advanceWidth);
-		reader.next();
-	}
-
-	return Rect::xywh(0.0, 0.0, x / uiscale, lineHeight / uiscale);
+	std::shared_ptr<TextRun> run = GetTextRun(GetFontGroup(font), text);
+	return Rect::xywh(0.0, 0.0, run->getWidth(), run->getHeight());
 }
 
 FontMetrics Canvas::getFontMetrics(const std::shared_ptr<Font>& font)
@@ -454,25 +621,148 @@ FontMetrics Canvas::getFontMetrics(const std::shared_ptr<Font>& font)
 
 int Canvas::getCharacterIndex(const std::shared_ptr<Font>& font, const std::string& text, const Point& hitPoint)
 {
-	CanvasFontGroup* canvasFont = GetFontGroup(font);
+	std::shared_ptr<TextRun> run = GetTextRun(GetFontGroup(font), text);
+	return (int)run->getCharacterIndex(hitPoint.x);
+}
+
+std::shared_ptr<TextRun> Canvas::shapeText(const std::shared_ptr<Font>& font, const std::string& text, uint32_t maskChar)
+{
+	return GetTextRun(GetFontGroup(font), text, maskChar);
+}
+
+std::shared_ptr<TextRun> Canvas::shapeText(const std::shared_ptr<Font>& font, const std::string& text, const TextRun& previous, size_t unchangedBytes)
+{
+	return ShapeText(GetFontGroup(font), text, 0, &previous, std::min(unchangedBytes, text.size()));
+}
+
+std::shared_ptr<TextRun> Canvas::shapeTextUncached(const std::shared_ptr<Font>& font, const std::string& text, uint32_t maskChar)
+{
+	return ShapeText(GetFontGroup(font), text, maskChar);
+}
+
+std::shared_ptr<TextRun> Canvas::GetTextRun(CanvasFontGroup* canvasFont, const std::string& text, uint32_t maskChar)
+{
+	if (!textRunCache->isCacheable(text))
+		return ShapeText(canvasFont, text, maskChar);
+
+	std::shared_ptr<TextRun> run = textRunCache->find(canvasFont, maskChar, text);
+	if (!run)
+	{
+		run = ShapeText(canvasFont, text, maskChar);
+		textRunCache->insert(canvasFont, maskChar, text, run);
+	}
+	return run;
+}
+
+std::shared_ptr<TextRun> Canvas::ShapeText(CanvasFontGroup* canvasFont, const std::string& text, uint32_t maskChar, const TextRun* previous, size_t unchangedBytes)
+{
+	const TrueTypeTextMetrics& tm = canvasFont->GetTextMetrics();
+
+	auto run = std::make_shared<TextRun>();
+	run->uiscale = uiscale;
+	run->lineHeight = tm.ascent + tm.descent + tm.lineGap;
+	run->positions.resize(text.size() + 1);
+
+	CanvasGlyph* maskGlyph = nullptr;
+	if (maskChar != 0)
+	{
+		maskGlyph = canvasFont->getGlyph(this, maskChar, language.c_str());
+		if (!maskGlyph || !maskGlyph->texture)
+			maskGlyph = canvasFont->getGlyph(this, 32);
+	}
+
+	// Keep the glyphs of the characters before the first changed byte. Decoding a lead byte looks at up to five bytes after it.
+	size_t keepChars = 0;
+	size_t keepBytes = 0;
+	if (previous && previous->uiscale == uiscale && unchangedBytes > 5)
+	{
+		keepChars = std::lower_bound(previous->offsets.begin(), previous->offsets.end(), (uint32_t)(unchangedBytes - 5)) - previous->offsets.begin();
+		keepBytes = keepChars < previous->offsets.size() ? previous->offsets[keepChars] : previous->size();
+	}
+
+	std::vector<uint32_t> chars(text.size() - keepBytes);
+	run->offsets.resize(keepChars + chars.size());
+	size_t count = UTF8Reader::decode(text.data() + keepBytes, text.size() - keepBytes, chars.data(), run->offsets.data() + keepChars);
+	chars.resize(count);
+	run->offsets.resize(keepChars + count);
+	for (size_t i = keepChars; i < run->offsets.size(); i++)
+		run->offsets[i] += (uint32_t)keepBytes;
+
+	run->glyphs.resize(run->offsets.size(), maskGlyph);
+	if (!maskGlyph)
+		canvasFont->getGlyphs(this, chars.data(), chars.size(), language.c_str(), run->glyphs.data() + keepChars);
 
-	double x = 0.0;
-	UTF8Reader reader(text.data(), text.size());
-	while (!reader.is_end())
+	int32_t x = 0;
+	if (keepChars > 0)
 	{
-		CanvasGlyph* glyph = canvasFont->getGlyph(this, reader.character(), language.c_str());
+		std::copy(previous->offsets.begin(), previous->offsets.begin() + keepChars, run->offsets.begin());
+		std::copy(previous->glyphs.begin(), previous->glyphs.begin() + keepChars, run->glyphs.begin());
+		std::copy(previous->positions.begin(), previous->positions.begin() + keepBytes + 1, run->positions.begin());
+		x = previous->positions[keepBytes];
+	}
+
+	CanvasGlyph* spaceGlyph = nullptr;
+	for (size_t i = keepChars; i < run->glyphs.size(); i++)
+	{
+		CanvasGlyph*& glyph = run->glyphs[i];
 		if (!glyph || !glyph->texture)
 		{
-			glyph = canvasFont->getGlyph(this, 32);
+			if (!spaceGlyph)
+				spaceGlyph = canvasFont->getGlyph(this, 32);
+			glyph = spaceGlyph;
 		}
 
-		if (hitPoint.x <= (x + glyph->metrics.advanceWidth * 0.5) / uiscale)
-			return (int)reader.position();
+		size_t pos = run->offsets[i];
+		size_t end = i + 1 < run->offsets.size() ? run->offsets[i + 1] : text.size();
+		run->positions[pos] = x;
+		x += (int32_t)std::round(glyph->metrics.advanceWidth);
+		for (size_t j = pos + 1; j < end; j++)
+			run->positions[j] = x;
+	}
+	run->positions[text.size()] = x;
+
+	return run;
+}
+
+void Canvas::drawText(const TextRun& run, const Point& pos, const Colorf& color)
+{
+	drawText(run, pos, 0, run.size(), color);
+}
 
-		x += std::round(glyph->metrics.advanceWidth);
-		reader.next();
+void Canvas::drawText(const TextRun& run, const Point& pos, size_t start, size_t end, const Colorf& color)
+{
+	double x = gridFit(origin.x + pos.x);
+	double y = gridFit(origin.y + pos.y);
+
+	size_t first = std::lower_bound(run.offsets.begin(), run.offsets.end(), (uint32_t)std::min(start, run.size())) - run.offsets.begin();
+	for (size_t i = first; i < run.glyphs.size() && run.offsets[i] < end; i++)
+	{
+		CanvasGlyph* glyph = run.glyphs[i];
+		if (glyph->texture)
+		{
+			double gx = std::round(x + run.positions[run.offsets[i]] + glyph->metrics.leftSideBearing);
+			double gy = std::round(y + glyph->metrics.yOffset);
+			drawGlyph(glyph->texture.get(), (float)gx, (float)gy, (float)glyph->uvwidth, (float)glyph->uvheight, (float)glyph->u, (float)glyph->v, (float)glyph->uvwidth, (float)glyph->uvheight, color);
+		}
 	}
-	return (int)text.size();
+}
+
+void Canvas::drawTextEllipsis(const TextRun& run, const Point& pos, const Rect& clipBox, size_t start, size_t end, const Colorf& color)
+{
+	drawText(run, pos, start, end, color);
+}
+
+size_t TextRun::getCharacterIndex(double x) const
+{
+	double hitX = x * uiscale;
+	auto it = std::upper_bound(offsets.begin(), offsets.end(), hitX, [&](double value, uint32_t offset) { return value < positions[offset]; });
+	if (it == offsets.begin())
+		return 0;
+
+	size_t index = (it - offsets.begin()) - 1;
+	if (hitX <= positions[offsets[index]] + glyphs[index]->metrics.advanceWidth * 0.5)
+		return offsets[index];
+	return index + 1 < offsets.size() ? offsets[index + 1] : size();
 }
 
 VerticalTextPosition Canvas::verticalTextAlign(const std::shared_ptr<Font>& font)
@@ -488,10 +778,15 @@ VerticalTextPosition Canvas::verticalTextAlign(const std::shared_ptr<Font>& font
 CanvasFontGroup* Canvas::GetFontGroup(const std::shared_ptr<Font>& font)
 {
 	FontImpl* fontImpl = static_cast<FontImpl*>(const_cast<Font*>(font.get()));
+	if (fontImpl->CanvasGeneration == fontGeneration)
+		return fontImpl->CanvasGroup;
 
 	std::shared_ptr<CanvasFontGroup>& group = fontCache[{fontImpl->Name, fontImpl->Height}];
 	if (!group)
 		group = std::make_unique<CanvasFontGroup>(fontImpl->Name, std::round(fontImpl->Height * uiscale));
+
+	fontImpl->CanvasGeneration = fontGeneration;
+	fontImpl->CanvasGroup = group.get();
 	return group.get();
 }
 
@@ -551,9 +846,20 @@ public:
 	void drawLineAntialiased(float x0, float y0, float x1, float y1, Colorf color) override;
 	void plot(float x, float y, float alpha, const Colorf& color);
 
+	bool beginPartial(const Rect& box) override;
+	bool scrollTile(int x0, int y0, int x1, int y1, int dx, int dy) override;
+	void addDamage(int x0, int y0, int x1, int y1);
+
 	std::unique_ptr<CanvasTexture> createTexture(int width, int height, const void* pixels, ImageFormat format = ImageFormat::B8G8R8A8) override;
 
 	std::vector<uint32_t> pixels;
+
+	// Area changed by a partial frame, in pixels
+	bool partial = false;
+	int damageX0 = 0;
+	int damageY0 = 0;
+	int damageX1 = 0;
+	int damageY1 = 0;
 };
 
 std::unique_ptr<CanvasTexture> BitmapCanvas::createTexture(int width, int height, const void* pixels, ImageFormat format)
@@ -1287,12 +1593,77 @@ void BitmapCanvas::begin(const Colorf& color)
 	uint32_t bgcolor = (a << 24) | (r << 16) | (g << 8) | b;
 	pixels.clear();
 	pixels.resize(width * height, bgcolor);
+	partial = false;
+}
+
+bool BitmapCanvas::beginPartial(const Rect& box)
+{
+	// The pixels kept from the previous frame are only usable if the window still has the same size and scale
+	if (!window || pixels.empty() || window->GetPixelWidth() != width || window->GetPixelHeight() != height || window->GetDpiScale() != uiscale)
+		return false;
+
+	partial = true;
+	damageX0 = width;
+	damageY0 = height;
+	damageX1 = 0;
+	damageY1 = 0;
+	addDamage((int)gridFit(box.x), (int)gridFit(box.y), (int)gridFit(box.x + box.width), (int)gridFit(box.y + box.height));
+	return true;
+}
+
+bool BitmapCanvas::scrollTile(int x0, int y0, int x1, int y1, int dx, int dy)
+{
+	if (!partial)
+		return false;
+
+	addDamage(x0, y0, x1, y1);
+
+	int count = (x1 - x0) - std::abs(dx);
+	if (count <= 0 || std::abs(dy) >= y1 - y0)
+		return true;
+
+	// Source and destination overlap, so rows are copied starting from the side the pixels move towards
+	int srcx = dx >= 0 ? x0 : x0 - dx;
+	int destx = srcx + dx;
+	uint32_t* data = pixels.data();
+	if (dy > 0)
+	{
+		for (int y = y1 - 1; y >= y0 + dy; y--)
+			memmove(data + y * width + destx, data + (y - dy) * width + srcx, count * sizeof(uint32_t));
+	}
+	else
+	{
+		for (int y = y0; y < y1 + dy; y++)
+			memmove(data + y * width + destx, data + (y - dy) * width + srcx, count * sizeof(uint32_t));
+	}
+	return true;
+}
+
+void BitmapCanvas::addDamage(int x0, int y0, int x1, int y1)
+{
+	x0 = std::max(x0, 0);
+	y0 = std::max(y0, 0);
+	x1 = std::min(x1, width);
+	y1 = std::min(y1, height);
+	if (x0 >= x1 || y0 >= y1)
+		return;
+
+	damageX0 = std::min(damageX0, x0);
+	damageY0 = std::min(damageY0, y0);
+	damageX1 = std::max(damageX1, x1);
+	damageY1 = std::max(damageY1, y1);
 }
 
 void BitmapCanvas::end()
 {
 	if (window)
-		window->PresentBitmap(width, height, pixels.data());
+	{
+		if (!partial)
+			window->PresentBitmap(width, height, pixels.data());
+		else if (damageX0 < damageX1 && damageY0 < damageY1)
+			window->PresentBitmapRegion(width, height, pixels.data(), damageX0, damageY0, damageX1 - damageX0, damageY1 - damageY0);
+	}
+	partial = false;
 }
 
 /////////////////////////////////////////////////////////////////////////////
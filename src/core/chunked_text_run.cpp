@@ -0,0 +1,275 @@
+
+#include "core/chunked_text_run.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Length of the common prefix or suffix of two strings, comparing blocks with memcmp first
+	size_t CommonPrefix(const char* a, const char* b, size_t length)
+	{
+		const size_t block = 256;
+		size_t pos = 0;
+		while (pos + block <= length && memcmp(a + pos, b + pos, block) == 0)
+			pos += block;
+		while (pos < length && a[pos] == b[pos])
+			pos++;
+		return pos;
+	}
+
+	size_t CommonSuffix(const char* aEnd, const char* bEnd, size_t length)
+	{
+		const size_t block = 256;
+		size_t count = 0;
+		while (count + block <= length && memcmp(aEnd - count - block, bEnd - count - block, block) == 0)
+			count += block;
+		while (count < length && aEnd[-1 - (ptrdiff_t)count] == bEnd[-1 - (ptrdiff_t)count])
+			count++;
+		return count;
+	}
+}
+
+void ChunkedTextRun::SetText(const std::string& newText, const std::shared_ptr<Font>& newFont, uint32_t maskChar)
+{
+	if (newFont != font || maskChar != mask_char || chunks.empty())
+	{
+		text = newText;
+		font = newFont;
+		mask_char = maskChar;
+		Reset();
+		return;
+	}
+
+	if (newText == text)
+		return;
+
+	// Find the bytes that changed
+	size_t prefix = CommonPrefix(text.data(), newText.data(), std::min(text.size(), newText.size()));
+	size_t suffix = CommonSuffix(text.data() + text.size(), newText.data() + newText.size(), std::min(text.size(), newText.size()) - prefix);
+	ReplaceText(prefix, text.size() - suffix - prefix, newText.substr(prefix, newText.size() - suffix - prefix));
+}
+
+void ChunkedTextRun::SetFont(const std::shared_ptr<Font>& newFont, uint32_t maskChar)
+{
+	if (newFont != font || maskChar != mask_char)
+	{
+		font = newFont;
+		mask_char = maskChar;
+		Reset();
+	}
+}
+
+void ChunkedTextRun::ReplaceText(size_t offset, size_t length, const std::string& inserted)
+{
+	if (chunks.empty())
+	{
+		text.replace(offset, length, inserted);
+		Reset();
+		return;
+	}
+
+	// Replace the chunks covering the bytes that changed
+	size_t first = FindChunk(offset);
+	size_t last = length > 0 ? FindChunk(offset + length - 1) : first;
+	size_t start = chunks[first].start;
+	size_t end = chunks[last].start + chunks[last].length + inserted.size() - length;
+	if (end - start < ChunkSize && last + 1 < chunks.size())
+	{
+		last++;
+		end += chunks[last].length;
+	}
+
+	for (size_t i = first; i <= last; i++)
+	{
+		if (chunks[i].run)
+			shaped--;
+	}
+	chunks.erase(chunks.begin() + first, chunks.begin() + last + 1);
+
+	text.replace(offset, length, inserted);
+	size_t count = CreateChunks(first, start, end);
+	for (size_t i = first + count; i < chunks.size(); i++)
+		chunks[i].start = i > 0 ? chunks[i - 1].start + chunks[i - 1].length : 0;
+	positioned = std::min(positioned, first);
+}
+
+void ChunkedTextRun::Reset()
+{
+	chunks.clear();
+	positioned = 0;
+	shaped = 0;
+	line_height = -1.0;
+	CreateChunks(0, 0, text.size());
+}
+
+double ChunkedTextRun::GetWidth(Canvas* canvas)
+{
+	if (chunks.empty())
+		return 0.0;
+	Measure(canvas, chunks.size() - 1);
+	return chunks.back().x + chunks.back().width;
+}
+
+double ChunkedTextRun::GetWidth(Canvas* canvas, size_t start, size_t end)
+{
+	return end > start ? GetPosition(canvas, end) - GetPosition(canvas, start) : 0.0;
+}
+
+double ChunkedTextRun::GetHeight(Canvas* canvas)
+{
+	if (line_height < 0.0)
+		line_height = canvas->shapeText(font, std::string(), mask_char)->getHeight();
+	return line_height;
+}
+
+double ChunkedTextRun::GetPosition(Canvas* canvas, size_t offset)
+{
+	if (chunks.empty())
+		return 0.0;
+
+	offset = std::min(offset, text.size());
+	size_t index = FindChunk(offset);
+	Measure(canvas, index);
+	const Chunk& chunk = chunks[index];
+	if (offset == chunk.start)
+		return chunk.x;
+	else if (offset == chunk.start + chunk.length)
+		return chunk.x + chunk.width;
+	return chunk.x + GetRun(canvas, index)->getPosition(offset - chunk.start);
+}
+
+size_t ChunkedTextRun::GetCharacterIndex(Canvas* canvas, double x)
+{
+	if (chunks.empty() || x <= 0.0)
+		return 0;
+
+	size_t index = FindChunkAt(canvas, x);
+	const Chunk& chunk = chunks[index];
+	if (x >= chunk.x + chunk.width)
+		return chunk.start + chunk.length;
+	return chunk.start + GetRun(canvas, index)->getCharacterIndex(x - chunk.x);
+}
+
+void ChunkedTextRun::Draw(Canvas* canvas, const Point& pos, size_t start, size_t end, double minX, double maxX, const Colorf& color)
+{
+	if (chunks.empty() || start >= end)
+		return;
+
+	double left = minX - pos.x;
+	double right = maxX - pos.x;
+	for (size_t i = std::max(FindChunk(start), FindChunkAt(canvas, left)); i < chunks.size() && chunks[i].start < end; i++)
+	{
+		Measure(canvas, i);
+		const Chunk& chunk = chunks[i];
+		if (chunk.x > right)
+			break;
+
+		std::shared_ptr<TextRun> run = GetRun(canvas, i);
+
+		// Skip the characters outside the range, keeping the ones partially inside it
+		size_t visibleStart = run->getCharacterIndex(left - chunk.x);
+		if (visibleStart > 0)
+		{
+			visibleStart--;
+			while (visibleStart > 0 && (text[chunk.start + visibleStart] & 0xc0) == 0x80)
+				visibleStart--;
+		}
+		size_t visibleEnd = run->getCharacterIndex(right - chunk.x) + 1;
+
+		size_t s = std::max(std::clamp(start, chunk.start, chunk.start + chunk.length) - chunk.start, visibleStart);
+		size_t e = std::min(std::clamp(end, chunk.start, chunk.start + chunk.length) - chunk.start, visibleEnd);
+		if (s < e)
+			canvas->drawText(*run, Point(pos.x + chunk.x, pos.y), s, e, color);
+	}
+}
+
+size_t ChunkedTextRun::CreateChunks(size_t index, size_t start, size_t end)
+{
+	// Split the range into chunks between ChunkSize and twice that, ending on character boundaries
+	std::vector<Chunk> created;
+	size_t length = end - start;
+	size_t count = std::max(length / ChunkSize, (size_t)1);
+	size_t pos = start;
+	for (size_t i = 1; i <= count && pos < end; i++)
+	{
+		size_t chunkEnd = i == count ? end : start + length * i / count;
+		while (chunkEnd < end && (text[chunkEnd] & 0xc0) == 0x80)
+			chunkEnd++;
+		if (chunkEnd > pos)
+		{
+			Chunk chunk;
+			chunk.start = pos;
+			chunk.length = chunkEnd - pos;
+			created.push_back(std::move(chunk));
+		}
+		pos = chunkEnd;
+	}
+	chunks.insert(chunks.begin() + index, std::make_move_iterator(created.begin()), std::make_move_iterator(created.end()));
+	return created.size();
+}
+
+size_t ChunkedTextRun::FindChunk(size_t offset) const
+{
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), offset, [](size_t offset, const Chunk& chunk) { return offset < chunk.start; });
+	return it != chunks.begin() ? (it - chunks.begin()) - 1 : 0;
+}
+
+size_t ChunkedTextRun::FindChunkAt(Canvas* canvas, double x)
+{
+	// Only measure as far as needed to reach the position
+	while (positioned < chunks.size() && (positioned == 0 || chunks[positioned - 1].x + chunks[positioned - 1].width <= x))
+		Measure(canvas, positioned);
+
+	auto it = std::upper_bound(chunks.begin(), chunks.begin() + positioned, x, [](double x, const Chunk& chunk) { return x < chunk.x; });
+	return it != chunks.begin() ? (it - chunks.begin()) - 1 : 0;
+}
+
+void ChunkedTextRun::Measure(Canvas* canvas, size_t index)
+{
+	for (; positioned <= index && positioned < chunks.size(); positioned++)
+	{
+		Chunk& chunk = chunks[positioned];
+		if (!chunk.measured)
+		{
+			// Measuring does not keep the glyphs around, as most chunks are never drawn. The chunks do not go through
+			// the text run cache either, since one long line would push out the text of every other widget.
+			if (chunk.run)
+				chunk.width = chunk.run->getWidth();
+			else
+				chunk.width = canvas->shapeTextUncached(font, text.substr(chunk.start, chunk.length), mask_char)->getWidth();
+			chunk.measured = true;
+		}
+		chunk.x = positioned > 0 ? chunks[positioned - 1].x + chunks[positioned - 1].width : 0.0;
+	}
+}
+
+std::shared_ptr<TextRun> ChunkedTextRun::GetRun(Canvas* canvas, size_t index)
+{
+	Chunk& chunk = chunks[index];
+	chunk.last_used = ++use_counter;
+	if (!chunk.run)
+	{
+		chunk.run = canvas->shapeTextUncached(font, text.substr(chunk.start, chunk.length), mask_char);
+		if (!chunk.measured)
+		{
+			chunk.width = chunk.run->getWidth();
+			chunk.measured = true;
+		}
+		if (++shaped > MaxShapedChunks * 2)
+			ReleaseRuns();
+	}
+	return chunk.run;
+}
+
+void ChunkedTextRun::ReleaseRuns()
+{
+	uint64_t oldest = use_counter - MaxShapedChunks;
+	for (Chunk& chunk : chunks)
+	{
+		if (chunk.run && chunk.last_used <= oldest)
+		{
+			chunk.run.reset();
+			shaped--;
+		}
+	}
+}
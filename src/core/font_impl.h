@@ -1,6 +1,9 @@
 #pragma once
 
 #include "core/font.h"
+#include <cstdint>
+
+class CanvasFontGroup;
 
 class FontImpl : public Font
 {
@@ -21,4 +24,8 @@ public:
 
 	std::string Name;
 	double Height = 0.0;
+
+	// Font group resolved by the canvas that last used this font. Only valid if the generation matches the canvas
+	uint64_t CanvasGeneration = 0;
+	CanvasFontGroup* CanvasGroup = nullptr;
 };
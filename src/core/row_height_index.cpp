@@ -0,0 +1,80 @@
+
+#include "core/row_height_index.h"
+
+void RowHeightIndex::Clear()
+{
+	heights.clear();
+	tree.clear();
+}
+
+double RowHeightIndex::GetTop(size_t row) const
+{
+	double top = 0.0;
+	for (size_t i = row; i > 0; i -= i & (~i + 1))
+		top += tree[i];
+	return top;
+}
+
+size_t RowHeightIndex::FindRow(double y) const
+{
+	size_t count = heights.size();
+	size_t step = 1;
+	while (step * 2 <= count)
+		step *= 2;
+
+	// Walk down the tree, skipping whole subtrees that end at or above the position
+	size_t pos = 0;
+	for (; step > 0; step /= 2)
+	{
+		if (pos + step <= count && tree[pos + step] <= y)
+		{
+			pos += step;
+			y -= tree[pos];
+		}
+	}
+	return pos;
+}
+
+void RowHeightIndex::SetHeight(size_t row, double height)
+{
+	double delta = height - heights[row];
+	heights[row] = height;
+	for (size_t i = row + 1; i < tree.size(); i += i & (~i + 1))
+		tree[i] += delta;
+}
+
+void RowHeightIndex::Append(double height)
+{
+	if (tree.empty())
+		tree.push_back(0.0);
+
+	// The new node covers the rows from i - lowbit(i) up to the new row
+	size_t i = tree.size();
+	size_t first = i - (i & (~i + 1));
+	heights.push_back(height);
+	tree.push_back(GetTop(i - 1) - GetTop(first) + height);
+}
+
+void RowHeightIndex::Insert(size_t row, const std::vector<double>& rowHeights)
+{
+	heights.insert(heights.begin() + row, rowHeights.begin(), rowHeights.end());
+	Rebuild();
+}
+
+void RowHeightIndex::Remove(size_t row, size_t count)
+{
+	heights.erase(heights.begin() + row, heights.begin() + row + count);
+	Rebuild();
+}
+
+void RowHeightIndex::Rebuild()
+{
+	tree.assign(heights.size() + 1, 0.0);
+	for (size_t i = 1; i < tree.size(); i++)
+	{
+		tree[i] += heights[i - 1];
+		size_t parent = i + (i & (~i + 1));
+		if (parent < tree.size())
+			tree[parent] += tree[i];
+	}
+}
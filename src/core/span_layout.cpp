@@ -18,6 +18,11 @@ void SpanLayout::Clear()
 	objects.clear();
 	text.clear();
 	lines.clear();
+	blocks.clear();
+	dirty_block = 0;
+	previous_run.reset();
+	previous_run_unchanged = (size_t)-1;
+	layout_cache = {};
 }
 
 std::vector<Rect> SpanLayout::GetRectById(int id) const
@@ -74,7 +79,8 @@ void SpanLayout::DrawLayout(Canvas* canvas)
 			{
 				if (segment.type == object_text)
 				{
-					double cursor_x = x + segment.x_position + canvas->measureText(segment.font, text.substr(segment.start, segment.end - segment.start)).width;
+					size_t run_start = objects[segment.object_index].start;
+					double cursor_x = x + segment.x_position + GetTextRun(canvas, segment.object_index)->getWidth(segment.start - run_start, segment.end - run_start);
 					double cursor_width = 1;
 					canvas->fillRect(Rect::ltrb(cursor_x, y + line.ascender - segment.ascender, cursor_x + cursor_width, y + line.ascender + segment.descender), cursor_color);
 				}
@@ -103,66 +109,66 @@ void SpanLayout::DrawLayoutEllipsis(Canvas* canvas, const Rect& content_rect)
 
 void SpanLayout::DrawLayoutImage(Canvas* canvas, Line& line, LineSegment& segment, double x, double y)
 {
-	canvas->drawImage(segment.image, Point(x + segment.x_position, y + line.ascender - segment.ascender));
+	canvas->drawImage(objects[segment.object_index].image, Point(x + segment.x_position, y + line.ascender - segment.ascender));
 }
 
 void SpanLayout::DrawLayoutText(Canvas* canvas, Line& line, LineSegment& segment, double x, double y)
 {
-	std::string segment_text = text.substr(segment.start, segment.end - segment.start);
+	const TextRun& run = *GetTextRun(canvas, segment.object_index);
+	size_t run_start = objects[segment.object_index].start;
+	size_t seg_start = segment.start - run_start;
+	size_t seg_end = segment.end - run_start;
 
-	int length = (int)segment_text.length();
-	int s1 = clamp((int)sel_start - (int)segment.start, 0, length);
-	int s2 = clamp((int)sel_end - (int)segment.start, 0, length);
+	// Position of the run origin so that the segment start lands at the segment x position
+	double xx = x + segment.x_position;
+	Point run_pos(xx - run.getPosition(seg_start), y + line.ascender);
 
-	if (s1 != s2)
+	size_t s1 = clamp(sel_start, segment.start, segment.end) - run_start;
+	size_t s2 = clamp(sel_end, segment.start, segment.end) - run_start;
+
+	for (const auto& range : highlight_ranges)
 	{
-		double xx = x + segment.x_position;
-		double xx0 = xx + canvas->measureText(segment.font, segment_text.substr(0, s1)).width;
-		double xx1 = xx0 + canvas->measureText(segment.font, segment_text.substr(s1, s2 - s1)).width;
-		double sel_width = canvas->measureText(segment.font, segment_text.substr(s1, s2 - s1)).width;
+		size_t h1 = clamp(range.first, segment.start, segment.end) - run_start;
+		size_t h2 = clamp(range.second, segment.start, segment.end) - run_start;
+		if (h1 != h2)
+			canvas->fillRect(Rect::ltrb(xx + run.getWidth(seg_start, h1), y + line.ascender - segment.ascender, xx + run.getWidth(seg_start, h2), y + line.ascender + segment.descender), highlight_background);
+	}
 
-		canvas->fillRect(Rect::ltrb(xx0, y + line.ascender - segment.ascender, xx1, y + line.ascender + segment.descender), sel_background);
+	if (cursor_visible && cursor_pos >= segment.start && cursor_pos < segment.end)
+	{
+		size_t c = cursor_pos - run_start;
+		double cursor_x = xx + run.getWidth(seg_start, c);
+		double cursor_width = cursor_overwrite_mode ? run.getWidth(c, c + 1) : 1;
+		if (s1 != s2)
+			canvas->fillRect(Rect::ltrb(xx + run.getWidth(seg_start, s1), y + line.ascender - segment.ascender, xx + run.getWidth(seg_start, s2), y + line.ascender + segment.descender), sel_background);
+		canvas->fillRect(Rect::ltrb(cursor_x, y + line.ascender - segment.ascender, cursor_x + cursor_width, y + line.ascender + segment.descender), cursor_color);
+	}
+	else if (s1 != s2)
+	{
+		canvas->fillRect(Rect::ltrb(xx + run.getWidth(seg_start, s1), y + line.ascender - segment.ascender, xx + run.getWidth(seg_start, s2), y + line.ascender + segment.descender), sel_background);
+	}
 
-		if (cursor_visible && cursor_pos >= segment.start && cursor_pos < segment.end)
+	if (s1 != s2)
+	{
+		if (is_ellipsis_draw)
 		{
-			double cursor_x = x + segment.x_position + canvas->measureText(segment.font, text.substr(segment.start, cursor_pos - segment.start)).width;
-			double cursor_width = cursor_overwrite_mode ? canvas->measureText(segment.font, text.substr(cursor_pos, 1)).width : 1;
-			canvas->fillRect(Rect::ltrb(cursor_x, y + line.ascender - segment.ascender, cursor_x + cursor_width, y + line.ascender + segment.descender), cursor_color);
+			canvas->drawTextEllipsis(run, run_pos, ellipsis_content_rect, seg_start, s1, segment.color);
+			canvas->drawTextEllipsis(run, run_pos, ellipsis_content_rect, s1, s2, sel_foreground);
+			canvas->drawTextEllipsis(run, run_pos, ellipsis_content_rect, s2, seg_end, segment.color);
 		}
-
-		if (s1 > 0)
-		{
-			if (is_ellipsis_draw)
-				canvas->drawTextEllipsis(segment.font, Point(xx, y + line.ascender), ellipsis_content_rect, segment_text.substr(0, s1), segment.color);
-			else
-				canvas->drawText(segment.font, Point(xx, y + line.ascender), segment_text.substr(0, s1), segment.color);
-		}
-		if (is_ellipsis_draw)
-			canvas->drawTextEllipsis(segment.font, Point(xx0, y + line.ascender), ellipsis_content_rect, segment_text.substr(s1, s2 - s1), sel_foreground);
 		else
-			canvas->drawText(segment.font, Point(xx0, y + line.ascender), segment_text.substr(s1, s2 - s1), sel_foreground);
-		xx += sel_width;
-		if (s2 < length)
 		{
-			if (is_ellipsis_draw)
-				canvas->drawTextEllipsis(segment.font, Point(xx1, y + line.ascender), ellipsis_content_rect, segment_text.substr(s2), segment.color);
-			else
-				canvas->drawText(segment.font, Point(xx1, y + line.ascender), segment_text.substr(s2), segment.color);
+			canvas->drawText(run, run_pos, seg_start, s1, segment.color);
+			canvas->drawText(run, run_pos, s1, s2, sel_foreground);
+			canvas->drawText(run, run_pos, s2, seg_end, segment.color);
 		}
 	}
 	else
 	{
-		if (cursor_visible && cursor_pos >= segment.start && cursor_pos < segment.end)
-		{
-			double cursor_x = x + segment.x_position + canvas->measureText(segment.font, text.substr(segment.start, cursor_pos - segment.start)).width;
-			double cursor_width = cursor_overwrite_mode ? canvas->measureText(segment.font, text.substr(cursor_pos, 1)).width : 1;
-			canvas->fillRect(Rect::ltrb(cursor_x, y + line.ascender - segment.ascender, cursor_x + cursor_width, y + line.ascender + segment.descender), cursor_color);
-		}
-
 		if (is_ellipsis_draw)
-			canvas->drawTextEllipsis(segment.font, Point(x + segment.x_position, y + line.ascender), ellipsis_content_rect, segment_text, segment.color);
+			canvas->drawTextEllipsis(run, run_pos, ellipsis_content_rect, seg_start, seg_end, segment.color);
 		else
-			canvas->drawText(segment.font, Point(x + segment.x_position, y + line.ascender), segment_text, segment.color);
+			canvas->drawText(run, run_pos, seg_start, seg_end, segment.color);
 	}
 }
 
@@ -211,9 +217,16 @@ SpanLayout::HitTestResult SpanLayout::HitTest(Canvas* canvas, const Point& pos)
 				// Check if we are inside a segment
 				if (pos.x >= x + segment.x_position && pos.x <= x + segment.x_position + segment.width)
 				{
-					std::string segment_text = text.substr(segment.start, segment.end - segment.start);
-					Point hit_point(pos.x - x - segment.x_position, 0);
-					size_t offset = segment.start + canvas->getCharacterIndex(segment.font, segment_text, hit_point);
+					size_t offset = segment.start;
+					if (segment.type == object_text)
+					{
+						const TextRun* run = GetTextRun(canvas, segment.object_index);
+						size_t run_start = objects[segment.object_index].start;
+						size_t seg_start = segment.start - run_start;
+						size_t seg_end = segment.end - run_start;
+						size_t index = run->getCharacterIndex(pos.x - x - segment.x_position + run->getPosition(seg_start));
+						offset = run_start + clamp(index, seg_start, seg_end);
+					}
 
 					result.type = SpanLayout::HitTestResult::inside;
 					result.object_id = segment.id;
@@ -295,9 +308,59 @@ void SpanLayout::AddText(const std::string& more_text, std::shared_ptr<Font> fon
 	object.color = color;
 	object.id = id;
 	objects.push_back(object);
+	InvalidateBlocks(text.length());
 	text += more_text;
 }
 
+void SpanLayout::SetText(const std::string& new_text, std::shared_ptr<Font> font, const Colorf& color, int id)
+{
+	if (objects.size() != 1 || objects[0].type != object_text || objects[0].font != font || objects[0].color != color || objects[0].id != id)
+	{
+		Clear();
+		AddText(new_text, std::move(font), color, id);
+		return;
+	}
+
+	if (new_text == text)
+		return;
+
+	size_t prefix = std::mismatch(text.begin(), text.begin() + std::min(text.size(), new_text.size()), new_text.begin()).first - text.begin();
+	InvalidateBlocks(prefix);
+	text = new_text;
+	objects[0].end = text.size();
+	if (objects[0].run)
+	{
+		previous_run = std::move(objects[0].run);
+		previous_run_unchanged = std::min(previous_run_unchanged, prefix);
+	}
+	else if (previous_run)
+	{
+		previous_run_unchanged = std::min(previous_run_unchanged, prefix);
+	}
+}
+
+void SpanLayout::InvalidateBlocks(size_t pos)
+{
+	// The block ending at pos is included since text inserted there could extend it
+	size_t index = std::lower_bound(blocks.begin(), blocks.begin() + std::min(dirty_block, blocks.size()), pos, [](const TextBlock& block, size_t pos) { return block.end < pos; }) - blocks.begin();
+	dirty_block = std::min(dirty_block, index);
+}
+
+TextRun* SpanLayout::GetTextRun(Canvas* canvas, size_t object_index)
+{
+	SpanObject& object = objects[object_index];
+	if (!object.run)
+	{
+		if (previous_run)
+			object.run = canvas->shapeText(object.font, text.substr(object.start, object.end - object.start), *previous_run, previous_run_unchanged);
+		else
+			object.run = canvas->shapeText(object.font, text.substr(object.start, object.end - object.start));
+		previous_run.reset();
+		previous_run_unchanged = (size_t)-1;
+	}
+	return object.run.get();
+}
+
 void SpanLayout::AddImage(std::shared_ptr<Image> image, double baseline_offset, int id)
 {
 	SpanObject object;
@@ -308,6 +371,7 @@ void SpanLayout::AddImage(std::shared_ptr<Image> image, double baseline_offset,
 	object.start = text.length();
 	object.end = object.start + 1;
 	objects.push_back(object);
+	InvalidateBlocks(text.length());
 	text += "*";
 }
 
@@ -321,6 +385,7 @@ void SpanLayout::AddWidget(Widget* component, double baseline_offset, int id)
 	object.start = text.length();
 	object.end = object.start + 1;
 	objects.push_back(object);
+	InvalidateBlocks(text.length());
 	text += "*";
 }
 
@@ -358,10 +423,11 @@ SpanLayout::TextSizeResult SpanLayout::FindTextSize(Canvas* canvas, const TextBl
 	double x_position = 0;
 	while (pos != block.end)
 	{
-		size_t end = std::min(objects[object_index].end, block.end);
-		std::string subtext = text.substr(pos, end - pos);
+		SpanObject& object = objects[object_index];
+		TextRun* run = GetTextRun(canvas, object_index);
 
-		Size text_size = canvas->measureText(font, subtext).size();
+		size_t end = std::min(object.end, block.end);
+		Size text_size(run->getWidth(pos - object.start, end - object.start), run->getHeight());
 
 		result.width += text_size.width;
 		result.height = std::max(result.height, layout_cache.metrics.height + layout_cache.metrics.external_leading);
@@ -372,7 +438,7 @@ SpanLayout::TextSizeResult SpanLayout::FindTextSize(Canvas* canvas, const TextBl
 		segment.type = object_text;
 		segment.start = pos;
 		segment.end = end;
-		segment.font = objects[object_index].font;
+		segment.object_index = object_index;
 		segment.color = objects[object_index].color;
 		segment.id = objects[object_index].id;
 		segment.x_position = x_position;
@@ -400,15 +466,13 @@ SpanLayout::TextSizeResult SpanLayout::FindTextSize(Canvas* canvas, const TextBl
 	return result;
 }
 
-std::vector<SpanLayout::TextBlock> SpanLayout::FindTextBlocks()
+void SpanLayout::FindTextBlocks(size_t pos)
 {
-	std::vector<TextBlock> blocks;
 	std::vector<SpanObject>::iterator block_object_it;
 
 	// Find first object that is not text:
-	for (block_object_it = objects.begin(); block_object_it != objects.end() && (*block_object_it).type == object_text; ++block_object_it);
+	for (block_object_it = objects.begin(); block_object_it != objects.end() && ((*block_object_it).type == object_text || (*block_object_it).start < pos); ++block_object_it);
 
-	std::string::size_type pos = 0;
 	while (pos < text.size())
 	{
 		// Find end of text block:
@@ -466,8 +530,6 @@ std::vector<SpanLayout::TextBlock> SpanLayout::FindTextBlocks()
 
 		pos = end_pos;
 	}
-
-	return blocks;
 }
 
 void SpanLayout::SetAlign(SpanAlign align)
@@ -477,23 +539,134 @@ void SpanLayout::SetAlign(SpanAlign align)
 
 void SpanLayout::LayoutLines(Canvas* canvas, double max_width)
 {
-	lines.clear();
 	if (objects.empty())
+	{
+		lines.clear();
 		return;
+	}
+
+	size_t first_line = FindFirstChangedLine(max_width);
 
-	layout_cache.metrics = {};
-	layout_cache.object_index = -1;
+	// Undo the alignment of the lines that are kept
+	for (Line& line : lines)
+	{
+		for (LineSegment& segment : line.segments)
+			segment.x_position = segment.unaligned_x;
+	}
+
+	if (!lines.empty() && first_line == lines.size())
+	{
+		layout_width = max_width;
+		return;
+	}
+
+	size_t first_block = first_line < lines.size() ? lines[first_line].first_block : 0;
+	if (first_line == 0)
+	{
+		floats_left.clear();
+		floats_right.clear();
+		layout_cache.metrics = {};
+		layout_cache.object_index = -1;
+	}
+
+	if (dirty_block < blocks.size() || blocks.empty())
+	{
+		size_t pos = dirty_block < blocks.size() ? blocks[dirty_block].start : 0;
+		blocks.resize(dirty_block < blocks.size() ? dirty_block : 0);
+		FindTextBlocks(pos);
+	}
 
 	CurrentLine current_line;
-	std::vector<TextBlock> blocks = FindTextBlocks();
-	for (std::vector<TextBlock>::size_type block_index = 0; block_index < blocks.size(); block_index++)
+	for (size_t i = 0; i < first_line; i++)
+		current_line.y_position += lines[i].height;
+	lines.resize(first_line);
+	current_line.cur_line.first_block = first_block;
+	if (first_block < blocks.size())
+		current_line.object_index = blocks[first_block].object_index;
+
+	for (std::vector<TextBlock>::size_type block_index = first_block; block_index < blocks.size(); block_index++)
 	{
+		blocks[block_index].object_index = current_line.object_index;
+		current_line.next_block = block_index;
 		if (objects[current_line.object_index].type == object_text)
 			LayoutText(canvas, blocks, block_index, current_line, max_width);
 		else
 			LayoutBlock(current_line, max_width, blocks, block_index);
 	}
+	current_line.next_block = blocks.size();
 	NextLine(current_line);
+
+	// The alignment is derived from the unaligned positions, so that undoing it restores them exactly
+	for (size_t i = first_line; i < lines.size(); i++)
+	{
+		for (LineSegment& segment : lines[i].segments)
+			segment.unaligned_x = segment.x_position;
+	}
+
+	dirty_block = blocks.size();
+	layout_width = max_width;
+}
+
+size_t SpanLayout::FindFirstChangedLine(double max_width)
+{
+	// Images and widgets can change size between layouts
+	for (const SpanObject& object : objects)
+	{
+		if (object.type != object_text)
+			return 0;
+	}
+
+	if (lines.empty() || dirty_block == 0)
+		return 0;
+
+	size_t first_line = lines.size();
+	if (dirty_block < blocks.size())
+	{
+		// The edited word could now fit at the end of the line before it
+		size_t block = dirty_block - 1;
+		first_line = std::upper_bound(lines.begin(), lines.end(), block, [](size_t block, const Line& line) { return block < line.first_block; }) - lines.begin();
+		first_line = first_line > 0 ? first_line - 1 : 0;
+	}
+
+	if (max_width != layout_width)
+	{
+		for (size_t i = 0; i < first_line; i++)
+		{
+			size_t next_block = i + 1 < lines.size() ? lines[i + 1].first_block : blocks.size();
+			if (!IsLineUnchanged(lines[i].first_block, next_block, max_width))
+				return i;
+		}
+	}
+
+	return first_line;
+}
+
+bool SpanLayout::IsLineUnchanged(size_t first_block, size_t next_block, double max_width)
+{
+	// Repeat the line breaking decisions of LayoutText using the measured block widths
+	double x_position = 0;
+	for (size_t i = first_block; i < next_block; i++)
+	{
+		const TextBlock& block = blocks[i];
+		if (IsNewline(block))
+			return i + 1 == next_block;
+
+		if (!FitsOnLine(x_position, block.size, max_width) && !IsWhitespace(block))
+		{
+			if (!LargerThanLine(block.size, max_width) || x_position != 0)
+				return false;
+		}
+		x_position += block.size.width;
+	}
+
+	if (next_block == blocks.size())
+		return true;
+
+	// The first block of the next line must still need a line break
+	const TextBlock& block = blocks[next_block];
+	if (IsNewline(block) || IsWhitespace(block) || FitsOnLine(x_position, block.size, max_width))
+		return false;
+	return !LargerThanLine(block.size, max_width) || x_position != 0;
 }
 
 void SpanLayout::LayoutBlock(CurrentLine& current_line, double max_width, std::vector<TextBlock>& blocks, std::vector<TextBlock>::size_type block_index)
@@ -510,17 +683,16 @@ void SpanLayout::LayoutInlineBlock(CurrentLine& current_line, double max_width,
 {
 	Size size;
 	LineSegment segment;
+	segment.object_index = current_line.object_index;
 	if (objects[current_line.object_index].type == object_image)
 	{
 		size = Size(objects[current_line.object_index].image->GetWidth(), objects[current_line.object_index].image->GetHeight());
 		segment.type = object_image;
-		segment.image = objects[current_line.object_index].image;
 	}
 	else if (objects[current_line.object_index].type == object_component)
 	{
 		size = objects[current_line.object_index].component->GetSize();
 		segment.type = object_component;
-		segment.component = objects[current_line.object_index].component;
 	}
 
 	if (current_line.x_position + size.width > max_width)
@@ -618,9 +790,16 @@ bool SpanLayout::BoxFitsOnLine(const FloatBox& box, double max_width)
 	return true;
 }
 
-void SpanLayout::LayoutText(Canvas* canvas, std::vector<TextBlock> blocks, std::vector<TextBlock>::size_type block_index, CurrentLine& current_line, double max_width)
+void SpanLayout::LayoutText(Canvas* canvas, std::vector<TextBlock>& blocks, std::vector<TextBlock>::size_type block_index, CurrentLine& current_line, double max_width)
 {
-	TextSizeResult text_size_result = FindTextSize(canvas, blocks[block_index], current_line.object_index);
+	TextBlock& block = blocks[block_index];
+	if (!block.measured)
+	{
+		block.size = FindTextSize(canvas, block, current_line.object_index);
+		block.measured = true;
+	}
+
+	TextSizeResult& text_size_result = block.size;
 	current_line.object_index += text_size_result.objects_traversed;
 
 	current_line.cur_line.width = current_line.x_position;
@@ -629,6 +808,7 @@ void SpanLayout::LayoutText(Canvas* canvas, std::vector<TextBlock> blocks, std::
 	{
 		current_line.cur_line.height = std::max(current_line.cur_line.height, text_size_result.height);
 		current_line.cur_line.ascender = std::max(current_line.cur_line.ascender, text_size_result.ascender);
+		current_line.next_block = block_index + 1;
 		NextLine(current_line);
 	}
 	else
@@ -683,6 +863,7 @@ void SpanLayout::NextLine(CurrentLine& current_line)
 	double height = current_line.cur_line.height;
 	lines.push_back(current_line.cur_line);
 	current_line.cur_line = Line();
+	current_line.cur_line.first_block = current_line.next_block;
 	current_line.x_position = 0;
 	current_line.y_position += height;
 }
@@ -740,7 +921,7 @@ void SpanLayout::AlignRight(double max_width)
 		for (std::vector<LineSegment>::size_type segment_index = 0; segment_index < line.segments.size(); segment_index++)
 		{
 			LineSegment& segment = line.segments[segment_index];
-			segment.x_position += offset;
+			segment.x_position = segment.unaligned_x + offset;
 		}
 	}
 }
@@ -756,7 +937,7 @@ void SpanLayout::AlignCenter(double max_width)
 		for (std::vector<LineSegment>::size_type segment_index = 0; segment_index < line.segments.size(); segment_index++)
 		{
 			LineSegment& segment = line.segments[segment_index];
-			segment.x_position += offset;
+			segment.x_position = segment.unaligned_x + offset;
 		}
 	}
 }
@@ -776,7 +957,7 @@ void SpanLayout::AlignJustify(double max_width)
 		for (std::vector<LineSegment>::size_type segment_index = 0; segment_index < line.segments.size(); segment_index++)
 		{
 			LineSegment& segment = line.segments[segment_index];
-			segment.x_position += (offset * segment_index) / (line.segments.size() - 1);
+			segment.x_position = segment.unaligned_x + (offset * segment_index) / (line.segments.size() - 1);
 		}
 	}
 }
@@ -795,6 +976,16 @@ void SpanLayout::SetSelectionRange(std::string::size_type start, std::string::si
 		sel_end = sel_start;
 }
 
+void SpanLayout::SetHighlightRanges(std::vector<std::pair<std::string::size_type, std::string::size_type>> ranges)
+{
+	highlight_ranges = std::move(ranges);
+}
+
+void SpanLayout::SetHighlightColor(const Colorf& background)
+{
+	highlight_background = background;
+}
+
 void SpanLayout::SetSelectionColors(const Colorf& foreground, const Colorf& background)
 {
 	sel_foreground = foreground;
@@ -841,10 +1032,11 @@ void SpanLayout::SetComponentGeometry()
 		{
 			if (lines[i].segments[j].type == object_component)
 			{
+				Widget* component = objects[lines[i].segments[j].object_index].component;
 				Point pos(x + lines[i].segments[j].x_position, y + lines[i].ascender - lines[i].segments[j].ascender);
-				Size size = lines[i].segments[j].component->GetSize();
+				Size size = component->GetSize();
 				Rect rect(pos, size);
-				lines[i].segments[j].component->SetFrameGeometry(rect);
+				component->SetFrameGeometry(rect);
 			}
 		}
 		y += lines[i].height;
@@ -0,0 +1,595 @@
+
+#include "core/text_document.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class TextBufferImpl : public TextBuffer
+{
+public:
+	TextBufferImpl(std::string text) : Text(std::move(text))
+	{
+	}
+
+	const char* GetData() const override
+	{
+		return Text.data();
+	}
+
+	size_t GetSize() const override
+	{
+		return Text.size();
+	}
+
+	std::string Text;
+};
+
+class MappedTextBuffer : public TextBuffer
+{
+public:
+	MappedTextBuffer(const std::string& filename)
+	{
+#ifdef _WIN32
+		std::wstring wfilename(MultiByteToWideChar(CP_UTF8, 0, filename.data(), (int)filename.size(), nullptr, 0), 0);
+		MultiByteToWideChar(CP_UTF8, 0, filename.data(), (int)filename.size(), wfilename.data(), (int)wfilename.size());
+
+		File = CreateFileW(wfilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (File == INVALID_HANDLE_VALUE)
+			throw std::runtime_error("Could not open: " + filename);
+
+		LARGE_INTEGER filesize = {};
+		GetFileSizeEx(File, &filesize);
+		Size = (size_t)filesize.QuadPart;
+		if (Size == 0)
+			return;
+
+		Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!Mapping)
+		{
+			CloseHandle(File);
+			throw std::runtime_error("Could not map: " + filename);
+		}
+
+		Data = (const char*)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!Data)
+		{
+			CloseHandle(Mapping);
+			CloseHandle(File);
+			throw std::runtime_error("Could not map: " + filename);
+		}
+#else
+		int fd = open(filename.c_str(), O_RDONLY);
+		if (fd == -1)
+			throw std::runtime_error("Could not open: " + filename);
+
+		struct stat st = {};
+		if (fstat(fd, &st) == -1)
+		{
+			close(fd);
+			throw std::runtime_error("Could not stat: " + filename);
+		}
+
+		Size = (size_t)st.st_size;
+		if (Size != 0)
+		{
+			void* data = mmap(nullptr, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				close(fd);
+				throw std::runtime_error("Could not map: " + filename);
+			}
+			Data = (const char*)data;
+		}
+		close(fd);
+#endif
+	}
+
+	~MappedTextBuffer()
+	{
+#ifdef _WIN32
+		if (Data)
+			UnmapViewOfFile(Data);
+		if (Mapping)
+			CloseHandle(Mapping);
+		if (File != INVALID_HANDLE_VALUE)
+			CloseHandle(File);
+#else
+		if (Data)
+			munmap((void*)Data, Size);
+#endif
+	}
+
+	const char* GetData() const override
+	{
+		return Data ? Data : "";
+	}
+
+	size_t GetSize() const override
+	{
+		return Size;
+	}
+
+	const char* Data = nullptr;
+	size_t Size = 0;
+#ifdef _WIN32
+	HANDLE File = INVALID_HANDLE_VALUE;
+	HANDLE Mapping = nullptr;
+#endif
+};
+
+// Inserted text is copied into fixed size blocks. Existing bytes never move or change, so snapshots can refer to them.
+class AppendTextBuffer : public TextBuffer
+{
+public:
+	AppendTextBuffer(size_t capacity) : Data(new char[capacity]), Capacity(capacity)
+	{
+	}
+
+	const char* GetData() const override
+	{
+		return Data.get();
+	}
+
+	size_t GetSize() const override
+	{
+		return Size;
+	}
+
+	std::unique_ptr<char[]> Data;
+	size_t Capacity = 0;
+	size_t Size = 0;
+};
+
+std::shared_ptr<TextBuffer> TextBuffer::Create(std::string text)
+{
+	return std::make_shared<TextBufferImpl>(std::move(text));
+}
+
+std::shared_ptr<TextBuffer> TextBuffer::MapFile(const std::string& filename)
+{
+	return std::make_shared<MappedTextBuffer>(filename);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void FindNewlines(const char* data, size_t size, size_t base, std::vector<size_t>& newlines)
+{
+	const char* pos = data;
+	const char* end = data + size;
+	while (pos < end)
+	{
+		const char* found = (const char*)memchr(pos, '\n', end - pos);
+		if (!found)
+			break;
+		newlines.push_back(base + (found - data));
+		pos = found + 1;
+	}
+}
+
+TextDocument::TextDocument()
+{
+}
+
+size_t TextDocument::GetSize() const
+{
+	return root != -1 ? nodes[root].length : 0;
+}
+
+size_t TextDocument::GetLineCount() const
+{
+	return (root != -1 ? nodes[root].newlines : 0) + 1;
+}
+
+size_t TextDocument::GetLineStart(size_t line) const
+{
+	if (line == 0)
+		return 0;
+	if (line >= GetLineCount())
+		return GetSize();
+
+	// Find the newline ending the previous line
+	size_t offset = 0;
+	int node = root;
+	while (true)
+	{
+		const Node& n = nodes[node];
+		size_t leftNewlines = n.left != -1 ? nodes[n.left].newlines : 0;
+		if (line <= leftNewlines)
+		{
+			node = n.left;
+			continue;
+		}
+
+		line -= leftNewlines;
+		offset += n.left != -1 ? nodes[n.left].length : 0;
+		if (line <= n.piece.newlines)
+		{
+			const std::vector<size_t>& newlines = sources[n.piece.source].newlines;
+			size_t first = std::lower_bound(newlines.begin(), newlines.end(), n.piece.start) - newlines.begin();
+			return offset + (newlines[first + line - 1] - n.piece.start) + 1;
+		}
+
+		line -= n.piece.newlines;
+		offset += n.piece.length;
+		node = n.right;
+	}
+}
+
+size_t TextDocument::GetLineLength(size_t line) const
+{
+	if (line >= GetLineCount())
+		return 0;
+	size_t end = line + 1 < GetLineCount() ? GetLineStart(line + 1) - 1 : GetSize();
+	return end - GetLineStart(line);
+}
+
+size_t TextDocument::GetLineFromOffset(size_t offset) const
+{
+	offset = std::min(offset, GetSize());
+
+	// Count the newlines before the offset
+	size_t line = 0;
+	int node = root;
+	while (node != -1)
+	{
+		const Node& n = nodes[node];
+		size_t leftLength = n.left != -1 ? nodes[n.left].length : 0;
+		if (offset <= leftLength)
+		{
+			node = n.left;
+			continue;
+		}
+
+		offset -= leftLength;
+		line += n.left != -1 ? nodes[n.left].newlines : 0;
+		if (offset <= n.piece.length)
+			return line + CountNewlines(n.piece.source, n.piece.start, n.piece.start + offset);
+
+		offset -= n.piece.length;
+		line += n.piece.newlines;
+		node = n.right;
+	}
+	return line;
+}
+
+std::string TextDocument::GetText() const
+{
+	return GetText(0, GetSize());
+}
+
+std::string TextDocument::GetText(size_t offset, size_t length) const
+{
+	offset = std::min(offset, GetSize());
+	length = std::min(length, GetSize() - offset);
+
+	std::string text;
+	text.reserve(length);
+	GetText(root, offset, length, text);
+	return text;
+}
+
+std::string TextDocument::GetLineText(size_t line) const
+{
+	return GetText(GetLineStart(line), GetLineLength(line));
+}
+
+void TextDocument::Clear()
+{
+	sources.clear();
+	append_source = 0xffffffff;
+	nodes.clear();
+	free_nodes.clear();
+	root = -1;
+}
+
+void TextDocument::Append(std::shared_ptr<TextBuffer> buffer)
+{
+	if (!buffer || buffer->GetSize() == 0)
+		return;
+
+	Source source;
+	source.buffer = std::move(buffer);
+	FindNewlines(source.buffer->GetData(), source.buffer->GetSize(), 0, source.newlines);
+
+	Piece piece;
+	piece.source = (uint32_t)sources.size();
+	piece.start = 0;
+	piece.length = source.buffer->GetSize();
+	piece.newlines = source.newlines.size();
+
+	sources.push_back(std::move(source));
+	root = Merge(root, CreateNode(piece));
+}
+
+void TextDocument::Append(const std::string& text)
+{
+	Insert(GetSize(), text);
+}
+
+void TextDocument::Insert(size_t offset, const std::string& text)
+{
+	if (text.empty())
+		return;
+
+	offset = std::min(offset, GetSize());
+
+	AppendTextBuffer* block = append_source < sources.size() ? static_cast<AppendTextBuffer*>(sources[append_source].buffer.get()) : nullptr;
+	if (!block || block->Capacity - block->Size < text.size())
+	{
+		auto buffer = std::make_shared<AppendTextBuffer>(std::max(text.size(), (size_t)64 * 1024));
+		block = buffer.get();
+		append_source = (uint32_t)sources.size();
+		sources.emplace_back();
+		sources.back().buffer = std::move(buffer);
+	}
+
+	size_t start = block->Size;
+	memcpy(block->Data.get() + start, text.data(), text.size());
+	block->Size += text.size();
+
+	std::vector<size_t>& newlines = sources[append_source].newlines;
+	size_t firstNewline = newlines.size();
+	FindNewlines(text.data(), text.size(), start, newlines);
+	size_t count = newlines.size() - firstNewline;
+
+	int left, right;
+	Split(root, offset, left, right);
+
+	// Typing continues the previous insert when the piece before the offset ends where the append block ended
+	int last = left;
+	while (last != -1 && nodes[last].right != -1)
+		last = nodes[last].right;
+
+	if (last != -1 && nodes[last].piece.source == append_source && nodes[last].piece.start + nodes[last].piece.length == start)
+	{
+		for (int node = left; node != -1; node = nodes[node].right)
+		{
+			nodes[node].length += text.size();
+			nodes[node].newlines += count;
+		}
+		nodes[last].piece.length += text.size();
+		nodes[last].piece.newlines += count;
+	}
+	else
+	{
+		Piece piece;
+		piece.source = append_source;
+		piece.start = start;
+		piece.length = text.size();
+		piece.newlines = count;
+		left = Merge(left, CreateNode(piece));
+	}
+
+	root = Merge(left, right);
+}
+
+void TextDocument::Erase(size_t offset, size_t length)
+{
+	if (offset >= GetSize())
+		return;
+	length = std::min(length, GetSize() - offset);
+	if (length == 0)
+		return;
+
+	int left, middle, right;
+	Split(root, offset, left, middle);
+	Split(middle, length, middle, right);
+	FreeNodes(middle);
+	root = Merge(left, right);
+}
+
+TextSnapshot TextDocument::CreateSnapshot() const
+{
+	TextSnapshot snapshot;
+	for (const Source& source : sources)
+		snapshot.buffers.push_back(source.buffer);
+	CreateSnapshot(root, snapshot);
+	snapshot.size = GetSize();
+	return snapshot;
+}
+
+void TextDocument::CreateSnapshot(int node, TextSnapshot& snapshot) const
+{
+	if (node == -1)
+		return;
+
+	const Node& n = nodes[node];
+	CreateSnapshot(n.left, snapshot);
+	TextSnapshot::Span span;
+	span.data = GetSourceData(n.piece.source) + n.piece.start;
+	span.length = n.piece.length;
+	snapshot.spans.push_back(span);
+	CreateSnapshot(n.right, snapshot);
+}
+
+const char* TextDocument::GetSourceData(uint32_t source) const
+{
+	return sources[source].buffer->GetData();
+}
+
+size_t TextDocument::CountNewlines(uint32_t source, size_t start, size_t end) const
+{
+	const std::vector<size_t>& newlines = sources[source].newlines;
+	auto first = std::lower_bound(newlines.begin(), newlines.end(), start);
+	return std::lower_bound(first, newlines.end(), end) - first;
+}
+
+TextDocument::Piece TextDocument::CreatePiece(uint32_t source, size_t start, size_t length) const
+{
+	Piece piece;
+	piece.source = source;
+	piece.start = start;
+	piece.length = length;
+	piece.newlines = CountNewlines(source, start, start + length);
+	return piece;
+}
+
+int TextDocument::CreateNode(const Piece& piece)
+{
+	int node;
+	if (!free_nodes.empty())
+	{
+		node = free_nodes.back();
+		free_nodes.pop_back();
+	}
+	else
+	{
+		node = (int)nodes.size();
+		nodes.emplace_back();
+	}
+
+	// xorshift32
+	random_seed ^= random_seed << 13;
+	random_seed ^= random_seed >> 17;
+	random_seed ^= random_seed << 5;
+
+	Node& n = nodes[node];
+	n.piece = piece;
+	n.priority = random_seed;
+	n.left = -1;
+	n.right = -1;
+	n.length = piece.length;
+	n.newlines = piece.newlines;
+	return node;
+}
+
+void TextDocument::FreeNodes(int node)
+{
+	if (node == -1)
+		return;
+	FreeNodes(nodes[node].left);
+	FreeNodes(nodes[node].right);
+	free_nodes.push_back(node);
+}
+
+void TextDocument::UpdateNode(int node)
+{
+	Node& n = nodes[node];
+	n.length = n.piece.length;
+	n.newlines = n.piece.newlines;
+	if (n.left != -1)
+	{
+		n.length += nodes[n.left].length;
+		n.newlines += nodes[n.left].newlines;
+	}
+	if (n.right != -1)
+	{
+		n.length += nodes[n.right].length;
+		n.newlines += nodes[n.right].newlines;
+	}
+}
+
+void TextDocument::Split(int node, size_t offset, int& left, int& right)
+{
+	if (node == -1)
+	{
+		left = -1;
+		right = -1;
+		return;
+	}
+
+	// Note: nodes may be reallocated by the recursive calls
+	const Node& n = nodes[node];
+	size_t leftLength = n.left != -1 ? nodes[n.left].length : 0;
+	if (offset <= leftLength)
+	{
+		int child;
+		Split(n.left, offset, left, child);
+		nodes[node].left = child;
+		UpdateNode(node);
+		right = node;
+	}
+	else if (offset >= leftLength + n.piece.length)
+	{
+		int child;
+		Split(n.right, offset - leftLength - n.piece.length, child, right);
+		nodes[node].right = child;
+		UpdateNode(node);
+		left = node;
+	}
+	else
+	{
+		// The offset is inside this piece
+		size_t split = offset - leftLength;
+		Piece tail = n.piece;
+		tail.start += split;
+		tail.length -= split;
+		Piece head = CreatePiece(tail.source, n.piece.start, split);
+		tail.newlines -= head.newlines;
+
+		int tailNode = CreateNode(tail); // May reallocate nodes
+		Node& m = nodes[node];
+		m.piece = head;
+		nodes[tailNode].priority = m.priority; // Keeps the heap order as it takes over the right subtree
+		nodes[tailNode].right = m.right;
+		m.right = -1;
+		UpdateNode(node);
+		UpdateNode(tailNode);
+		left = node;
+		right = tailNode;
+	}
+}
+
+int TextDocument::Merge(int left, int right)
+{
+	if (left == -1)
+		return right;
+	if (right == -1)
+		return left;
+
+	if (nodes[left].priority > nodes[right].priority)
+	{
+		int merged = Merge(nodes[left].right, right);
+		nodes[left].right = merged;
+		UpdateNode(left);
+		return left;
+	}
+	else
+	{
+		int merged = Merge(left, nodes[right].left);
+		nodes[right].left = merged;
+		UpdateNode(right);
+		return right;
+	}
+}
+
+void TextDocument::GetText(int node, size_t offset, size_t length, std::string& text) const
+{
+	if (node == -1 || length == 0)
+		return;
+
+	const Node& n = nodes[node];
+	size_t leftLength = n.left != -1 ? nodes[n.left].length : 0;
+	if (offset < leftLength)
+	{
+		size_t count = std::min(length, leftLength - offset);
+		GetText(n.left, offset, count, text);
+		offset += count;
+		length -= count;
+		if (length == 0)
+			return;
+	}
+
+	offset -= leftLength;
+	if (length > 0 && offset < n.piece.length)
+	{
+		size_t count = std::min(length, n.piece.length - offset);
+		text.append(GetSourceData(n.piece.source) + n.piece.start + offset, count);
+		offset += count;
+		length -= count;
+	}
+
+	if (length > 0)
+		GetText(n.right, offset - n.piece.length, length, text);
+}
@@ -0,0 +1,286 @@
+
+#include "core/text_search.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define USE_SSE2
+#endif
+
+namespace
+{
+	char ToLowerAscii(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+	}
+
+	char ToUpperAscii(char c)
+	{
+		return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+	}
+
+	bool IsWordByte(int c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80;
+	}
+
+	// Finds the first byte equal to a or b
+	const char* FindFirstByte(const char* pos, const char* end, char a, char b)
+	{
+		if (a == b)
+			return (const char*)memchr(pos, a, end - pos);
+
+#ifdef USE_SSE2
+		__m128i va = _mm_set1_epi8(a);
+		__m128i vb = _mm_set1_epi8(b);
+		while (end - pos >= 16)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*)pos);
+			if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, va), _mm_cmpeq_epi8(bytes, vb))) != 0)
+				break;
+			pos += 16;
+		}
+#endif
+		for (; pos < end; pos++)
+		{
+			if (*pos == a || *pos == b)
+				return pos;
+		}
+		return nullptr;
+	}
+
+	bool CompareBytes(const char* text, const char* pattern, size_t length, bool matchCase)
+	{
+		if (matchCase)
+			return memcmp(text, pattern, length) == 0;
+
+		for (size_t i = 0; i < length; i++)
+		{
+			if (ToLowerAscii(text[i]) != pattern[i])
+				return false;
+		}
+		return true;
+	}
+
+	// Compares the pattern against text that may continue into the following spans
+	bool MatchesAt(const std::vector<TextSnapshot::Span>& spans, size_t span, size_t pos, const std::string& pattern, bool matchCase)
+	{
+		size_t matched = 0;
+		while (matched < pattern.size())
+		{
+			if (span == spans.size())
+				return false;
+
+			size_t count = std::min(pattern.size() - matched, spans[span].length - pos);
+			if (!CompareBytes(spans[span].data + pos, pattern.data() + matched, count, matchCase))
+				return false;
+
+			matched += count;
+			span++;
+			pos = 0;
+		}
+		return true;
+	}
+
+	// Returns the byte at a position relative to the start of a span, or -1 outside the text
+	int GetByte(const std::vector<TextSnapshot::Span>& spans, size_t span, ptrdiff_t pos)
+	{
+		while (pos < 0)
+		{
+			if (span == 0)
+				return -1;
+			span--;
+			pos += spans[span].length;
+		}
+		while (span < spans.size() && (size_t)pos >= spans[span].length)
+		{
+			pos -= spans[span].length;
+			span++;
+		}
+		return span < spans.size() ? (unsigned char)spans[span].data[pos] : -1;
+	}
+}
+
+TextSearch::~TextSearch()
+{
+	Stop();
+}
+
+std::vector<TextSearch::Match> TextSearch::FindAll(const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options)
+{
+	return FindRange(snapshot, pattern, options, 0, snapshot.GetSize());
+}
+
+std::vector<TextSearch::Match> TextSearch::FindRange(const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options, size_t start, size_t end)
+{
+	std::vector<Match> matches;
+	std::atomic<bool> stop = false;
+	Search(snapshot, pattern, options, start, end, stop, [&](std::vector<Match>& batch) { matches.insert(matches.end(), batch.begin(), batch.end()); });
+	return matches;
+}
+
+bool TextSearch::UpdateMatches(std::vector<Match>& matches, const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options, size_t offset, size_t length, size_t inserted)
+{
+	if (pattern.empty())
+		return false;
+
+	// Matches ending before the edit are kept. A match ending right at it is searched again, as a whole word match depends on the byte after it.
+	auto first = std::lower_bound(matches.begin(), matches.end(), offset, [](const Match& match, size_t pos) { return match.offset + match.length < pos; });
+
+	// The search continues where it was just before the edit: after the last kept match, or early enough to find matches overlapping the edit
+	size_t start = offset > pattern.size() ? offset - pattern.size() : 0;
+	if (first != matches.begin())
+		start = std::max(start, std::prev(first)->offset + std::prev(first)->length);
+
+	// Positions after the first byte following the edit see the same text as before, but the search only gets back in step with the old
+	// search at a position the old search also looked at, which is not the case inside an old match. Matches that overlap themselves
+	// can therefore make the search run on past the edit.
+	size_t pos = offset + inserted + 1;
+	std::vector<Match> found = FindRange(snapshot, pattern, options, start, pos);
+	if (!found.empty())
+		pos = std::max(pos, found.back().offset + found.back().length);
+
+	auto next = first;
+	while (true)
+	{
+		size_t oldPos = pos + length - inserted;
+		while (next != matches.end() && next->offset + next->length <= oldPos)
+			++next;
+		if (next == matches.end() || next->offset >= oldPos)
+			break;
+
+		size_t end = next->offset + next->length + inserted - length;
+		std::vector<Match> more = FindRange(snapshot, pattern, options, pos, end);
+		found.insert(found.end(), more.begin(), more.end());
+		pos = more.empty() ? end : std::max(end, more.back().offset + more.back().length);
+	}
+
+	bool changed = next != first || !found.empty();
+	for (auto it = next; it != matches.end(); ++it)
+		it->offset = it->offset + inserted - length;
+	auto last = matches.erase(first, next);
+	matches.insert(last, found.begin(), found.end());
+	return changed;
+}
+
+void TextSearch::Start(TextSnapshot snapshot, const std::string& pattern, const TextSearchOptions& options)
+{
+	Stop();
+
+	running = true;
+	worker = std::thread([this, snapshot = std::move(snapshot), pattern, options]()
+	{
+		Search(snapshot, pattern, options, 0, snapshot.GetSize(), stop_flag, [this](std::vector<Match>& batch)
+		{
+			std::unique_lock lock(mutex);
+			found.insert(found.end(), batch.begin(), batch.end());
+		});
+
+		std::unique_lock lock(mutex);
+		running = false;
+	});
+}
+
+void TextSearch::Stop()
+{
+	if (worker.joinable())
+	{
+		stop_flag = true;
+		worker.join();
+		stop_flag = false;
+	}
+
+	found.clear();
+	running = false;
+}
+
+void TextSearch::Wait()
+{
+	if (worker.joinable())
+		worker.join();
+}
+
+bool TextSearch::Poll(std::vector<Match>& matches)
+{
+	std::unique_lock lock(mutex);
+	matches.insert(matches.end(), found.begin(), found.end());
+	found.clear();
+	return running;
+}
+
+void TextSearch::Search(const TextSnapshot& snapshot, const std::string& pattern, const TextSearchOptions& options, size_t start, size_t end, const std::atomic<bool>& stop, const std::function<void(std::vector<Match>& batch)>& onBatch)
+{
+	if (pattern.empty())
+		return;
+
+	std::string needle = pattern;
+	if (!options.match_case)
+	{
+		for (char& c : needle)
+			c = ToLowerAscii(c);
+	}
+	char first = needle[0];
+	char firstAlt = options.match_case ? first : ToUpperAscii(first);
+
+	const std::vector<TextSnapshot::Span>& spans = snapshot.GetSpans();
+	std::vector<Match> batch;
+	size_t spanOffset = 0;
+	size_t skip = start; // Bytes at the start of the span that come before the range or belong to the previous match
+	for (size_t i = 0; i < spans.size() && spanOffset < end; spanOffset += spans[i].length, i++)
+	{
+		if (stop)
+			return;
+
+		const char* data = spans[i].data;
+		size_t length = spans[i].length;
+		if (skip >= length)
+		{
+			skip -= length;
+			continue;
+		}
+
+		// Matches have to start before the end of the range
+		size_t scanEnd = std::min(length, end - spanOffset);
+		size_t pos = skip;
+		while (pos < scanEnd)
+		{
+			// Scan in chunks so that a stop request is noticed quickly in large buffers
+			size_t chunkEnd = std::min(scanEnd, pos + 1024 * 1024);
+			const char* candidate = FindFirstByte(data + pos, data + chunkEnd, first, firstAlt);
+			if (!candidate)
+			{
+				pos = chunkEnd;
+				if (stop)
+					return;
+				continue;
+			}
+
+			pos = candidate - data;
+			bool found = spanOffset + pos + needle.size() <= snapshot.GetSize() && MatchesAt(spans, i, pos, needle, options.match_case);
+			if (found && options.whole_word)
+				found = !IsWordByte(GetByte(spans, i, (ptrdiff_t)pos - 1)) && !IsWordByte(GetByte(spans, i, pos + needle.size()));
+
+			if (found)
+			{
+				batch.push_back({ spanOffset + pos, needle.size() });
+				pos += needle.size();
+				if (batch.size() == 1024)
+				{
+					onBatch(batch);
+					batch.clear();
+					if (stop)
+						return;
+				}
+			}
+			else
+			{
+				pos++;
+			}
+		}
+		skip = pos - length;
+	}
+
+	if (!batch.empty())
+		onBatch(batch);
+}
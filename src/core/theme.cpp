@@ -6,34 +6,141 @@
 #include "theme_style_tokenizer.h"
 #include <stdexcept>
 
+static int ThemeGeneration = 1;
+
+namespace
+{
+	const char* BuiltinStylePropertyNames[] =
+	{
+		"background-color",
+		"color",
+		"border-left-color",
+		"border-top-color",
+		"border-right-color",
+		"border-bottom-color",
+		"border-left-width",
+		"border-top-width",
+		"border-right-width",
+		"border-bottom-width",
+		"border-image-source",
+		"border-left-image-width",
+		"border-top-image-width",
+		"border-right-image-width",
+		"border-bottom-image-width",
+		"border-left-image-slice",
+		"border-top-image-slice",
+		"border-right-image-slice",
+		"border-bottom-image-slice",
+		"border-center-image-slice",
+		"noncontent-left",
+		"noncontent-top",
+		"noncontent-right",
+		"noncontent-bottom",
+		"font-family",
+		"font-size",
+		"selection-color",
+		"no-focus-selection-color",
+		"window-background",
+		"window-border",
+		"window-caption-color",
+		"window-caption-text-color",
+		"spacer-left",
+		"spacer-right",
+		"arrow-color",
+		"track-color",
+		"thumb-color",
+		"checked-color",
+		"checked-image",
+		"checked-align",
+		"checked-outer-border-color",
+		"checked-inner-border-color",
+		"unchecked-image",
+		"unchecked-align",
+		"unchecked-outer-border-color",
+		"unchecked-inner-border-color",
+		"grid-color",
+		"header-color",
+		"header-background-color",
+	};
+
+	static_assert(sizeof(BuiltinStylePropertyNames) / sizeof(BuiltinStylePropertyNames[0]) == StyleProperty::BuiltinCount, "Built-in style property names must match the StyleProperty IDs");
+
+	struct StylePropertyRegistry
+	{
+		StylePropertyRegistry()
+		{
+			for (const char* name : BuiltinStylePropertyNames)
+			{
+				IDs[name] = (StylePropertyID)Names.size();
+				Names.push_back(name);
+			}
+		}
+
+		std::vector<std::string> Names;
+		std::unordered_map<std::string, StylePropertyID> IDs;
+	};
+
+	StylePropertyRegistry& GetStylePropertyRegistry()
+	{
+		static StylePropertyRegistry registry;
+		return registry;
+	}
+}
+
+StylePropertyID StyleProperty::Intern(const std::string& name)
+{
+	StylePropertyRegistry& registry = GetStylePropertyRegistry();
+	auto it = registry.IDs.find(name);
+	if (it != registry.IDs.end())
+		return it->second;
+
+	StylePropertyID id = (StylePropertyID)registry.Names.size();
+	registry.IDs[name] = id;
+	registry.Names.push_back(name);
+	return id;
+}
+
+const std::string& StyleProperty::GetName(StylePropertyID id)
+{
+	return GetStylePropertyRegistry().Names.at(id);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 void WidgetStyle::SetBool(const std::string& state, const std::string& propertyName, bool value)
 {
 	StyleProperties[state][propertyName] = value;
+	ThemeGeneration++;
 }
 
 void WidgetStyle::SetInt(const std::string& state, const std::string& propertyName, int value)
 {
 	StyleProperties[state][propertyName] = value;
+	ThemeGeneration++;
 }
 
 void WidgetStyle::SetDouble(const std::string& state, const std::string& propertyName, double value)
 {
 	StyleProperties[state][propertyName] = value;
+	ThemeGeneration++;
 }
 
 void WidgetStyle::SetString(const std::string& state, const std::string& propertyName, const std::string& value)
 {
 	StyleProperties[state][propertyName] = value;
+	ThemeGeneration++;
 }
 
 void WidgetStyle::SetColor(const std::string& state, const std::string& propertyName, const Colorf& value)
 {
 	StyleProperties[state][propertyName] = value;
+	ThemeGeneration++;
 }
 
 void WidgetStyle::SetImage(const std::string& state, const std::string& propertyName, const std::shared_ptr<Image>& value)
 {
 	StyleProperties[state][propertyName] = value;
+	ThemeGeneration++;
 }
 
 const WidgetStyle::PropertyVariant* WidgetStyle::FindProperty(const std::string& state, const std::string& propertyName) const
@@ -67,6 +174,46 @@ const WidgetStyle::PropertyVariant* WidgetStyle::FindProperty(const std::string&
 	return nullptr;
 }
 
+const ResolvedWidgetStyle* WidgetStyle::GetResolvedStyle(const std::string& state)
+{
+	auto& resolved = ResolvedStyles[state];
+	if (!resolved)
+		resolved = std::make_unique<ResolvedWidgetStyle>();
+
+	if (resolved->Generation != ThemeGeneration)
+	{
+		resolved->Style = this;
+		resolved->Properties.assign(StyleProperty::BuiltinCount, nullptr);
+
+		// Same search order as FindProperty: the state, then the main style, then the parent style
+		for (const WidgetStyle* style = this; style; style = style->ParentStyle)
+		{
+			for (int i = 0; i < 2; i++)
+			{
+				if (i == 1 && state.empty())
+					break;
+
+				auto stateIt = style->StyleProperties.find(i == 0 ? state : std::string());
+				if (stateIt == style->StyleProperties.end())
+					continue;
+
+				for (auto& prop : stateIt->second)
+				{
+					StylePropertyID id = StyleProperty::Intern(prop.first);
+					if (id >= resolved->Properties.size())
+						resolved->Properties.resize(id + 1, nullptr);
+					if (!resolved->Properties[id])
+						resolved->Properties[id] = &prop.second;
+				}
+			}
+		}
+
+		resolved->StyleFont = GetFont(state);
+		resolved->Generation = ThemeGeneration;
+	}
+	return resolved.get();
+}
+
 std::shared_ptr<Font> WidgetStyle::GetFont(const std::string& state)
 {
 	auto& font = Fonts[state];
@@ -119,14 +266,14 @@ std::shared_ptr<Image> WidgetStyle::GetImage(const std::string& state, const std
 
 void BasicWidgetStyle::Paint(Widget* widget, Canvas* canvas, Size size)
 {
-	Colorf bgcolor = widget->GetStyleColor("background-color");
+	Colorf bgcolor = widget->GetStyleColor(StyleProperty::BackgroundColor);
 	if (bgcolor.a > 0.0f)
 		canvas->fillRect(Rect::xywh(0.0, 0.0, size.width, size.height), bgcolor);
 
-	Colorf borderleft = widget->GetStyleColor("border-left-color");
-	Colorf bordertop = widget->GetStyleColor("border-top-color");
-	Colorf borderright = widget->GetStyleColor("border-right-color");
-	Colorf borderbottom = widget->GetStyleColor("border-bottom-color");
+	Colorf borderleft = widget->GetStyleColor(StyleProperty::BorderLeftColor);
+	Colorf bordertop = widget->GetStyleColor(StyleProperty::BorderTopColor);
+	Colorf borderright = widget->GetStyleColor(StyleProperty::BorderRightColor);
+	Colorf borderbottom = widget->GetStyleColor(StyleProperty::BorderBottomColor);
 
 	double borderwidth = widget->GridFitSize(1.0);
 
@@ -139,27 +286,27 @@ void BasicWidgetStyle::Paint(Widget* widget, Canvas* canvas, Size size)
 	if (borderright.a > 0.0f)
 		canvas->fillRect(Rect::xywh(size.width - borderwidth, 0.0, borderwidth, size.height), borderright);
 
-	auto image = widget->GetStyleImage("border-image-source");
+	auto image = widget->GetStyleImage(StyleProperty::BorderImageSource);
 	if (image)
 	{
 		BorderGeometry geo;
 		geo.box = Rect::xywh(0.0, 0.0, size.width, size.height);
-		geo.border.left = widget->GetStyleDouble("border-left-width");
-		geo.border.right = widget->GetStyleDouble("border-right-width");
-		geo.border.top = widget->GetStyleDouble("border-top-width");
-		geo.border.bottom = widget->GetStyleDouble("border-bottom-width");
+		geo.border.left = widget->GetStyleDouble(StyleProperty::BorderLeftWidth);
+		geo.border.right = widget->GetStyleDouble(StyleProperty::BorderRightWidth);
+		geo.border.top = widget->GetStyleDouble(StyleProperty::BorderTopWidth);
+		geo.border.bottom = widget->GetStyleDouble(StyleProperty::BorderBottomWidth);
 
 		BorderImage style;
 		style.source = image;
-		style.width.left = widget->GetStyleDouble("border-left-image-width");
-		style.width.top = widget->GetStyleDouble("border-top-image-width");
-		style.width.right = widget->GetStyleDouble("border-right-image-width");
-		style.width.bottom = widget->GetStyleDouble("border-bottom-image-width");
-		style.slice.left = BorderImageValue(widget->GetStyleDouble("border-left-image-slice"), BorderImageValueType::number);
-		style.slice.top = BorderImageValue(widget->GetStyleDouble("border-top-image-slice"), BorderImageValueType::number);
-		style.slice.right = BorderImageValue(widget->GetStyleDouble("border-right-image-slice"), BorderImageValueType::number);
-		style.slice.bottom = BorderImageValue(widget->GetStyleDouble("border-bottom-image-slice"), BorderImageValueType::number);
-		style.slice.center = widget->GetStyleBool("border-center-image-slice");
+		style.width.left = widget->GetStyleDouble(StyleProperty::BorderLeftImageWidth);
+		style.width.top = widget->GetStyleDouble(StyleProperty::BorderTopImageWidth);
+		style.width.right = widget->GetStyleDouble(StyleProperty::BorderRightImageWidth);
+		style.width.bottom = widget->GetStyleDouble(StyleProperty::BorderBottomImageWidth);
+		style.slice.left = BorderImageValue(widget->GetStyleDouble(StyleProperty::BorderLeftImageSlice), BorderImageValueType::number);
+		style.slice.top = BorderImageValue(widget->GetStyleDouble(StyleProperty::BorderTopImageSlice), BorderImageValueType::number);
+		style.slice.right = BorderImageValue(widget->GetStyleDouble(StyleProperty::BorderRightImageSlice), BorderImageValueType::number);
+		style.slice.bottom = BorderImageValue(widget->GetStyleDouble(StyleProperty::BorderBottomImageSlice), BorderImageValueType::number);
+		style.slice.center = widget->GetStyleBool(StyleProperty::BorderCenterImageSlice);
 
 		BorderImageRenderer::render(canvas, geo, style);
 	}
@@ -173,6 +320,7 @@ WidgetStyle* WidgetTheme::RegisterStyle(std::unique_ptr<WidgetStyle> widgetStyle
 {
 	auto& style = Styles[widgetClass];
 	style = std::move(widgetStyle);
+	ThemeGeneration++;
 	return style.get();
 }
 
@@ -189,6 +337,23 @@ WidgetStyle* WidgetTheme::GetStyle(const std::string& widgetClass)
 void WidgetTheme::SetTheme(std::unique_ptr<WidgetTheme> theme)
 {
 	CurrentTheme = std::move(theme);
+	ThemeGeneration++;
+	if (CurrentTheme)
+		CurrentTheme->ResolveStyles();
+}
+
+void WidgetTheme::ResolveStyles()
+{
+	// Flatten every state mentioned by a style or its parents so widgets never have to walk the fallback chain
+	for (auto& it : Styles)
+	{
+		WidgetStyle* style = it.second.get();
+		for (const WidgetStyle* cur = style; cur; cur = cur->ParentStyle)
+		{
+			for (auto& stateIt : cur->StyleProperties)
+				style->GetResolvedStyle(stateIt.first);
+		}
+	}
 }
 
 WidgetTheme* WidgetTheme::GetTheme()
@@ -196,6 +361,11 @@ WidgetTheme* WidgetTheme::GetTheme()
 	return CurrentTheme.get();
 }
 
+int WidgetTheme::GetGeneration()
+{
+	return ThemeGeneration;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 
 SimpleTheme::SimpleTheme(const ThemeColors& colors)
@@ -220,9 +390,12 @@ SimpleTheme::SimpleTheme(const ThemeColors& colors)
 	auto pushbutton = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "pushbutton");
 	auto lineedit = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "lineedit");
 	auto textedit = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "textedit");
+	auto logview = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "logview");
 	auto listview = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "listview");
 	auto listviewheader = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "listview-header");
 	auto listviewbody = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "listview-body");
+	auto treeview = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "treeview");
+	auto datagrid = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "datagrid");
 	auto dropdown = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "dropdown");
 	auto scrollbar = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "scrollbar");
 	auto tabbar = RegisterStyle(std::make_unique<BasicWidgetStyle>(widget), "tabbar");
@@ -306,6 +479,18 @@ SimpleTheme::SimpleTheme(const ThemeColors& colors)
 	textedit->SetColor("border-bottom-color", border);
 	textedit->SetColor("selection-color", bgHover);
 
+	logview->SetString("font-family", "monospace");
+	logview->SetDouble("noncontent-left", 8.0);
+	logview->SetDouble("noncontent-top", 8.0);
+	logview->SetDouble("noncontent-right", 8.0);
+	logview->SetDouble("noncontent-bottom", 8.0);
+	logview->SetColor("color", fgLight);
+	logview->SetColor("background-color", bgLight);
+	logview->SetColor("border-left-color", border);
+	logview->SetColor("border-top-color", border);
+	logview->SetColor("border-right-color", border);
+	logview->SetColor("border-bottom-color", border);
+
 	listview->SetDouble("noncontent-left", 10.0);
 	listview->SetDouble("noncontent-top", 10.0);
 	listview->SetDouble("noncontent-right", 3.0);
@@ -325,6 +510,33 @@ SimpleTheme::SimpleTheme(const ThemeColors& colors)
 	listviewbody->SetColor("color", fgLight);
 	listviewbody->SetColor("selection-color", bgHover);
 
+	treeview->SetDouble("noncontent-left", 10.0);
+	treeview->SetDouble("noncontent-top", 10.0);
+	treeview->SetDouble("noncontent-right", 3.0);
+	treeview->SetDouble("noncontent-bottom", 10.0);
+	treeview->SetColor("color", fgLight);
+	treeview->SetColor("background-color", bgLight);
+	treeview->SetColor("border-left-color", border);
+	treeview->SetColor("border-top-color", border);
+	treeview->SetColor("border-right-color", border);
+	treeview->SetColor("border-bottom-color", border);
+	treeview->SetColor("selection-color", bgHover);
+
+	datagrid->SetDouble("noncontent-left", 10.0);
+	datagrid->SetDouble("noncontent-top", 10.0);
+	datagrid->SetDouble("noncontent-right", 3.0);
+	datagrid->SetDouble("noncontent-bottom", 3.0);
+	datagrid->SetColor("color", fgLight);
+	datagrid->SetColor("background-color", bgLight);
+	datagrid->SetColor("border-left-color", border);
+	datagrid->SetColor("border-top-color", border);
+	datagrid->SetColor("border-right-color", border);
+	datagrid->SetColor("border-bottom-color", border);
+	datagrid->SetColor("selection-color", bgHover);
+	datagrid->SetColor("grid-color", divider);
+	datagrid->SetColor("header-color", fgLight);
+	datagrid->SetColor("header-background-color", bgAction);
+
 	dropdown->SetDouble("noncontent-left", 5.0);
 	dropdown->SetDouble("noncontent-top", 5.0);
 	dropdown->SetDouble("noncontent-right", 5.0);
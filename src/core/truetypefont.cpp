@@ -15,6 +15,9 @@
 
 TrueTypeFont::TrueTypeFont(std::shared_ptr<TTFDataBuffer> initdata, int ttcFontIndex) : data(std::move(initdata))
 {
+	std::fill(std::begin(BmpPages), std::end(BmpPages), (uint16_t)BmpPageNotLoaded);
+	BmpGlyphs.resize(256, 0);
+
 	if (data->size() > 0x7fffffff)
 		throw std::runtime_error("TTF file is larger than 2 gigabytes!");
 
@@ -588,6 +591,59 @@ float TrueTypeFont::F2DOT14_ToFloat(ttf_F2DOT14 v)
 }
 
 uint32_t TrueTypeFont::GetGlyphIndex(uint32_t c) const
+{
+	if (c < 0x10000)
+	{
+		uint16_t block = BmpPages[c >> 8];
+		if (block == BmpPageNotLoaded)
+			block = LoadBmpPage(c >> 8);
+		return BmpGlyphs[(block << 8) | (c & 0xff)];
+	}
+	return FindGlyphIndex(c);
+}
+
+void TrueTypeFont::GetGlyphIndices(const uint32_t* codepoints, uint32_t* glyphIndices, size_t count) const
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t c = codepoints[i];
+		if (c < 0x10000)
+		{
+			uint16_t block = BmpPages[c >> 8];
+			if (block == BmpPageNotLoaded)
+				block = LoadBmpPage(c >> 8);
+			glyphIndices[i] = BmpGlyphs[(block << 8) | (c & 0xff)];
+		}
+		else
+		{
+			glyphIndices[i] = FindGlyphIndex(c);
+		}
+	}
+}
+
+uint16_t TrueTypeFont::LoadBmpPage(uint32_t page) const
+{
+	uint32_t first = page << 8;
+	uint16_t glyphs[256];
+	bool empty = true;
+	for (uint32_t i = 0; i < 256; i++)
+	{
+		glyphs[i] = (uint16_t)FindGlyphIndex(first + i);
+		if (glyphs[i] != 0)
+			empty = false;
+	}
+
+	uint16_t block = 0;
+	if (!empty)
+	{
+		block = (uint16_t)(BmpGlyphs.size() >> 8);
+		BmpGlyphs.insert(BmpGlyphs.end(), glyphs, glyphs + 256);
+	}
+	BmpPages[page] = block;
+	return block;
+}
+
+uint32_t TrueTypeFont::FindGlyphIndex(uint32_t c) const
 {
 	auto it = std::lower_bound(Ranges.begin(), Ranges.end(), c, [](const TTF_GlyphRange& range, uint32_t c) { return range.endCharCode < c; });
 	if (it != Ranges.end() && c >= it->startCharCode && c <= it->endCharCode)
@@ -1946,77 +2002,189 @@ CFFPrivateDict TTF_CFF::LoadPrivateDict(TrueTypeFileReader& reader, CFFObjectDat
 class CFFGlyphOperands
 {
 public:
-	CFFGlyphOperands()
-	{
-		operands.reserve(48);
-	}
-
 	double& get(int index)
 	{
 		if (index < 0)
-		{
-			if ((size_t)(-index) > operands.size())
-				throw std::runtime_error("CFF operands out of bounds");
-			return operands[(int)operands.size() + index];
-		}
-		else
-		{
-			if ((size_t)index >= operands.size())
-				throw std::runtime_error("CFF operands out of bounds");
-			return operands[index];
-		}
+			index += count;
+		if (index < 0 || index >= count)
+			throw std::runtime_error("CFF operands out of bounds");
+		return operands[index];
 	}
 
 	int size() const
 	{
-		return (int)operands.size();
+		return count;
 	}
 
 	void clear()
 	{
-		operands.clear();
+		count = 0;
 	}
 
 	void push(double value)
 	{
-		if (operands.size() == 48)
+		if (count == MaxOperands)
 			throw std::runtime_error("Exceeded CFF operands limit");
-		operands.push_back(value);
+		operands[count++] = value;
 	}
 
-	void pop(int count)
+	void pop(int popcount)
 	{
-		if (operands.size() < (size_t)count)
+		if (count < popcount)
 			throw std::runtime_error("CFF operands out of bounds");
-		operands.resize(operands.size() - count);
+		count -= popcount;
 	}
 
 	void pop_front()
 	{
-		if (operands.empty())
+		if (count == 0)
 			throw std::runtime_error("CFF operands out of bounds");
-		operands.erase(operands.begin());
+		memmove(operands, operands + 1, (count - 1) * sizeof(double));
+		count--;
 	}
 
-	typedef std::vector<double>::const_iterator const_iterator;
-	typedef std::vector<double>::iterator iterator;
-	typedef std::vector<double>::const_reverse_iterator const_reverse_iterator;
-	typedef std::vector<double>::reverse_iterator reverse_iterator;
+	typedef const double* const_iterator;
+	typedef double* iterator;
+	typedef std::reverse_iterator<const double*> const_reverse_iterator;
+	typedef std::reverse_iterator<double*> reverse_iterator;
 
-	const_iterator begin() const { return operands.begin(); }
-	const_iterator end() const { return operands.end(); }
-	iterator begin() { return operands.begin(); }
-	iterator end() { return operands.end(); }
+	const_iterator begin() const { return operands; }
+	const_iterator end() const { return operands + count; }
+	iterator begin() { return operands; }
+	iterator end() { return operands + count; }
 
-	const_reverse_iterator rbegin() const { return operands.rbegin(); }
-	const_reverse_iterator rend() const { return operands.rend(); }
-	reverse_iterator rbegin() { return operands.rbegin(); }
-	reverse_iterator rend() { return operands.rend(); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+	reverse_iterator rbegin() { return reverse_iterator(end()); }
+	reverse_iterator rend() { return reverse_iterator(begin()); }
 
 private:
-	std::vector<double> operands;
+	enum { MaxOperands = 48 };
+	double operands[MaxOperands];
+	int count = 0;
 };
 
+void TrueTypeFont::DecodeCFFCharString(size_t start, size_t end, CFFCharStringSegment& segment) const
+{
+	if (end > cff.Record.length || start > end)
+		throw std::runtime_error("CFF charstring out of bounds");
+
+	const uint8_t* data = (const uint8_t*)this->data->data() + cff.Record.offset;
+	std::vector<CFFCharStringToken> tokens;
+	tokens.reserve((end - start) / 2 + 1);
+
+	size_t pos = start;
+	while (pos < end)
+	{
+		uint8_t b0 = data[pos++];
+		if (b0 >= 32)
+		{
+			if (b0 <= 246)
+			{
+				tokens.push_back({ (double)((int)b0 - 139), CFFCharStringToken::Operand });
+			}
+			else if (b0 <= 254)
+			{
+				if (pos + 1 > end)
+					throw std::runtime_error("Premature end of CFF charstring");
+				uint8_t b1 = data[pos++];
+				if (b0 <= 250)
+					tokens.push_back({ (double)(((int)b0 - 247) * 256 + b1 + 108), CFFCharStringToken::Operand });
+				else
+					tokens.push_back({ (double)(-((int)b0 - 251) * 256 - b1 - 108), CFFCharStringToken::Operand });
+			}
+			else
+			{
+				if (pos + 4 > end)
+					throw std::runtime_error("Premature end of CFF charstring");
+				int32_t fixed16 = (int32_t)(((uint32_t)data[pos] << 24) | ((uint32_t)data[pos + 1] << 16) | ((uint32_t)data[pos + 2] << 8) | (uint32_t)data[pos + 3]);
+				pos += 4;
+				tokens.push_back({ fixed16 / (double)(1 << 16), CFFCharStringToken::Operand });
+			}
+		}
+		else if (b0 == 28) // ShortInt
+		{
+			if (pos + 2 > end)
+				throw std::runtime_error("Premature end of CFF charstring");
+			int16_t value = (int16_t)((data[pos] << 8) | data[pos + 1]);
+			pos += 2;
+			tokens.push_back({ (double)value, CFFCharStringToken::Operand });
+		}
+		else
+		{
+			int oper = b0;
+			if (oper == 12)
+			{
+				if (pos + 1 > end)
+					throw std::runtime_error("Premature end of CFF charstring");
+				oper = 1200 + (int)data[pos++];
+			}
+
+			if (oper == 19 || oper == 20) // hintmask and cntrmask
+			{
+				// The number of mask bytes depends on the hint count at run time. The interpreter continues with the segment after them.
+				tokens.push_back({ (double)pos, oper });
+				break;
+			}
+
+			tokens.push_back({ 0.0, oper });
+			if (oper == 11 || oper == 14) // return and endchar
+				break;
+		}
+	}
+
+	if (tokens.empty() || (tokens.back().Operator != 11 && tokens.back().Operator != 14 && tokens.back().Operator != 19 && tokens.back().Operator != 20))
+		tokens.push_back({ 0.0, CFFCharStringToken::EndOfData });
+
+	segment.Start = start;
+	segment.End = end;
+	segment.Tokens = std::move(tokens);
+}
+
+const CFFCharStringSegment* TrueTypeFont::GetCFFSubroutine(std::vector<std::unique_ptr<CFFCharStringSegment>>& cache, const std::vector<CFFObjectData>& subroutines, double index) const
+{
+	if (subroutines.size() < 1240)
+		index += 107;
+	else if (subroutines.size() < 33900)
+		index += 1131;
+	else
+		index += 32768;
+	if ((int)index < 0 || (int)subroutines.size() <= (int)index)
+		throw std::runtime_error("CFF subroutine index out of bounds");
+
+	if (cache.empty())
+		cache.resize(subroutines.size());
+
+	std::unique_ptr<CFFCharStringSegment>& segment = cache[(int)index];
+	if (!segment)
+	{
+		auto decoded = std::make_unique<CFFCharStringSegment>();
+		DecodeCFFCharString(subroutines[(int)index].Offset, subroutines[(int)index].Offset + subroutines[(int)index].Size, *decoded);
+		segment = std::move(decoded);
+	}
+	return segment.get();
+}
+
+const CFFCharStringSegment* TrueTypeFont::GetCFFContinuation(const CFFCharStringSegment* segment, size_t start, std::vector<std::unique_ptr<CFFCharStringSegment>>& temporary) const
+{
+	if (start > segment->End)
+		throw std::runtime_error("Premature end of CFF charstring");
+
+	CFFCharStringSegment* mutableSegment = const_cast<CFFCharStringSegment*>(segment);
+	if (!mutableSegment->Next)
+	{
+		mutableSegment->Next = std::make_unique<CFFCharStringSegment>();
+		DecodeCFFCharString(start, segment->End, *mutableSegment->Next);
+	}
+	if (segment->Next->Start == start)
+		return segment->Next.get();
+
+	// The mask length depends on the hint count so far. Replacing Next could free a segment still on the call stack.
+	temporary.push_back(std::make_unique<CFFCharStringSegment>());
+	DecodeCFFCharString(start, segment->End, *temporary.back());
+	return temporary.back().get();
+}
+
 TrueTypeGlyph TrueTypeFont::LoadCFFGlyph(uint32_t glyphIndex, double height) const
 {
 	double scale = height / head.unitsPerEm;
@@ -2039,9 +2207,12 @@ TrueTypeGlyph TrueTypeFont::LoadCFFGlyph(uint32_t glyphIndex, double height) con
 	if (glyphIndex >= cff.CharStrings.size())
 		throw std::runtime_error("Glyph index out of bounds");
 
-	TrueTypeFileReader reader = cff.Record.GetReader(data->data(), data->size());
-	reader.Seek(cff.CharStrings[glyphIndex].Offset);
-	size_t endpos = cff.CharStrings[glyphIndex].Offset + cff.CharStrings[glyphIndex].Size;
+	// Glyph charstrings are decoded for this call only. Subroutines are shared by many glyphs and stay decoded in the subroutine caches.
+	CFFCharStringSegment charstring;
+	DecodeCFFCharString(cff.CharStrings[glyphIndex].Offset, cff.CharStrings[glyphIndex].Offset + cff.CharStrings[glyphIndex].Size, charstring);
+	std::vector<std::unique_ptr<CFFCharStringSegment>> temporary;
+	const CFFCharStringSegment* segment = &charstring;
+	size_t ip = 0;
 
 	// Create glyph path:
 	PathFillDesc path;
@@ -2049,7 +2220,7 @@ TrueTypeGlyph TrueTypeFont::LoadCFFGlyph(uint32_t glyphIndex, double height) con
 
 	CFFGlyphOperands operands;
 	std::array<double, 32> transient;
-	std::vector<std::pair<size_t, size_t>> callstack;
+	std::vector<std::pair<const CFFCharStringSegment*, size_t>> callstack;
 	callstack.reserve(10);
 	int hintCount = 0;
 
@@ -2059,42 +2230,14 @@ TrueTypeGlyph TrueTypeFont::LoadCFFGlyph(uint32_t glyphIndex, double height) con
 	PathPoint cur, cp1, cp2, flex1start;
 	while (!endchar)
 	{
-		if (reader.Position() >= endpos)
-			throw std::runtime_error("Premature end of CFF charstring");
-
-		uint8_t b0 = reader.ReadCard8();
-		if (b0 >= 32)
-		{
-			if (b0 <= 246)
-			{
-				operands.push((int)b0 - 139);
-			}
-			else if (b0 <= 250)
-			{
-				uint8_t b1 = reader.ReadCard8();
-				operands.push(((int)b0 - 247) * 256 + b1 + 108);
-			}
-			else if (b0 <= 254)
-			{
-				uint8_t b1 = reader.ReadCard8();
-				operands.push(-((int)b0 - 251) * 256 - b1 - 108);
-			}
-			else
-			{
-				int32_t fixed16 = reader.ReadCard32();
-				operands.push(fixed16 / (double)(1 << 16));
-			}
-		}
-		else if (b0 == 28) // ShortInt
+		const CFFCharStringToken& token = segment->Tokens[ip++];
+		if (token.Operator == CFFCharStringToken::Operand)
 		{
-			int16_t value = reader.ReadCard16();
-			operands.push(value);
+			operands.push(token.Value);
 		}
 		else
 		{
-			int oper = b0;
-			if (oper == 12)
-				oper = 1200 + (int)reader.ReadCard8();
+			int oper = token.Operator;
 
 			double tmp/*, fd*/;
 			switch (oper)
@@ -2649,26 +2792,21 @@ TrueTypeGlyph TrueTypeFont::LoadCFFGlyph(uint32_t glyphIndex, double height) con
 				operands.clear();
 				break;
 			case 19: // hintmask
-				if (widthArg)
-				{
-					widthArg = false;
-				}
-				for (int i = 0; i < hintCount; i += 8)
-				{
-					reader.ReadCard8();
-				}
-				operands.clear();
-				break;
 			case 20: // cntrmask
+				// Operands left on the stack are implicit vstem hints
 				if (widthArg)
 				{
+					if (operands.size() % 2 == 1)
+					{
+						//widthValue = cff.PrivateDict.norminalWidthX + operands.get(0);
+						operands.pop_front();
+					}
 					widthArg = false;
 				}
-				for (int i = 0; i < hintCount; i += 8)
-				{
-					reader.ReadCard8();
-				}
+				hintCount += operands.size() / 2;
 				operands.clear();
+				segment = GetCFFContinuation(segment, (size_t)token.Value + (hintCount + 7) / 8, temporary);
+				ip = 0;
 				break;
 
 			// Arithmetic operators:
@@ -2797,42 +2935,30 @@ TrueTypeGlyph TrueTypeFont::LoadCFFGlyph(uint32_t glyphIndex, double height) con
 
 			// Subroutine operators:
 			case 10: // callsubr
-				callstack.push_back({ reader.Position(), endpos });
-				tmp = operands.get(-1);
+				if (callstack.size() == 10)
+					throw std::runtime_error("CFF subroutine nesting too deep");
+				callstack.push_back({ segment, ip });
+				segment = GetCFFSubroutine(CFFLocalSubroutineCache, cff.LocalSubroutines, operands.get(-1));
 				operands.pop(1);
-				if (cff.LocalSubroutines.size() < 1240)
-					tmp += 107;
-				else if (cff.LocalSubroutines.size() < 33900)
-					tmp += 1131;
-				else
-					tmp += 32768;
-				if ((int)tmp >= 0 && (int)cff.LocalSubroutines.size() <= (int)tmp)
-					throw std::runtime_error("CFF local subroutine index out of bounds");
-				reader.Seek(cff.LocalSubroutines[(int)tmp].Offset);
-				endpos = cff.LocalSubroutines[(int)tmp].Offset + cff.LocalSubroutines[(int)tmp].Size;
+				ip = 0;
 				break;
 			case 29: // callgsubr
-				callstack.push_back({ reader.Position(), endpos });
-				tmp = operands.get(-1);
+				if (callstack.size() == 10)
+					throw std::runtime_error("CFF subroutine nesting too deep");
+				callstack.push_back({ segment, ip });
+				segment = GetCFFSubroutine(CFFGlobalSubroutineCache, cff.GlobalSubroutines, operands.get(-1));
 				operands.pop(1);
-				if (cff.GlobalSubroutines.size() < 1240)
-					tmp += 107;
-				else if (cff.GlobalSubroutines.size() < 33900)
-					tmp += 1131;
-				else
-					tmp += 32768;
-				if ((int)tmp >= 0 && (int)cff.GlobalSubroutines.size() <= (int)tmp)
-					throw std::runtime_error("CFF global subroutine index out of bounds");
-				reader.Seek(cff.GlobalSubroutines[(int)tmp].Offset);
-				endpos = cff.GlobalSubroutines[(int)tmp].Offset + cff.GlobalSubroutines[(int)tmp].Size;
+				ip = 0;
 				break;
 			case 11: // return
 				if (callstack.empty())
 					throw std::runtime_error("Invalid CFF return statement");
-				reader.Seek(callstack.back().first);
-				endpos = callstack.back().second;
+				segment = callstack.back().first;
+				ip = callstack.back().second;
 				callstack.pop_back();
 				break;
+			case CFFCharStringToken::EndOfData:
+				throw std::runtime_error("Premature end of CFF charstring");
 
 			// Obsolete operator:
 			case 1200: // dotsection (no-op)
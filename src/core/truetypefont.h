@@ -635,6 +635,23 @@ struct TTF_CFF // Compact Font Format
 	CFFPrivateDict LoadPrivateDict(TrueTypeFileReader& reader, CFFObjectData obj);
 };
 
+// A charstring decoded into operands and operators. Decoding stops at return, endchar, hintmask or cntrmask.
+struct CFFCharStringToken
+{
+	enum { Operand = -1, EndOfData = -2 };
+
+	double Value = 0.0; // Operand value, or the position after the operator for hintmask and cntrmask
+	int Operator = Operand;
+};
+
+struct CFFCharStringSegment
+{
+	size_t Start = 0;
+	size_t End = 0;
+	std::vector<CFFCharStringToken> Tokens;
+	std::unique_ptr<CFFCharStringSegment> Next; // Continuation after a hintmask or cntrmask
+};
+
 class TrueTypeGlyph
 {
 public:
@@ -676,6 +693,7 @@ public:
 	TTCFontName GetFontName() const;
 	TrueTypeTextMetrics GetTextMetrics(double height) const;
 	uint32_t GetGlyphIndex(uint32_t codepoint) const;
+	void GetGlyphIndices(const uint32_t* codepoints, uint32_t* glyphIndices, size_t count) const;
 	TrueTypeGlyph LoadGlyph(uint32_t glyphIndex, double height) const;
 
 	double GetAdvanceWidth(uint32_t glyphIndex, double height) const;
@@ -687,10 +705,15 @@ public:
 private:
 	TrueTypeGlyph LoadTTFGlyph(uint32_t glyphIndex, double height) const;
 	void LoadCharacterMapEncoding(TrueTypeFileReader& reader);
+	uint32_t FindGlyphIndex(uint32_t codepoint) const;
+	uint16_t LoadBmpPage(uint32_t page) const;
 	void LoadGlyph(TTF_SimpleGlyph& glyph, uint32_t glyphIndex, int compositeDepth = 0) const;
 	static float F2DOT14_ToFloat(ttf_F2DOT14 v);
 
 	TrueTypeGlyph LoadCFFGlyph(uint32_t glyphIndex, double height) const;
+	void DecodeCFFCharString(size_t start, size_t end, CFFCharStringSegment& segment) const;
+	const CFFCharStringSegment* GetCFFSubroutine(std::vector<std::unique_ptr<CFFCharStringSegment>>& cache, const std::vector<CFFObjectData>& subroutines, double index) const;
+	const CFFCharStringSegment* GetCFFContinuation(const CFFCharStringSegment* segment, size_t start, std::vector<std::unique_ptr<CFFCharStringSegment>>& temporary) const;
 
 	std::shared_ptr<TTFDataBuffer> data;
 
@@ -712,7 +735,15 @@ private:
 
 	// CFF outlines
 	TTF_CFF cff;
+	mutable std::vector<std::unique_ptr<CFFCharStringSegment>> CFFLocalSubroutineCache; // Decoded on first call
+	mutable std::vector<std::unique_ptr<CFFCharStringSegment>> CFFGlobalSubroutineCache;
 
 	std::vector<TTF_GlyphRange> Ranges;
 	std::vector<TTF_GlyphRange> ManyToOneRanges;
+
+	// Direct lookup table for the Basic Multilingual Plane, built one 256 character page at a time on first use.
+	// BmpPages maps the high byte of a character to a block in BmpGlyphs. Block 0 is shared by all pages without any glyphs.
+	enum { BmpPageNotLoaded = 0xffff };
+	mutable uint16_t BmpPages[256];
+	mutable std::vector<uint16_t> BmpGlyphs;
 };
@@ -0,0 +1,156 @@
+
+#include "core/type_ahead_index.h"
+#include <algorithm>
+#include <numeric>
+
+void TypeAheadIndex::SetMatchSubstring(bool enable)
+{
+	if (match_substring != enable)
+	{
+		match_substring = enable;
+		Clear();
+	}
+}
+
+void TypeAheadIndex::Clear()
+{
+	texts.clear();
+	offsets.clear();
+	sorted.clear();
+	trigrams.clear();
+}
+
+void TypeAheadIndex::Build(int count, const std::function<std::string(int row)>& getText)
+{
+	Clear();
+
+	offsets.reserve(count + 1);
+	for (int row = 0; row < count; row++)
+	{
+		offsets.push_back(texts.size());
+		texts += Fold(getText(row));
+		texts.push_back(0);
+	}
+	offsets.push_back(texts.size());
+
+	if (!match_substring)
+	{
+		sorted.resize(count);
+		std::iota(sorted.begin(), sorted.end(), 0);
+		std::sort(sorted.begin(), sorted.end(), [this](int a, int b) { return GetText(a) < GetText(b); });
+	}
+	else
+	{
+		std::vector<uint32_t> rowTrigrams;
+		for (int row = 0; row < count; row++)
+		{
+			std::string_view text = GetText(row);
+			rowTrigrams.clear();
+			for (size_t i = 0; i + 3 <= text.size(); i++)
+				rowTrigrams.push_back(GetTrigram(text.data() + i));
+			std::sort(rowTrigrams.begin(), rowTrigrams.end());
+			rowTrigrams.erase(std::unique(rowTrigrams.begin(), rowTrigrams.end()), rowTrigrams.end());
+			for (uint32_t trigram : rowTrigrams)
+				trigrams[trigram].push_back(row);
+		}
+	}
+}
+
+std::vector<int> TypeAheadIndex::FindAll(const std::string& pattern) const
+{
+	std::vector<int> rows;
+	std::string needle = Fold(pattern);
+	if (needle.empty())
+	{
+		rows.resize(GetCount());
+		std::iota(rows.begin(), rows.end(), 0);
+		return rows;
+	}
+
+	if (!match_substring)
+	{
+		// The rows starting with the pattern follow each other in the sorted list
+		auto first = std::lower_bound(sorted.begin(), sorted.end(), needle, [this](int row, const std::string& needle) { return GetText(row) < needle; });
+		auto last = std::partition_point(first, sorted.end(), [&](int row) { return GetText(row).substr(0, needle.size()) == needle; });
+		rows.assign(first, last);
+		std::sort(rows.begin(), rows.end());
+	}
+	else if (needle.size() >= 3)
+	{
+		// Only check the rows containing the rarest sequence of the pattern
+		const std::vector<int>* candidates = nullptr;
+		for (size_t i = 0; i + 3 <= needle.size(); i++)
+		{
+			auto it = trigrams.find(GetTrigram(needle.data() + i));
+			if (it == trigrams.end())
+				return rows;
+			if (!candidates || it->second.size() < candidates->size())
+				candidates = &it->second;
+		}
+
+		for (int row : *candidates)
+		{
+			if (needle.size() == 3 || GetText(row).find(needle) != std::string_view::npos)
+				rows.push_back(row);
+		}
+	}
+	else
+	{
+		// Too short for the sequences. Scan all the text at once instead.
+		int row = 0;
+		size_t pos = texts.find(needle);
+		while (pos != std::string::npos)
+		{
+			while (offsets[row + 1] <= pos)
+				row++;
+			rows.push_back(row);
+			pos = texts.find(needle, offsets[row + 1]);
+		}
+	}
+	return rows;
+}
+
+int TypeAheadIndex::FindNext(const std::string& pattern, int start) const
+{
+	if (!match_substring)
+	{
+		// Look through the rows starting with the pattern without putting them in order
+		std::string needle = Fold(pattern);
+		auto first = std::lower_bound(sorted.begin(), sorted.end(), needle, [this](int row, const std::string& needle) { return GetText(row) < needle; });
+		int next = -1;
+		int lowest = -1;
+		for (auto it = first; it != sorted.end() && GetText(*it).substr(0, needle.size()) == needle; ++it)
+		{
+			if (*it >= start && (next < 0 || *it < next))
+				next = *it;
+			if (lowest < 0 || *it < lowest)
+				lowest = *it;
+		}
+		return next >= 0 ? next : lowest;
+	}
+
+	std::vector<int> rows = FindAll(pattern);
+	if (rows.empty())
+		return -1;
+	auto it = std::lower_bound(rows.begin(), rows.end(), start);
+	return it != rows.end() ? *it : rows.front();
+}
+
+bool TypeAheadIndex::Matches(const std::string& text, const std::string& pattern, bool matchSubstring)
+{
+	std::string haystack = Fold(text);
+	std::string needle = Fold(pattern);
+	if (matchSubstring)
+		return haystack.find(needle) != std::string::npos;
+	return haystack.compare(0, needle.size(), needle) == 0;
+}
+
+std::string TypeAheadIndex::Fold(std::string text)
+{
+	for (char& c : text)
+	{
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+	}
+	return text;
+}
@@ -0,0 +1,107 @@
+
+#include "core/undo_journal.h"
+
+void UndoJournal::Record(size_t offset, std::string removed, std::string inserted, bool typingEdit)
+{
+	if (removed.empty() && inserted.empty())
+		return;
+
+	// Forget everything that was undone
+	while (edits.size() > position)
+	{
+		memory_used -= edits.back().removed.size() + edits.back().inserted.size();
+		edits.pop_back();
+	}
+
+	if (typingEdit && typing && !edits.empty())
+	{
+		Edit& last = edits.back();
+		bool merged = false;
+		if (removed.empty() && last.removed.empty() && offset == last.offset + last.inserted.size())
+		{
+			last.inserted += inserted;
+			merged = true;
+		}
+		else if (inserted.empty() && last.inserted.empty() && offset + removed.size() == last.offset) // Backspace
+		{
+			last.removed.insert(0, removed);
+			last.offset = offset;
+			merged = true;
+		}
+		else if (inserted.empty() && last.inserted.empty() && offset == last.offset) // Delete
+		{
+			last.removed += removed;
+			merged = true;
+		}
+
+		if (merged)
+		{
+			memory_used += removed.size() + inserted.size();
+			typing = inserted.find('\n') == std::string::npos; // A new line starts a new undo step
+			DiscardOldEdits();
+			return;
+		}
+	}
+
+	memory_used += removed.size() + inserted.size();
+	edits.push_back({ offset, std::move(removed), std::move(inserted) });
+	position = edits.size();
+	typing = typingEdit && edits.back().inserted.find('\n') == std::string::npos;
+	DiscardOldEdits();
+}
+
+void UndoJournal::EndTyping()
+{
+	typing = false;
+}
+
+void UndoJournal::Clear()
+{
+	edits.clear();
+	position = 0;
+	memory_used = 0;
+	typing = false;
+}
+
+bool UndoJournal::CanUndo() const
+{
+	return position > 0;
+}
+
+bool UndoJournal::CanRedo() const
+{
+	return position < edits.size();
+}
+
+const UndoJournal::Edit* UndoJournal::Undo()
+{
+	typing = false;
+	if (position == 0)
+		return nullptr;
+	return &edits[--position];
+}
+
+const UndoJournal::Edit* UndoJournal::Redo()
+{
+	typing = false;
+	if (position == edits.size())
+		return nullptr;
+	return &edits[position++];
+}
+
+void UndoJournal::SetMemoryLimit(size_t bytes)
+{
+	memory_limit = bytes;
+	DiscardOldEdits();
+}
+
+void UndoJournal::DiscardOldEdits()
+{
+	// Always keep the most recent edit so it can be undone
+	while (memory_used > memory_limit && position > 1)
+	{
+		memory_used -= edits.front().removed.size() + edits.front().inserted.size();
+		edits.pop_front();
+		position--;
+	}
+}
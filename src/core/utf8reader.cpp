@@ -20,6 +20,12 @@
 */
 
 #include "core/utf8reader.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define USE_SSE2
+#endif
 
 namespace
 {
@@ -44,6 +50,113 @@ namespace
 		0x03,
 		0x01
 	};
+
+	// Length of the ASCII run starting at data
+	static size_t ascii_run_length(const unsigned char* data, size_t length)
+	{
+		size_t pos = 0;
+#ifdef USE_SSE2
+		while (pos + 16 <= length && _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(data + pos))) == 0)
+			pos += 16;
+#else
+		while (pos + 8 <= length)
+		{
+			uint64_t block;
+			memcpy(&block, data + pos, 8);
+			if (block & 0x8080808080808080ULL)
+				break;
+			pos += 8;
+		}
+#endif
+		// The bytes after the last whole block, so the caller only probes again after a multibyte character
+		while (pos < length && data[pos] < 0x80)
+			pos++;
+		return pos;
+	}
+
+	static void widen_ascii(const unsigned char* data, size_t count, uint32_t* out)
+	{
+		size_t i = 0;
+#ifdef USE_SSE2
+		__m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i bytes = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			_mm_storeu_si128((__m128i*)(out + i), _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128((__m128i*)(out + i + 4), _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128((__m128i*)(out + i + 8), _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128((__m128i*)(out + i + 12), _mm_unpackhi_epi16(hi, zero));
+		}
+#endif
+		for (; i < count; i++)
+			out[i] = data[i];
+	}
+
+	static void ascii_offsets(uint32_t start, size_t count, uint32_t* out)
+	{
+		size_t i = 0;
+#ifdef USE_SSE2
+		__m128i offsets = _mm_add_epi32(_mm_set1_epi32((int)start), _mm_set_epi32(3, 2, 1, 0));
+		__m128i step = _mm_set1_epi32(4);
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_si128((__m128i*)(out + i), offsets);
+			offsets = _mm_add_epi32(offsets, step);
+		}
+#endif
+		for (; i < count; i++)
+			out[i] = start + (uint32_t)i;
+	}
+}
+
+size_t UTF8Reader::utf8_length(const std::string::value_type* text, std::string::size_type length)
+{
+	UTF8Reader reader(text, length);
+	size_t i = 0;
+	while (!reader.is_end())
+	{
+		size_t run = ascii_run_length(reader.data + reader.current_position, length - reader.current_position);
+		if (run != 0)
+		{
+			reader.current_position += run;
+			i += run;
+			continue;
+		}
+
+		reader.next();
+		i++;
+	}
+	return i;
+}
+
+size_t UTF8Reader::decode(const std::string::value_type* text, std::string::size_type length, uint32_t* out, uint32_t* byteOffsets)
+{
+	UTF8Reader reader(text, length);
+	size_t i = 0;
+	while (!reader.is_end())
+	{
+		size_t pos = reader.current_position;
+		size_t run = ascii_run_length(reader.data + pos, length - pos);
+		if (run != 0)
+		{
+			widen_ascii(reader.data + pos, run, out + i);
+			if (byteOffsets)
+				ascii_offsets((uint32_t)pos, run, byteOffsets + i);
+			reader.current_position += run;
+			i += run;
+			continue;
+		}
+
+		// Multibyte characters go through the scalar decoder one at a time
+		out[i] = reader.character();
+		if (byteOffsets)
+			byteOffsets[i] = (uint32_t)pos;
+		reader.next();
+		i++;
+	}
+	return i;
 }
 
 UTF8Reader::UTF8Reader(const std::string::value_type *text, std::string::size_type length) : length(length), data((unsigned char *)text)
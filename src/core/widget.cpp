@@ -20,13 +20,13 @@ Widget::Widget(Widget* parent, WidgetType type, RenderAPI renderAPI) : Type(type
 		}
 		SetStyleState("root");
 
-		SetWindowBackground(GetStyleColor("window-background"));
-		if (GetStyleColor("window-border").a > 0.0f)
-			SetWindowBorderColor(GetStyleColor("window-border"));
-		if (GetStyleColor("window-caption-color").a > 0.0f)
-			SetWindowCaptionColor(GetStyleColor("window-caption-color"));
-		if (GetStyleColor("window-caption-text-color").a > 0.0f)
-			SetWindowCaptionTextColor(GetStyleColor("window-caption-text-color"));
+		SetWindowBackground(GetStyleColor(StyleProperty::WindowBackground));
+		if (GetStyleColor(StyleProperty::WindowBorder).a > 0.0f)
+			SetWindowBorderColor(GetStyleColor(StyleProperty::WindowBorder));
+		if (GetStyleColor(StyleProperty::WindowCaptionColor).a > 0.0f)
+			SetWindowCaptionColor(GetStyleColor(StyleProperty::WindowCaptionColor));
+		if (GetStyleColor(StyleProperty::WindowCaptionTextColor).a > 0.0f)
+			SetWindowCaptionTextColor(GetStyleColor(StyleProperty::WindowCaptionTextColor));
 	}
 
 	SetParent(parent);
@@ -223,10 +223,10 @@ Rect Widget::GetFrameGeometry() const
 
 void Widget::SetNoncontentSizes(double left, double top, double right, double bottom)
 {
-	SetStyleDouble("noncontent-left", left);
-	SetStyleDouble("noncontent-top", top);
-	SetStyleDouble("noncontent-right", right);
-	SetStyleDouble("noncontent-bottom", bottom);
+	SetStyleDouble(StyleProperty::NoncontentLeft, left);
+	SetStyleDouble(StyleProperty::NoncontentTop, top);
+	SetStyleDouble(StyleProperty::NoncontentRight, right);
+	SetStyleDouble(StyleProperty::NoncontentBottom, bottom);
 }
 
 void Widget::SetFrameGeometry(const Rect& geometry)
@@ -234,19 +234,7 @@ void Widget::SetFrameGeometry(const Rect& geometry)
 	if (Type == WidgetType::Child)
 	{
 		FrameGeometry = geometry;
-		double left = FrameGeometry.left() + GetNoncontentLeft();
-		double top = FrameGeometry.top() + GetNoncontentTop();
-		double right = FrameGeometry.right() - GetNoncontentRight();
-		double bottom = FrameGeometry.bottom() - GetNoncontentBottom();
-		left = std::min(left, FrameGeometry.right());
-		top = std::min(top, FrameGeometry.bottom());
-		right = std::max(right, FrameGeometry.left());
-		bottom = std::max(bottom, FrameGeometry.top());
-		left = GridFitPoint(left);
-		top = GridFitPoint(top);
-		right = GridFitPoint(right);
-		bottom = GridFitPoint(bottom);
-		ContentGeometry = Rect::ltrb(left, top, std::max(right, left), std::max(bottom, top));
+		UpdateContentGeometry();
 
 		if (m_Layout)
 			m_Layout->OnGeometryChanged();
@@ -260,6 +248,44 @@ void Widget::SetFrameGeometry(const Rect& geometry)
 	}
 }
 
+void Widget::SetFramePosition(const Point& pos)
+{
+	if (Type != WidgetType::Child)
+	{
+		SetFrameGeometry(Rect(pos, GetFrameGeometry().size()));
+		return;
+	}
+
+	// Grid fitting the content box can change its size by a pixel, and then it has to be laid out again
+	Size oldSize = ContentGeometry.size();
+	FrameGeometry = Rect(pos, FrameGeometry.size());
+	UpdateContentGeometry();
+	if (ContentGeometry.width != oldSize.width || ContentGeometry.height != oldSize.height)
+	{
+		if (m_Layout)
+			m_Layout->OnGeometryChanged();
+
+		OnGeometryChanged();
+	}
+}
+
+void Widget::UpdateContentGeometry()
+{
+	double left = FrameGeometry.left() + GetNoncontentLeft();
+	double top = FrameGeometry.top() + GetNoncontentTop();
+	double right = FrameGeometry.right() - GetNoncontentRight();
+	double bottom = FrameGeometry.bottom() - GetNoncontentBottom();
+	left = std::min(left, FrameGeometry.right());
+	top = std::min(top, FrameGeometry.bottom());
+	right = std::max(right, FrameGeometry.left());
+	bottom = std::max(bottom, FrameGeometry.top());
+	left = GridFitPoint(left);
+	top = GridFitPoint(top);
+	right = GridFitPoint(right);
+	bottom = GridFitPoint(bottom);
+	ContentGeometry = Rect::ltrb(left, top, std::max(right, left), std::max(bottom, top));
+}
+
 void Widget::CheckInitialShow()
 {
 	if (Type != WidgetType::Child && !DispGeometrySet)
@@ -423,24 +449,211 @@ void Widget::SetWindowCaptionTextColor(const Colorf& color)
 	}
 }
 
+static bool IsEmptyRect(const Rect& box)
+{
+	return box.width <= 0.0 || box.height <= 0.0;
+}
+
+static Rect IntersectRect(const Rect& a, const Rect& b)
+{
+	double left = std::max(a.left(), b.left());
+	double top = std::max(a.top(), b.top());
+	double right = std::min(a.right(), b.right());
+	double bottom = std::min(a.bottom(), b.bottom());
+	return left < right && top < bottom ? Rect::ltrb(left, top, right, bottom) : Rect();
+}
+
+static Rect UnionRect(const Rect& a, const Rect& b)
+{
+	if (IsEmptyRect(a))
+		return b;
+	if (IsEmptyRect(b))
+		return a;
+	return Rect::ltrb(std::min(a.left(), b.left()), std::min(a.top(), b.top()), std::max(a.right(), b.right()), std::max(a.bottom(), b.bottom()));
+}
+
+static bool ContainsRect(const Rect& outer, const Rect& inner)
+{
+	return inner.left() >= outer.left() && inner.top() >= outer.top() && inner.right() <= outer.right() && inner.bottom() <= outer.bottom();
+}
+
+static void AddRepaintBox(std::vector<Rect>& boxes, const Rect& box)
+{
+	if (IsEmptyRect(box))
+		return;
+
+	for (const Rect& existing : boxes)
+	{
+		if (ContainsRect(existing, box))
+			return;
+	}
+	boxes.erase(std::remove_if(boxes.begin(), boxes.end(), [&](const Rect& existing) { return ContainsRect(box, existing); }), boxes.end());
+	boxes.push_back(box);
+
+	// Every box is painted on its own, so past a few of them one box around all of them is cheaper
+	const size_t maxBoxes = 8;
+	if (boxes.size() > maxBoxes)
+	{
+		Rect all;
+		for (const Rect& existing : boxes)
+			all = UnionRect(all, existing);
+		boxes.clear();
+		boxes.push_back(all);
+	}
+}
+
 void Widget::Update()
 {
 	Widget* w = Window();
 	if (w)
 	{
+		w->RepaintAll = true;
 		w->DispWindow->Update();
 	}
 }
 
+void Widget::Update(const Rect& box)
+{
+	Widget* w = Window();
+	Rect windowBox;
+	if (w && !w->RepaintAll && MapToWindowBox(box, windowBox))
+	{
+		AddRepaintBox(w->RepaintBoxes, windowBox);
+		w->DispWindow->Update();
+	}
+}
+
+void Widget::ScrollRect(const Rect& box, double dx, double dy)
+{
+	Widget* w = Window();
+	Rect windowBox;
+	if (!w || w->RepaintAll || (dx == 0.0 && dy == 0.0) || !MapToWindowBox(box, windowBox))
+		return;
+
+	if (std::abs(dx) >= windowBox.width || std::abs(dy) >= windowBox.height || IsCoveredInWindow(windowBox))
+	{
+		// Nothing shown in the box stays in view, or some of the pixels belong to a widget on top of it
+		AddRepaintBox(w->RepaintBoxes, windowBox);
+	}
+	else
+	{
+		// Areas waiting to be repainted move along with the pixels
+		std::vector<Rect> pending = w->RepaintBoxes;
+		for (const Rect& box : pending)
+			AddRepaintBox(w->RepaintBoxes, IntersectRect(Rect::xywh(box.x + dx, box.y + dy, box.width, box.height), windowBox));
+		w->RepaintScrolls.push_back({ windowBox, dx, dy });
+
+		if (dy > 0.0)
+			AddRepaintBox(w->RepaintBoxes, Rect::xywh(windowBox.x, windowBox.y, windowBox.width, dy));
+		else if (dy < 0.0)
+			AddRepaintBox(w->RepaintBoxes, Rect::xywh(windowBox.x, windowBox.bottom() + dy, windowBox.width, -dy));
+
+		if (dx > 0.0)
+			AddRepaintBox(w->RepaintBoxes, Rect::xywh(windowBox.x, windowBox.y, dx, windowBox.height));
+		else if (dx < 0.0)
+			AddRepaintBox(w->RepaintBoxes, Rect::xywh(windowBox.right() + dx, windowBox.y, -dx, windowBox.height));
+	}
+	w->DispWindow->Update();
+}
+
+bool Widget::IsCoveredInWindow(const Rect& windowBox) const
+{
+	// Later siblings of the widget and of its parents are painted on top of it, popups for example
+	for (const Widget* cur = this; cur != nullptr && !cur->DispWindow; cur = cur->Parent())
+	{
+		for (const Widget* sibling = cur->NextSibling(); sibling != nullptr; sibling = sibling->NextSibling())
+		{
+			if (sibling->Type != WidgetType::Child)
+				continue;
+
+			const Rect& frame = sibling->FrameGeometry;
+			const Rect& content = sibling->ContentGeometry;
+			Rect siblingBox;
+			if (sibling->MapToWindowBox(Rect::xywh(frame.x - content.x, frame.y - content.y, frame.width, frame.height), siblingBox) && !IsEmptyRect(IntersectRect(siblingBox, windowBox)))
+				return true;
+		}
+	}
+	return false;
+}
+
+bool Widget::MapToWindowBox(const Rect& box, Rect& result) const
+{
+	// Only the part of the box not clipped away by the widget and its parents can be on screen
+	Rect frame = Rect::xywh(FrameGeometry.x - ContentGeometry.x, FrameGeometry.y - ContentGeometry.y, FrameGeometry.width, FrameGeometry.height);
+	Rect clipped = IntersectRect(box, frame);
+	for (const Widget* cur = this; cur != nullptr; cur = cur->Parent())
+	{
+		if (cur->HiddenFlag)
+			return false;
+
+		clipped.x += cur->ContentGeometry.x;
+		clipped.y += cur->ContentGeometry.y;
+		if (cur->DispWindow)
+		{
+			result = clipped;
+			return !IsEmptyRect(result);
+		}
+
+		if (cur->Parent())
+		{
+			const Rect& content = cur->Parent()->ContentGeometry;
+			clipped = IntersectRect(clipped, Rect::xywh(0.0, 0.0, content.width, content.height));
+		}
+	}
+	return false;
+}
+
 void Widget::Repaint()
 {
 	Widget* w = Window();
 	if (!w || !w->DispCanvas)
 		return;
 
+	// Updates made while painting belong to the next frame. A paint with nothing waiting comes from the window
+	// system, which wants all of it.
+	bool repaintAll = w->RepaintAll || (w->RepaintScrolls.empty() && w->RepaintBoxes.empty());
+	std::vector<Rect> boxes;
+	std::vector<RepaintScroll> scrolls;
+	boxes.swap(w->RepaintBoxes);
+	scrolls.swap(w->RepaintScrolls);
+	w->RepaintAll = false;
+
+	Rect bounds;
+	for (const Rect& box : boxes)
+		bounds = UnionRect(bounds, box);
+
 	Canvas* canvas = w->DispCanvas.get();
-	canvas->begin(w->WindowBackground);
-	w->Paint(canvas);
+	if (!repaintAll && canvas->beginPartial(bounds))
+	{
+		for (const RepaintScroll& scroll : scrolls)
+		{
+			if (!canvas->scrollRect(scroll.box, scroll.dx, scroll.dy))
+			{
+				repaintAll = true;
+				break;
+			}
+		}
+	}
+	else
+	{
+		repaintAll = true;
+	}
+
+	if (repaintAll)
+	{
+		canvas->begin(w->WindowBackground);
+		w->Paint(canvas);
+	}
+	else
+	{
+		for (const Rect& box : boxes)
+		{
+			canvas->pushClip(box);
+			canvas->fillRect(box, w->WindowBackground);
+			w->Paint(canvas);
+			canvas->popClip();
+		}
+	}
 	canvas->end();
 }
 
@@ -456,9 +669,13 @@ void Widget::Paint(Canvas* canvas)
 	canvas->pushClip(ContentGeometry);
 	canvas->setOrigin(oldOrigin + ContentGeometry.topLeft());
 	OnPaint(canvas);
+	Rect clip = canvas->getClipBox();
 	for (Widget* w = FirstChild(); w != nullptr; w = w->NextSibling())
 	{
-		if (w->Type == WidgetType::Child && !w->HiddenFlag)
+		// Children scrolled outside the content box, or outside the area being repainted, would be clipped away entirely
+		const Rect& box = w->FrameGeometry;
+		bool inside = box.right() > clip.left() && box.bottom() > clip.top() && box.left() < clip.right() && box.top() < clip.bottom();
+		if (w->Type == WidgetType::Child && !w->HiddenFlag && inside)
 			w->Paint(canvas);
 	}
 	canvas->setOrigin(oldOrigin);
@@ -467,10 +684,10 @@ void Widget::Paint(Canvas* canvas)
 
 void Widget::OnPaintFrame(Canvas* canvas)
 {
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
 	if (style)
 	{
-		style->Paint(this, canvas, GetFrameGeometry().size());
+		style->Style->Paint(this, canvas, GetFrameGeometry().size());
 	}
 }
 
@@ -1075,6 +1292,7 @@ void Widget::SetStyleClass(const std::string& themeClass)
 	if (StyleClass != themeClass)
 	{
 		StyleClass = themeClass;
+		ResolvedStyleGeneration = 0;
 		Update();
 	}
 }
@@ -1084,96 +1302,193 @@ void Widget::SetStyleState(const std::string& state)
 	if (StyleState != state)
 	{
 		StyleState = state;
+		ResolvedStyleGeneration = 0;
 		Update();
 	}
 }
 
 void Widget::SetStyleBool(const std::string& propertyName, bool value)
 {
-	StyleProperties[propertyName] = value;
+	SetStyleBool(StyleProperty::Intern(propertyName), value);
 }
 
 void Widget::SetStyleInt(const std::string& propertyName, int value)
 {
-	StyleProperties[propertyName] = value;
+	SetStyleInt(StyleProperty::Intern(propertyName), value);
 }
 
 void Widget::SetStyleDouble(const std::string& propertyName, double value)
 {
-	StyleProperties[propertyName] = value;
+	SetStyleDouble(StyleProperty::Intern(propertyName), value);
 }
 
 void Widget::SetStyleString(const std::string& propertyName, const std::string& value)
 {
-	StyleProperties[propertyName] = value;
+	SetStyleString(StyleProperty::Intern(propertyName), value);
 }
 
 void Widget::SetStyleColor(const std::string& propertyName, const Colorf& value)
 {
-	StyleProperties[propertyName] = value;
+	SetStyleColor(StyleProperty::Intern(propertyName), value);
 }
 
 void Widget::SetStyleImage(const std::string& propertyName, const std::shared_ptr<Image>& value)
 {
-	StyleProperties[propertyName] = value;
+	SetStyleImage(StyleProperty::Intern(propertyName), value);
 }
 
 bool Widget::GetStyleBool(const std::string& propertyName) const
 {
-	auto it = StyleProperties.find(propertyName);
-	if (it != StyleProperties.end())
-		return std::get<bool>(it->second);
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetBool(StyleState, propertyName) : false;
+	return GetStyleBool(StyleProperty::Intern(propertyName));
 }
 
 int Widget::GetStyleInt(const std::string& propertyName) const
 {
-	auto it = StyleProperties.find(propertyName);
-	if (it != StyleProperties.end())
-		return std::get<int>(it->second);
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetInt(StyleState, propertyName) : 0;
+	return GetStyleInt(StyleProperty::Intern(propertyName));
 }
 
 double Widget::GetStyleDouble(const std::string& propertyName) const
 {
-	auto it = StyleProperties.find(propertyName);
-	if (it != StyleProperties.end())
-		return std::get<double>(it->second);
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetDouble(StyleState, propertyName) : 0.0;
+	return GetStyleDouble(StyleProperty::Intern(propertyName));
 }
 
 std::string Widget::GetStyleString(const std::string& propertyName) const
 {
-	auto it = StyleProperties.find(propertyName);
-	if (it != StyleProperties.end())
-		return std::get<std::string>(it->second);
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetString(StyleState, propertyName) : std::string();
+	return GetStyleString(StyleProperty::Intern(propertyName));
 }
 
 Colorf Widget::GetStyleColor(const std::string& propertyName) const
 {
-	auto it = StyleProperties.find(propertyName);
-	if (it != StyleProperties.end())
-		return std::get<Colorf>(it->second);
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetColor(StyleState, propertyName) : Colorf::transparent();
+	return GetStyleColor(StyleProperty::Intern(propertyName));
 }
 
 std::shared_ptr<Image> Widget::GetStyleImage(const std::string& propertyName) const
 {
-	auto it = StyleProperties.find(propertyName);
-	if (it != StyleProperties.end())
-		return std::get<std::shared_ptr<Image>>(it->second);
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetImage(StyleState, propertyName) : std::shared_ptr<Image>();
+	return GetStyleImage(StyleProperty::Intern(propertyName));
+}
+
+void Widget::SetStyleBool(StylePropertyID id, bool value)
+{
+	StyleProperties[id] = value;
+}
+
+void Widget::SetStyleInt(StylePropertyID id, int value)
+{
+	StyleProperties[id] = value;
+}
+
+void Widget::SetStyleDouble(StylePropertyID id, double value)
+{
+	StyleProperties[id] = value;
+}
+
+void Widget::SetStyleString(StylePropertyID id, const std::string& value)
+{
+	StyleProperties[id] = value;
+}
+
+void Widget::SetStyleColor(StylePropertyID id, const Colorf& value)
+{
+	StyleProperties[id] = value;
+}
+
+void Widget::SetStyleImage(StylePropertyID id, const std::shared_ptr<Image>& value)
+{
+	StyleProperties[id] = value;
+}
+
+bool Widget::GetStyleBool(StylePropertyID id) const
+{
+	if (!StyleProperties.empty())
+	{
+		auto it = StyleProperties.find(id);
+		if (it != StyleProperties.end())
+			return std::get<bool>(it->second);
+	}
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	const StylePropertyVariant* prop = style ? style->Find(id) : nullptr;
+	return prop ? std::get<bool>(*prop) : false;
+}
+
+int Widget::GetStyleInt(StylePropertyID id) const
+{
+	if (!StyleProperties.empty())
+	{
+		auto it = StyleProperties.find(id);
+		if (it != StyleProperties.end())
+			return std::get<int>(it->second);
+	}
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	const StylePropertyVariant* prop = style ? style->Find(id) : nullptr;
+	return prop ? std::get<int>(*prop) : 0;
+}
+
+double Widget::GetStyleDouble(StylePropertyID id) const
+{
+	if (!StyleProperties.empty())
+	{
+		auto it = StyleProperties.find(id);
+		if (it != StyleProperties.end())
+			return std::get<double>(it->second);
+	}
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	const StylePropertyVariant* prop = style ? style->Find(id) : nullptr;
+	return prop ? std::get<double>(*prop) : 0.0;
+}
+
+std::string Widget::GetStyleString(StylePropertyID id) const
+{
+	if (!StyleProperties.empty())
+	{
+		auto it = StyleProperties.find(id);
+		if (it != StyleProperties.end())
+			return std::get<std::string>(it->second);
+	}
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	const StylePropertyVariant* prop = style ? style->Find(id) : nullptr;
+	return prop ? std::get<std::string>(*prop) : std::string();
+}
+
+Colorf Widget::GetStyleColor(StylePropertyID id) const
+{
+	if (!StyleProperties.empty())
+	{
+		auto it = StyleProperties.find(id);
+		if (it != StyleProperties.end())
+			return std::get<Colorf>(it->second);
+	}
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	const StylePropertyVariant* prop = style ? style->Find(id) : nullptr;
+	return prop ? std::get<Colorf>(*prop) : Colorf::transparent();
+}
+
+std::shared_ptr<Image> Widget::GetStyleImage(StylePropertyID id) const
+{
+	if (!StyleProperties.empty())
+	{
+		auto it = StyleProperties.find(id);
+		if (it != StyleProperties.end())
+			return std::get<std::shared_ptr<Image>>(it->second);
+	}
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	const StylePropertyVariant* prop = style ? style->Find(id) : nullptr;
+	return prop ? std::get<std::shared_ptr<Image>>(*prop) : std::shared_ptr<Image>();
+}
+
+const ResolvedWidgetStyle* Widget::GetResolvedStyle() const
+{
+	if (ResolvedStyleGeneration != WidgetTheme::GetGeneration())
+	{
+		WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
+		ResolvedStyle = style ? style->GetResolvedStyle(StyleState) : nullptr;
+		ResolvedStyleGeneration = WidgetTheme::GetGeneration();
+	}
+	return ResolvedStyle;
 }
 
-std::shared_ptr<Font> Widget::GetFont() const
+const std::shared_ptr<Font>& Widget::GetFont() const
 {
-	WidgetStyle* style = WidgetTheme::GetTheme()->GetStyle(StyleClass);
-	return style ? style->GetFont(StyleState) : std::shared_ptr<Font>();
+	static const std::shared_ptr<Font> noFont;
+	const ResolvedWidgetStyle* style = GetResolvedStyle();
+	return style ? style->StyleFont : noFont;
 }
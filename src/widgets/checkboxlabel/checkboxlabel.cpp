@@ -31,7 +31,7 @@ void CheckboxLabel::SetChecked(bool value)
 
 Size CheckboxLabel::GetCheckboxSize()
 {
-	if (auto image = GetStyleImage("checked-image"))
+	if (auto image = GetStyleImage(StyleProperty::CheckedImage))
 	{
 		return { (double)image->GetWidth(), std::max((double)image->GetHeight(), GetCanvas()->getFontMetrics(GetFont()).height) };
 	}
@@ -72,31 +72,31 @@ void CheckboxLabel::OnPaint(Canvas* canvas)
 
 	if (checked)
 	{
-		if (auto image = GetStyleImage("checked-image"))
+		if (auto image = GetStyleImage(StyleProperty::CheckedImage))
 		{
-			canvas->drawImage(image, Point(0.0, center - s.height * 0.5 - GetStyleDouble("checked-align")));
+			canvas->drawImage(image, Point(0.0, center - s.height * 0.5 - GetStyleDouble(StyleProperty::CheckedAlign)));
 		}
 		else
 		{
-			canvas->fillRect(Rect::xywh(0.0, center - 6.0 * borderwidth, outerboxsize, outerboxsize), GetStyleColor("checked-outer-border-color"));
-			canvas->fillRect(Rect::xywh(1.0 * borderwidth, center - 5.0 * borderwidth, innerboxsize, innerboxsize), GetStyleColor("checked-inner-border-color"));
-			canvas->fillRect(Rect::xywh(2.0 * borderwidth, center - 4.0 * borderwidth, checkedsize, checkedsize), GetStyleColor("checked-color"));
+			canvas->fillRect(Rect::xywh(0.0, center - 6.0 * borderwidth, outerboxsize, outerboxsize), GetStyleColor(StyleProperty::CheckedOuterBorderColor));
+			canvas->fillRect(Rect::xywh(1.0 * borderwidth, center - 5.0 * borderwidth, innerboxsize, innerboxsize), GetStyleColor(StyleProperty::CheckedInnerBorderColor));
+			canvas->fillRect(Rect::xywh(2.0 * borderwidth, center - 4.0 * borderwidth, checkedsize, checkedsize), GetStyleColor(StyleProperty::CheckedColor));
 		}
 	}
 	else
 	{
-		if (auto image = GetStyleImage("unchecked-image"))
+		if (auto image = GetStyleImage(StyleProperty::UncheckedImage))
 		{
-			canvas->drawImage(image, Point(0.0, center - s.height * 0.5 - GetStyleDouble("unchecked-align")));
+			canvas->drawImage(image, Point(0.0, center - s.height * 0.5 - GetStyleDouble(StyleProperty::UncheckedAlign)));
 		}
 		else
 		{
-			canvas->fillRect(Rect::xywh(0.0, center - 6.0 * borderwidth, outerboxsize, outerboxsize), GetStyleColor("unchecked-outer-border-color"));
-			canvas->fillRect(Rect::xywh(1.0 * borderwidth, center - 5.0 * borderwidth, innerboxsize, innerboxsize), GetStyleColor("unchecked-inner-border-color"));
+			canvas->fillRect(Rect::xywh(0.0, center - 6.0 * borderwidth, outerboxsize, outerboxsize), GetStyleColor(StyleProperty::UncheckedOuterBorderColor));
+			canvas->fillRect(Rect::xywh(1.0 * borderwidth, center - 5.0 * borderwidth, innerboxsize, innerboxsize), GetStyleColor(StyleProperty::UncheckedInnerBorderColor));
 		}
 	}
 
-	canvas->drawText(GetFont(), Point(s.width + 2.0, baseline), text, GetStyleColor("color"));
+	canvas->drawText(GetFont(), Point(s.width + 2.0, baseline), text, GetStyleColor(StyleProperty::Color));
 }
 
 bool CheckboxLabel::OnMouseDown(const Point& pos, InputKey key)
@@ -0,0 +1,516 @@
+
+#include "widgets/datagrid/datagrid.h"
+#include "widgets/scrollbar/scrollbar.h"
+#include <algorithm>
+#include <cmath>
+
+DataGrid::DataGrid(Widget* parent) : Widget(parent)
+{
+	SetStretching(true);
+	SetStyleClass("datagrid");
+
+	vertScrollbar = new Scrollbar(this);
+	vertScrollbar->SetVertical();
+	vertScrollbar->FuncScroll = [this]() { OnScrollbarScroll(); };
+
+	horzScrollbar = new Scrollbar(this);
+	horzScrollbar->SetHorizontal();
+	horzScrollbar->FuncScroll = [this]() { OnScrollbarScroll(); };
+}
+
+DataGrid::~DataGrid()
+{
+	if (model)
+	{
+		auto& views = model->views;
+		views.erase(std::remove(views.begin(), views.end(), this), views.end());
+	}
+}
+
+void DataGrid::SetModel(std::shared_ptr<DataGridModel> newModel)
+{
+	if (newModel == model)
+		return;
+
+	if (model)
+	{
+		auto& views = model->views;
+		views.erase(std::remove(views.begin(), views.end(), this), views.end());
+	}
+	model = std::move(newModel);
+	if (model)
+		model->views.push_back(this);
+
+	vertScrollbar->SetPosition(0.0);
+	horzScrollbar->SetPosition(0.0);
+	OnModelReset();
+}
+
+void DataGrid::ShowHeader(bool value)
+{
+	headerVisible = value;
+	UpdateScrollRanges();
+	Update();
+}
+
+void DataGrid::SetFrozenRows(int count)
+{
+	frozenRows = std::max(count, 0);
+	UpdateScrollRanges();
+	Update();
+}
+
+void DataGrid::SetFrozenColumns(int count)
+{
+	frozenColumns = std::max(count, 0);
+	UpdateScrollRanges();
+	Update();
+}
+
+void DataGrid::SetDefaultColumnWidth(double width)
+{
+	defaultColumnWidth = width;
+	for (size_t column = 0; column < columnWidthSet.size(); column++)
+	{
+		if (!columnWidthSet[column])
+			columnWidths.SetHeight(column, defaultColumnWidth);
+	}
+	UpdateScrollRanges();
+	Update();
+}
+
+void DataGrid::SetColumnWidth(int column, double width)
+{
+	if (column >= 0 && column < GetColumnCount())
+	{
+		columnWidths.SetHeight(column, std::max(width, 0.0));
+		columnWidthSet[column] = true;
+		UpdateScrollRanges();
+		Update();
+	}
+}
+
+void DataGrid::SetSelectedCell(int row, int column, bool notify)
+{
+	if (row < 0 || row >= rowCount || column < 0 || column >= GetColumnCount())
+		return;
+
+	if (selectedRow != row || selectedColumn != column)
+	{
+		selectedRow = row;
+		selectedColumn = column;
+		Update();
+		if (notify && OnChanged)
+			OnChanged(selectedRow, selectedColumn);
+	}
+}
+
+void DataGrid::ScrollToCell(int row, int column)
+{
+	// Frozen rows and columns are always in view
+	if (row >= frozenRows && row < rowCount)
+	{
+		double viewHeight = GetViewHeight() - GetFrozenHeight();
+		double top = (row - frozenRows) * GetRowHeight();
+		if (top < vertScrollbar->GetPosition())
+			vertScrollbar->SetPosition(top);
+		else if (top + GetRowHeight() > vertScrollbar->GetPosition() + viewHeight)
+			vertScrollbar->SetPosition(std::max(top + GetRowHeight() - viewHeight, 0.0));
+	}
+
+	if (column >= frozenColumns && column < GetColumnCount())
+	{
+		double viewWidth = GetViewWidth() - GetFrozenWidth();
+		double left = columnWidths.GetTop(column) - GetFrozenWidth();
+		double width = columnWidths.GetHeight(column);
+		if (left < horzScrollbar->GetPosition() || width > viewWidth)
+			horzScrollbar->SetPosition(left);
+		else if (left + width > horzScrollbar->GetPosition() + viewWidth)
+			horzScrollbar->SetPosition(std::max(left + width - viewWidth, 0.0));
+	}
+	ScrollPaintedCells();
+}
+
+bool DataGrid::GetCellAt(const Point& pos, int& row, int& column)
+{
+	row = -1;
+	column = -1;
+	if (pos.x < 0.0 || pos.y < GetHeaderHeight() || pos.x >= GetViewWidth() || pos.y >= GetViewHeight())
+		return false;
+
+	double x = pos.x < GetFrozenWidth() ? pos.x : pos.x + horzScrollbar->GetPosition();
+	double y = pos.y < GetFrozenHeight() ? pos.y : pos.y + vertScrollbar->GetPosition();
+	row = (int)std::floor((y - GetHeaderHeight()) / GetRowHeight());
+	column = (int)columnWidths.FindRow(x);
+	if (row >= rowCount || column >= GetColumnCount())
+	{
+		row = -1;
+		column = -1;
+		return false;
+	}
+	return true;
+}
+
+double DataGrid::GetViewWidth() const
+{
+	return std::max(GetWidth() - vertScrollbar->GetPreferredWidth(), 0.0);
+}
+
+double DataGrid::GetViewHeight() const
+{
+	return std::max(GetHeight() - horzScrollbar->GetPreferredHeight(), 0.0);
+}
+
+double DataGrid::GetFrozenWidth() const
+{
+	return columnWidths.GetTop(std::min((size_t)frozenColumns, columnWidths.GetCount()));
+}
+
+double DataGrid::GetFrozenHeight() const
+{
+	return GetHeaderHeight() + std::min(frozenRows, rowCount) * GetRowHeight();
+}
+
+void DataGrid::OnPaint(Canvas* canvas)
+{
+	if (!model)
+		return;
+
+	// The frozen rows and columns are drawn as separate regions that only scroll along one axis
+	double scrollX = horzScrollbar->GetPosition();
+	double scrollY = vertScrollbar->GetPosition();
+	double viewWidth = GetViewWidth();
+	double viewHeight = GetViewHeight();
+	double headerHeight = GetHeaderHeight();
+	double frozenWidth = std::min(GetFrozenWidth(), viewWidth);
+	double frozenHeight = std::min(GetFrozenHeight(), viewHeight);
+	int columnCount = GetColumnCount();
+	int rows = std::min(frozenRows, rowCount);
+	int columns = std::min(frozenColumns, columnCount);
+	paintedScrollX = scrollX;
+	paintedScrollY = scrollY;
+
+	PaintCells(canvas, Rect::xywh(frozenWidth, frozenHeight, viewWidth - frozenWidth, viewHeight - frozenHeight), rows, rowCount, columns, columnCount, scrollX, scrollY);
+	PaintCells(canvas, Rect::xywh(frozenWidth, headerHeight, viewWidth - frozenWidth, frozenHeight - headerHeight), 0, rows, columns, columnCount, scrollX, 0.0);
+	PaintCells(canvas, Rect::xywh(0.0, frozenHeight, frozenWidth, viewHeight - frozenHeight), rows, rowCount, 0, columns, 0.0, scrollY);
+	PaintCells(canvas, Rect::xywh(0.0, headerHeight, frozenWidth, frozenHeight - headerHeight), 0, rows, 0, columns, 0.0, 0.0);
+
+	if (headerVisible)
+	{
+		PaintHeader(canvas, Rect::xywh(frozenWidth, 0.0, viewWidth - frozenWidth, headerHeight), columns, columnCount, scrollX);
+		PaintHeader(canvas, Rect::xywh(0.0, 0.0, frozenWidth, headerHeight), 0, columns, 0.0);
+	}
+}
+
+void DataGrid::PaintCells(Canvas* canvas, const Rect& region, int firstRow, int endRow, int firstColumn, int endColumn, double scrollX, double scrollY)
+{
+	// Only the part of the region inside the area being painted is visited
+	Rect paintBox = canvas->getClipBox();
+	double clipLeft = std::max(region.left(), paintBox.left());
+	double clipTop = std::max(region.top(), paintBox.top());
+	double clipRight = std::min(region.right(), paintBox.right());
+	double clipBottom = std::min(region.bottom(), paintBox.bottom());
+	if (clipLeft >= clipRight || clipTop >= clipBottom || firstRow >= endRow || firstColumn >= endColumn)
+		return;
+	Rect clip = Rect::ltrb(clipLeft, clipTop, clipRight, clipBottom);
+
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
+	Colorf selectionColor = GetStyleColor(StyleProperty::SelectionColor);
+	Colorf gridColor = GetStyleColor(StyleProperty::GridColor);
+	auto font = GetFont();
+	double rowHeight = GetRowHeight();
+	double headerHeight = GetHeaderHeight();
+
+	// A cell is drawn at (column left - scrollX, header height + row top - scrollY). Only the cells inside the clip box are visited,
+	// starting one row and column early as their grid lines can round into the next device pixel.
+	int row = std::max(firstRow, (int)std::floor((clip.y - headerHeight + scrollY) / rowHeight) - 1);
+	int column = std::max(firstColumn, (int)columnWidths.FindRow(clip.x + scrollX) - 1);
+	double left = columnWidths.GetTop(column) - scrollX;
+
+	canvas->pushClip(clip);
+	for (double y = headerHeight + row * rowHeight - scrollY; row < endRow && y < clip.y + clip.height; row++, y += rowHeight)
+	{
+		double x = left;
+		for (int c = column; c < endColumn && x < clip.x + clip.width; c++)
+		{
+			double width = columnWidths.GetHeight(c);
+			Rect box = Rect::xywh(x, y, width, rowHeight);
+			if (row == selectedRow && c == selectedColumn)
+			{
+				canvas->fillRect(box, selectionColor);
+			}
+			canvas->pushClip(Rect::xywh(x, y, std::max(width - 5.0, 0.0), rowHeight));
+			if (!model->PaintCell(canvas, row, c, box))
+				canvas->drawText(font, Point(x + 4.0, y + 15.0), model->GetCellText(row, c), textColor);
+			canvas->popClip();
+			canvas->fillRect(Rect::xywh(x + width - 1.0, y, 1.0, rowHeight), gridColor);
+			canvas->fillRect(Rect::xywh(x, y + rowHeight - 1.0, width, 1.0), gridColor);
+			x += width;
+		}
+	}
+	canvas->popClip();
+}
+
+void DataGrid::PaintHeader(Canvas* canvas, const Rect& clip, int firstColumn, int endColumn, double scrollX)
+{
+	if (clip.width <= 0.0 || clip.height <= 0.0 || firstColumn >= endColumn)
+		return;
+
+	Colorf textColor = GetStyleColor(StyleProperty::HeaderColor);
+	Colorf gridColor = GetStyleColor(StyleProperty::GridColor);
+	auto font = GetFont();
+	double height = GetHeaderHeight();
+
+	int column = std::max(firstColumn, (int)columnWidths.FindRow(clip.x + scrollX));
+	double x = columnWidths.GetTop(column) - scrollX;
+
+	canvas->pushClip(clip);
+	canvas->fillRect(clip, GetStyleColor(StyleProperty::HeaderBackgroundColor));
+	for (; column < endColumn && x < clip.x + clip.width; column++)
+	{
+		double width = columnWidths.GetHeight(column);
+		canvas->pushClip(Rect::xywh(x, 0.0, std::max(width - 5.0, 0.0), height));
+		canvas->drawText(font, Point(x + 4.0, 15.0), model->GetColumnTitle(column), textColor);
+		canvas->popClip();
+		canvas->fillRect(Rect::xywh(x + width - 1.0, 0.0, 1.0, height), gridColor);
+		x += width;
+	}
+	canvas->popClip();
+}
+
+int DataGrid::GetColumnResizeHandle(const Point& pos)
+{
+	if (!headerVisible || pos.y < 0.0 || pos.y >= GetHeaderHeight() || pos.x < 0.0 || pos.x >= GetViewWidth())
+		return -1;
+
+	// The handle is the right edge of the column under the pointer, or the right edge of the column before it in the same region
+	bool frozen = pos.x < GetFrozenWidth();
+	double scrollX = frozen ? 0.0 : horzScrollbar->GetPosition();
+	int column = (int)columnWidths.FindRow(pos.x + scrollX);
+	if (column >= GetColumnCount())
+		return -1;
+
+	double left = columnWidths.GetTop(column) - scrollX;
+	double right = left + columnWidths.GetHeight(column);
+	if (right - pos.x <= 4.0)
+		return column;
+	else if (pos.x - left <= 4.0 && column > 0 && (column - 1 < frozenColumns) == frozen)
+		return column - 1;
+	return -1;
+}
+
+bool DataGrid::OnMouseDown(const Point& pos, InputKey key)
+{
+	SetFocus();
+
+	if (key == InputKey::LeftMouse)
+	{
+		int column = GetColumnResizeHandle(pos);
+		if (column >= 0)
+		{
+			resizeColumn = column;
+			resizeStartX = pos.x;
+			resizeStartWidth = columnWidths.GetHeight(column);
+			SetPointerCapture();
+			return true;
+		}
+
+		int row;
+		if (GetCellAt(pos, row, column))
+		{
+			ScrollToCell(row, column);
+			SetSelectedCell(row, column);
+		}
+	}
+	return true;
+}
+
+bool DataGrid::OnMouseDoubleclick(const Point& pos, InputKey key)
+{
+	int row, column;
+	if (key == InputKey::LeftMouse && GetCellAt(pos, row, column) && row == selectedRow && column == selectedColumn && OnActivated)
+		OnActivated(row, column);
+	return true;
+}
+
+bool DataGrid::OnMouseUp(const Point& pos, InputKey key)
+{
+	if (key == InputKey::LeftMouse && resizeColumn >= 0)
+	{
+		resizeColumn = -1;
+		ReleasePointerCapture();
+	}
+	return true;
+}
+
+void DataGrid::OnMouseMove(const Point& pos)
+{
+	if (resizeColumn >= 0)
+	{
+		SetColumnWidth(resizeColumn, std::max(resizeStartWidth + pos.x - resizeStartX, 8.0));
+	}
+	else
+	{
+		SetCursor(GetColumnResizeHandle(pos) >= 0 ? StandardCursor::size_we : StandardCursor::arrow);
+	}
+}
+
+bool DataGrid::OnMouseWheel(const Point& pos, InputKey key)
+{
+	// Scrolls sideways while shift is held
+	Scrollbar* scrollbar = GetKeyState(InputKey::Shift) ? horzScrollbar : vertScrollbar;
+	double step = scrollbar == horzScrollbar ? defaultColumnWidth * 0.5 : GetRowHeight();
+	if (key == InputKey::MouseWheelUp)
+	{
+		scrollbar->SetPosition(std::max(scrollbar->GetPosition() - step, 0.0));
+	}
+	else if (key == InputKey::MouseWheelDown)
+	{
+		scrollbar->SetPosition(std::min(scrollbar->GetPosition() + step, scrollbar->GetMax()));
+	}
+	ScrollPaintedCells();
+	return true;
+}
+
+void DataGrid::OnKeyDown(InputKey key)
+{
+	int columnCount = GetColumnCount();
+	if (rowCount == 0 || columnCount == 0)
+		return;
+
+	int row = std::max(selectedRow, 0);
+	int column = std::max(selectedColumn, 0);
+	int pageSize = std::max((int)((GetViewHeight() - GetFrozenHeight()) / GetRowHeight()) - 1, 1);
+	bool ctrl = GetKeyState(InputKey::Ctrl);
+	if (key == InputKey::Up)
+		row = std::max(row - 1, 0);
+	else if (key == InputKey::Down)
+		row = std::min(row + 1, rowCount - 1);
+	else if (key == InputKey::Left)
+		column = std::max(column - 1, 0);
+	else if (key == InputKey::Right)
+		column = std::min(column + 1, columnCount - 1);
+	else if (key == InputKey::PageUp)
+		row = std::max(row - pageSize, 0);
+	else if (key == InputKey::PageDown)
+		row = std::min(row + pageSize, rowCount - 1);
+	else if (key == InputKey::Home)
+	{
+		column = 0;
+		if (ctrl)
+			row = 0;
+	}
+	else if (key == InputKey::End)
+	{
+		column = columnCount - 1;
+		if (ctrl)
+			row = rowCount - 1;
+	}
+	else if (key == InputKey::Enter)
+	{
+		if (selectedRow >= 0 && OnActivated)
+			OnActivated(selectedRow, selectedColumn);
+		return;
+	}
+	else
+	{
+		return;
+	}
+
+	SetSelectedCell(row, column);
+	ScrollToCell(row, column);
+}
+
+void DataGrid::OnGeometryChanged()
+{
+	double sw = vertScrollbar->GetPreferredWidth();
+	double sh = horzScrollbar->GetPreferredHeight();
+	vertScrollbar->SetFrameGeometry(Rect::xywh(GetWidth() - sw, 0.0, sw, std::max(GetHeight() - sh, 0.0)));
+	horzScrollbar->SetFrameGeometry(Rect::xywh(0.0, GetHeight() - sh, std::max(GetWidth() - sw, 0.0), sh));
+	UpdateScrollRanges();
+	Update();
+}
+
+void DataGrid::UpdateColumnCount()
+{
+	size_t count = model ? (size_t)std::max(model->GetColumnCount(), 0) : 0;
+	if (count < columnWidths.GetCount())
+	{
+		columnWidths.Remove(count, columnWidths.GetCount() - count);
+	}
+	while (columnWidths.GetCount() < count)
+	{
+		columnWidths.Append(defaultColumnWidth);
+	}
+	columnWidthSet.resize(count, false);
+}
+
+void DataGrid::UpdateScrollRanges()
+{
+	double scrollWidth = columnWidths.GetTotalHeight() - GetFrozenWidth();
+	double scrollHeight = (rowCount - std::min(frozenRows, rowCount)) * GetRowHeight();
+	horzScrollbar->SetRanges(GetViewWidth() - GetFrozenWidth(), scrollWidth);
+	vertScrollbar->SetRanges(GetViewHeight() - GetFrozenHeight(), scrollHeight);
+}
+
+void DataGrid::ScrollPaintedCells()
+{
+	double scrollX = horzScrollbar->GetPosition();
+	double scrollY = vertScrollbar->GetPosition();
+	double dx = paintedScrollX - scrollX;
+	double dy = paintedScrollY - scrollY;
+	if (dx == 0.0 && dy == 0.0)
+		return;
+
+	double viewWidth = GetViewWidth();
+	double viewHeight = GetViewHeight();
+	double frozenWidth = std::min(GetFrozenWidth(), viewWidth);
+	double frozenHeight = std::min(GetFrozenHeight(), viewHeight);
+
+	// The header and the frozen rows only scroll sideways, and the frozen columns only scroll up and down
+	ScrollRect(Rect::xywh(frozenWidth, frozenHeight, viewWidth - frozenWidth, viewHeight - frozenHeight), dx, dy);
+	if (dx != 0.0)
+		ScrollRect(Rect::xywh(frozenWidth, 0.0, viewWidth - frozenWidth, frozenHeight), dx, 0.0);
+	if (dy != 0.0)
+		ScrollRect(Rect::xywh(0.0, frozenHeight, frozenWidth, viewHeight - frozenHeight), 0.0, dy);
+
+	paintedScrollX = scrollX;
+	paintedScrollY = scrollY;
+}
+
+void DataGrid::OnScrollbarScroll()
+{
+	ScrollPaintedCells();
+}
+
+void DataGrid::OnCellsChanged()
+{
+	Update();
+}
+
+void DataGrid::OnModelReset()
+{
+	rowCount = model ? std::max(model->GetRowCount(), 0) : 0;
+	UpdateColumnCount();
+	if (selectedRow >= rowCount || selectedColumn >= GetColumnCount())
+	{
+		selectedRow = -1;
+		selectedColumn = -1;
+	}
+	UpdateScrollRanges();
+	Update();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+void DataGridModel::CellsChanged()
+{
+	for (DataGrid* view : views)
+		view->OnCellsChanged();
+}
+
+void DataGridModel::ModelReset()
+{
+	for (DataGrid* view : views)
+		view->OnModelReset();
+}
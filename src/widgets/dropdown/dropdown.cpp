@@ -8,11 +8,30 @@ Dropdown::Dropdown(Widget* parent) : Widget(parent)
 	SetStyleClass("dropdown");
 	SetFocus();
 
+	itemModel = std::make_shared<DropdownItemModel>(items);
+
 	// Subscribe to all parent widgets to receive notifications.
 	for (Widget* p = Parent(); p; p = p->Parent())
 		p->Subscribe(this);
 }
 
+Dropdown::~Dropdown()
+{
+	delete dropdown;
+}
+
+DropdownPopup::DropdownPopup(Widget* parent, Dropdown* owner) : Widget(parent), owner(owner)
+{
+}
+
+DropdownPopup::~DropdownPopup()
+{
+	// The window may delete the popup before the dropdown
+	owner->dropdown = nullptr;
+	owner->listView = nullptr;
+	owner->dropdownOpen = false;
+}
+
 DropdownList::DropdownList(Widget* parent, Dropdown* owner) : ListView(parent), owner(owner)
 {
 }
@@ -22,6 +41,11 @@ void DropdownList::OnKeyDown(InputKey key)
 	owner->OnKeyDown(key);
 }
 
+void DropdownList::OnKeyChar(std::string chars)
+{
+	owner->OnKeyChar(chars);
+}
+
 void Dropdown::Notify(Widget* source, const WidgetEvent type)
 {
 	if (type != WidgetEvent::VisibilityChange) return;
@@ -39,6 +63,7 @@ void Dropdown::Notify(Widget* source, const WidgetEvent type)
 
 void Dropdown::ItemsChanged()
 {
+	typeAheadIndexChanged = true;
 	if (!CloseDropdown())
 	{
 		Update();
@@ -47,14 +72,12 @@ void Dropdown::ItemsChanged()
 
 void Dropdown::AddItem(const std::string& text, int index)
 {
-	if (index < 0)
-	{
-		items.push_back(text);
-	}
-	else
-	{
-		items.insert(items.begin() + index, text);
-	}
+	if (index < 0 || index > (int)items.size())
+		index = (int)items.size();
+
+	itemModel->RowsAboutToChange();
+	items.insert(items.begin() + index, text);
+	itemModel->RowsInserted(index, 1);
 
 	if (selectedItem == -1 && !items.empty())
 		SetSelectedItem(0);
@@ -70,7 +93,9 @@ bool Dropdown::UpdateItem(const std::string& text, int index)
 	if (index < 0)
 		index = static_cast<int>(items.size()) - 1;
 
+	itemModel->RowsAboutToChange();
 	items[index] = text;
+	itemModel->RowsChanged(index, 1);
 
 	if (selectedItem == index)
 	{
@@ -95,7 +120,9 @@ bool Dropdown::RemoveItem(int index)
 	if (index < 0)
 		index = static_cast<int>(items.size()) - 1;
 
+	itemModel->RowsAboutToChange();
 	items.erase(items.begin() + index);
+	itemModel->RowsRemoved(index, 1);
 
 	if ((int)items.size() == 0)
 	{
@@ -117,7 +144,9 @@ bool Dropdown::RemoveItem(int index)
 
 void Dropdown::ClearItems()
 {
+	itemModel->RowsAboutToChange();
 	items.clear();
+	itemModel->ModelReset();
 	SetSelectedItem(-1);
 	ItemsChanged();
 }
@@ -167,8 +196,8 @@ double Dropdown::GetPreferredWidth()
 
 void Dropdown::OnPaint(Canvas* canvas)
 {
-	Colorf textColor = GetStyleColor("color");
-	Colorf arrowColor = GetStyleColor("arrow-color");
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
+	Colorf arrowColor = GetStyleColor(StyleProperty::ArrowColor);
 
 	double w = GetWidth();
 	double h = GetHeight();
@@ -214,8 +243,11 @@ void Dropdown::OnKeyDown(InputKey key)
 {
 	switch (key)
 	{
-	case InputKey::Enter:
 	case InputKey::Space:
+		if (!typeAheadText.empty())
+			break;
+		[[fallthrough]];
+	case InputKey::Enter:
 		if (dropdownOpen)
 			CloseDropdown();
 		else
@@ -223,27 +255,37 @@ void Dropdown::OnKeyDown(InputKey key)
 		break;
 
 	case InputKey::Up:
-		SetSelectedItem(selectedItem - 1);
+		MoveSelection(-1);
 		break;
 
 	case InputKey::Down:
-		SetSelectedItem(selectedItem + 1);
+		MoveSelection(1);
 		break;
 
 	case InputKey::Home:
-		SetSelectedItem(0);
+		MoveSelection(-(int)items.size());
 		break;
 
 	case InputKey::End:
-		SetSelectedItem((int)items.size());
+		MoveSelection((int)items.size());
 		break;
 
 	case InputKey::PageUp:
-		SetSelectedItem(selectedItem - (maxDisplayItems? maxDisplayItems: (int)items.size()));
+		MoveSelection(-(maxDisplayItems? maxDisplayItems: (int)items.size()));
 		break;
 
 	case InputKey::PageDown:
-		SetSelectedItem(selectedItem + (maxDisplayItems? maxDisplayItems: (int)items.size()));
+		MoveSelection(maxDisplayItems? maxDisplayItems: (int)items.size());
+		break;
+
+	case InputKey::Backspace:
+		if (!typeAheadText.empty())
+		{
+			size_t length = typeAheadText.size() - 1;
+			while (length > 0 && (typeAheadText[length] & 0xc0) == 0x80)
+				length--;
+			SetTypeAheadText(typeAheadText.substr(0, length));
+		}
 		break;
 
 	default:
@@ -251,6 +293,85 @@ void Dropdown::OnKeyDown(InputKey key)
 	}
 }
 
+void Dropdown::OnKeyChar(std::string chars)
+{
+	if (typeAheadMode == ListViewTypeAhead::None || chars.empty() || (uint8_t)chars[0] < 32 || chars[0] == 127)
+		return;
+
+	if (typeAheadMode == ListViewTypeAhead::Select && std::chrono::steady_clock::now() - typeAheadTime > std::chrono::seconds(1))
+		typeAheadText.clear();
+
+	// Space opens the list unless it is part of the typed text
+	if (typeAheadText.empty() && chars == " ")
+		return;
+
+	SetTypeAheadText(typeAheadText + chars);
+}
+
+void Dropdown::SetTypeAhead(ListViewTypeAhead mode, bool matchSubstring)
+{
+	CloseDropdown();
+	typeAheadMode = mode;
+	typeAheadText.clear();
+	typeAheadIndex.SetMatchSubstring(matchSubstring);
+	typeAheadIndexChanged = true;
+}
+
+void Dropdown::SetTypeAheadText(const std::string& text)
+{
+	typeAheadText = text;
+	typeAheadTime = std::chrono::steady_clock::now();
+
+	if (typeAheadMode == ListViewTypeAhead::Select && !typeAheadText.empty())
+	{
+		int index = FindTypeAheadMatch();
+		if (index >= 0)
+			SetSelectedItem(index);
+	}
+	else if (typeAheadMode == ListViewTypeAhead::Filter)
+	{
+		if (!dropdownOpen && !typeAheadText.empty())
+			OpenDropdown();
+
+		if (dropdownOpen)
+		{
+			listView->SetTypeAheadText(typeAheadText);
+
+			// Keep the selection on an item that is still shown
+			if (listView->GetShownPosition(selectedItem) < 0 && listView->GetShownItemCount() > 0)
+				SetSelectedItem(listView->GetShownItem(0));
+		}
+	}
+}
+
+int Dropdown::FindTypeAheadMatch()
+{
+	if (typeAheadIndexChanged)
+	{
+		typeAheadIndexChanged = false;
+		typeAheadIndex.Build((int)items.size(), [this](int row) { return items[row]; });
+	}
+
+	return typeAheadIndex.FindNext(typeAheadText, selectedItem);
+}
+
+void Dropdown::MoveSelection(int delta)
+{
+	// Move through the items shown by a filtered list
+	if (dropdownOpen && listView->GetShownItemCount() != items.size())
+	{
+		int count = (int)listView->GetShownItemCount();
+		if (count == 0)
+			return;
+		int position = std::max(listView->GetShownPosition(selectedItem), 0);
+		SetSelectedItem(listView->GetShownItem(std::clamp(position + delta, 0, count - 1)));
+	}
+	else
+	{
+		SetSelectedItem(selectedItem + delta);
+	}
+}
+
 void Dropdown::SetMaxDisplayItems(int items)
 {
 	maxDisplayItems = std::max<int>(0, items);
@@ -305,19 +426,27 @@ bool Dropdown::OpenDropdown()
 {
 	if (dropdownOpen || items.empty()) return false;
 
-	dropdownOpen = true;
+	if (dropdown && dropdown->Parent() != Window())
+		delete dropdown;
 
-	dropdown = new Widget(Window());
-	listView = new DropdownList(dropdown, this);
-	for (const auto& item : items)
+	// The popup is created once and reused. Its list shows the items directly.
+	if (!dropdown)
 	{
-		listView->AddItem(item);
+		dropdown = new DropdownPopup(Window(), this);
+		listView = new DropdownList(dropdown, this);
+		listView->SetModel(itemModel);
+		listView->OnActivated = [this]() { OnDropdownActivated(); };
+		listView->OnChanged = [this](int index) { OnDropdownActivated(); };
+	}
+	else
+	{
+		dropdown->MoveBefore(nullptr);
 	}
 
-	listView->SetSelectedItem(selectedItem);
+	dropdownOpen = true;
 
-	listView->OnActivated = [this]() { OnDropdownActivated(); };
-	listView->OnChanged = [this](int index) { OnDropdownActivated(); };
+	listView->SetSelectedItem(selectedItem, false);
+	listView->SetTypeAhead(typeAheadMode == ListViewTypeAhead::Filter ? ListViewTypeAhead::Filter : ListViewTypeAhead::None, typeAheadIndex.IsMatchSubstring());
 
 	listView->SetFrameGeometry(
 		0,
@@ -338,10 +467,9 @@ bool Dropdown::CloseDropdown()
 {
 	if (!dropdownOpen || !dropdown) return false;
 
-	dropdown->Close();
-	dropdown = nullptr;
-	listView = nullptr;
+	dropdown->Hide();
 	dropdownOpen = false;
+	typeAheadText.clear();
 
 	Update();
 
@@ -148,7 +148,10 @@ void LineEdit::SetLowercase(bool enable)
 	if (lowercase != enable)
 	{
 		lowercase = enable;
+		size_t old_size = text.size();
 		text = ToLower(text);
+		undo_journal.Clear();
+		NotifyTextChanged(0, old_size, text);
 		Update();
 	}
 }
@@ -158,7 +161,10 @@ void LineEdit::SetUppercase(bool enable)
 	if (uppercase != enable)
 	{
 		uppercase = enable;
+		size_t old_size = text.size();
 		text = ToUpper(text);
+		undo_journal.Clear();
+		NotifyTextChanged(0, old_size, text);
 		Update();
 	}
 }
@@ -177,11 +183,14 @@ void LineEdit::SetMaxLength(int length)
 	if (max_length != length)
 	{
 		max_length = length;
-		if ((int)text.length() > length)
+		if (length >= 0 && (int)text.length() > length)
 		{
 			if (FuncBeforeEditChanged)
 				FuncBeforeEditChanged();
+			undo_journal.Record(length, text.substr(length), {});
+			size_t old_size = text.size();
 			text = text.substr(0, length);
+			NotifyTextChanged(length, old_size - length, {});
 			if (FuncAfterEditChanged)
 				FuncAfterEditChanged();
 		}
@@ -191,12 +200,15 @@ void LineEdit::SetMaxLength(int length)
 
 void LineEdit::SetText(const std::string& newtext)
 {
+	size_t old_size = text.size();
 	if (lowercase)
 		text = ToLower(newtext);
 	else if (uppercase)
 		text = ToUpper(newtext);
 	else
 		text = newtext;
+	undo_journal.Clear();
+	NotifyTextChanged(0, old_size, text);
 
 	clip_start_offset = 0;
 	UpdateTextClipping();
@@ -207,7 +219,10 @@ void LineEdit::SetText(const std::string& newtext)
 
 void LineEdit::SetTextInt(int number)
 {
+	size_t old_size = text.size();
 	text = std::to_string(number);
+	undo_journal.Clear();
+	NotifyTextChanged(0, old_size, text);
 	clip_start_offset = 0;
 	UpdateTextClipping();
 	SetCursorPos((int)text.size());
@@ -217,7 +232,10 @@ void LineEdit::SetTextInt(int number)
 
 void LineEdit::SetTextFloat(float number, int num_decimal_places)
 {
+	size_t old_size = text.size();
 	text = ToFixed(number, num_decimal_places);
+	undo_journal.Clear();
+	NotifyTextChanged(0, old_size, text);
 	clip_start_offset = 0;
 	UpdateTextClipping();
 	SetCursorPos((int)text.size());
@@ -252,7 +270,9 @@ void LineEdit::DeleteSelectedText()
 	if (sel_start > sel_end)
 		std::swap(sel_start, sel_end);
 
-	text = text.substr(0, sel_start) + text.substr(sel_end, text.size());
+	undo_journal.Record(sel_start, text.substr(sel_start, sel_end - sel_start), {});
+	text.erase(sel_start, sel_end - sel_start);
+	NotifyTextChanged(sel_start, sel_end - sel_start, {});
 	cursor_pos = sel_start;
 	SetTextSelection(0, 0);
 	int old_pos = GetCursorPos();
@@ -512,6 +532,7 @@ void LineEdit::OnKeyDown(InputKey key)
 		end_str = std::remove(str.begin(), str.end(), '\r');
 		str.resize(end_str - str.begin());
 		DeleteSelectedText();
+		undo_journal.EndTyping();
 
 		if (input_mask.empty())
 		{
@@ -573,16 +594,19 @@ void LineEdit::OnKeyDown(InputKey key)
 			}
 		}
 
+		undo_journal.EndTyping();
 		UpdateTextClipping();
 	}
 	else if (GetKeyState(InputKey::Ctrl) && key == InputKey::Z)
 	{
-		if (!readonly)
-		{
-			std::string tmp = undo_info.undo_text;
-			undo_info.undo_text = GetText();
-			SetText(tmp);
-		}
+		if (GetKeyState(InputKey::Shift))
+			Redo();
+		else
+			Undo();
+	}
+	else if (GetKeyState(InputKey::Ctrl) && key == InputKey::Y)
+	{
+		Redo();
 	}
 	else if (key == InputKey::Shift)
 	{
@@ -671,44 +695,83 @@ void LineEdit::Move(int steps, bool ctrl, bool shift)
 
 	Update();
 
-	undo_info.first_text_insert = true;
+	undo_journal.EndTyping();
 }
 
 bool LineEdit::InsertText(int pos, const std::string& str)
 {
-	undo_info.first_erase = false;
-	if (undo_info.first_text_insert)
-	{
-		undo_info.undo_text = GetText();
-		undo_info.first_text_insert = false;
-	}
-
 	// checking if insert exceeds max length
 	if (UTF8Reader::utf8_length(text) + UTF8Reader::utf8_length(str) > (size_t)max_length)
 	{
 		return false;
 	}
 
-	if (lowercase)
-		text.insert(pos, ToLower(str));
-	else if (uppercase)
-		text.insert(pos, ToUpper(str));
-	else
-		text.insert(pos, str);
+	std::string inserted = lowercase ? ToLower(str) : uppercase ? ToUpper(str) : str;
+	text.insert(pos, inserted);
+	NotifyTextChanged(pos, 0, inserted);
+	undo_journal.Record(pos, {}, std::move(inserted), true);
 
 	UpdateTextClipping();
 	Update();
 	return true;
 }
 
-void LineEdit::Backspace()
+void LineEdit::ApplyEdit(size_t offset, size_t length, const std::string& newtext)
+{
+	text.replace(offset, length, newtext);
+	NotifyTextChanged(offset, length, newtext);
+	SetTextSelection(0, 0);
+	SetCursorPos((int)(offset + newtext.size()));
+}
+
+void LineEdit::NotifyTextChanged(size_t offset, size_t length, const std::string& newtext)
 {
-	if (undo_info.first_erase)
+	// Every edit passes through here, so the shaped text only has to look at the bytes that changed
+	text_run.ReplaceText(offset, length, newtext);
+
+	if (FuncTextChanged)
 	{
-		undo_info.first_erase = false;
-		undo_info.undo_text = GetText();
+		TextChange change;
+		change.start = offset;
+		change.removed_length = length;
+		change.inserted_length = newtext.size();
+		change.inserted = newtext;
+		FuncTextChanged(change);
 	}
+}
+
+void LineEdit::Undo()
+{
+	if (readonly)
+		return;
+
+	const UndoJournal::Edit* edit = undo_journal.Undo();
+	if (edit)
+		ApplyEdit(edit->offset, edit->inserted.size(), edit->removed);
+}
+
+void LineEdit::Redo()
+{
+	if (readonly)
+		return;
+
+	const UndoJournal::Edit* edit = undo_journal.Redo();
+	if (edit)
+		ApplyEdit(edit->offset, edit->removed.size(), edit->inserted);
+}
+
+bool LineEdit::CanUndo() const
+{
+	return !readonly && undo_journal.CanUndo();
+}
 
+bool LineEdit::CanRedo() const
+{
+	return !readonly && undo_journal.CanRedo();
+}
+
+void LineEdit::Backspace()
+{
 	if (GetSelectionLength() != 0)
 	{
 		DeleteSelectedText();
@@ -722,7 +785,9 @@ void LineEdit::Backspace()
 			utf8_reader.set_position(cursor_pos);
 			utf8_reader.prev();
 			size_t length = utf8_reader.char_length();
+			undo_journal.Record(cursor_pos - length, text.substr(cursor_pos - length, length), {}, true);
 			text.erase(cursor_pos - length, length);
+			NotifyTextChanged(cursor_pos - length, length, {});
 			cursor_pos -= (int)length;
 			Update();
 		}
@@ -735,12 +800,6 @@ void LineEdit::Backspace()
 
 void LineEdit::Del()
 {
-	if (undo_info.first_erase)
-	{
-		undo_info.first_erase = false;
-		undo_info.undo_text = GetText();
-	}
-
 	if (GetSelectionLength() != 0)
 	{
 		DeleteSelectedText();
@@ -753,7 +812,9 @@ void LineEdit::Del()
 			UTF8Reader utf8_reader(text.data(), text.length());
 			utf8_reader.set_position(cursor_pos);
 			size_t length = utf8_reader.char_length();
+			undo_journal.Record(cursor_pos, text.substr(cursor_pos, length), {}, true);
 			text.erase(cursor_pos, length);
+			NotifyTextChanged(cursor_pos, length, {});
 			Update();
 		}
 	}
@@ -770,49 +831,9 @@ int LineEdit::GetCharacterIndex(double mouse_x)
 	if (!canvas)
 		return 0;
 
-	UTF8Reader utf8_reader(text.data(), text.length());
-
-	int seek_start = clip_start_offset;
-	int seek_end = (int)text.size();
-	int seek_center = (seek_start + seek_end) / 2;
-
-	//fast search
-	while (true)
-	{
-		utf8_reader.set_position(seek_center);
-		utf8_reader.move_to_leadbyte();
-
-		seek_center = (int)utf8_reader.position();
-
-		Size text_size = GetVisualTextSize(canvas, clip_start_offset, seek_center - clip_start_offset);
-
-		if (text_size.width > mouse_x)
-			seek_end = seek_center;
-		else
-			seek_start = seek_center;
-
-		if (seek_end - seek_start < 7)
-			break; //go to accurate search
-
-		seek_center = (seek_start + seek_end) / 2;
-	}
-
-	utf8_reader.set_position(seek_start);
-	utf8_reader.move_to_leadbyte();
-
-	//accurate search
-	while (true)
-	{
-		seek_center = (int)utf8_reader.position();
-
-		Size text_size = GetVisualTextSize(canvas, clip_start_offset, seek_center - clip_start_offset);
-		if (text_size.width > mouse_x || utf8_reader.is_end())
-			break;
-
-		utf8_reader.next();
-	}
-
-	return seek_center;
+	ChunkedTextRun& run = GetTextRun(canvas);
+	int index = (int)run.GetCharacterIndex(canvas, mouse_x + run.GetPosition(canvas, clip_start_offset));
+	return std::max(index, clip_start_offset);
 }
 
 void LineEdit::UpdateTextClipping()
@@ -821,54 +842,35 @@ void LineEdit::UpdateTextClipping()
 	if (!canvas)
 		return;
 
-	// Size text_size = GetVisualTextSize(canvas, clip_start_offset, (int)text.size() - clip_start_offset);
-
-	if (cursor_pos < clip_start_offset)
-		clip_start_offset = cursor_pos;
-
-	Rect cursor_rect = GetCursorRect();
-
+	ChunkedTextRun& run = GetTextRun(canvas);
 	UTF8Reader utf8_reader(text.data(), text.length());
 	double width = GetWidth();
-	while (cursor_rect.x + cursor_rect.width > width)
-	{
-		utf8_reader.set_position(clip_start_offset);
-		utf8_reader.next();
-		clip_start_offset = (int)utf8_reader.position();
-		if (clip_start_offset == (int)text.size())
-			break;
-		cursor_rect = GetCursorRect();
-	}
 
-	// Get number of chars of current text fitting in the lineedit.
-	int search_upper = (int)text.size();
-	int search_lower = clip_start_offset;
+	// Find the first character that keeps the cursor inside the widget
+	if (cursor_pos < clip_start_offset)
+		clip_start_offset = cursor_pos;
 
-	while (true)
+	double cursor_x = run.GetPosition(canvas, cursor_pos);
+	if (cursor_x + 1.0 > run.GetPosition(canvas, clip_start_offset) + width)
 	{
-		int midpoint = (search_lower + search_upper) / 2;
-
-		utf8_reader.set_position(midpoint);
-		utf8_reader.move_to_leadbyte();
-		if (midpoint != (int)utf8_reader.position())
+		clip_start_offset = (int)run.GetCharacterIndex(canvas, cursor_x + 1.0 - width);
+		if (clip_start_offset < (int)text.size() && run.GetPosition(canvas, clip_start_offset) < cursor_x + 1.0 - width)
+		{
+			utf8_reader.set_position(clip_start_offset);
 			utf8_reader.next();
-		midpoint = (int)utf8_reader.position();
-
-		if (midpoint == search_lower || midpoint == search_upper)
-			break;
-
-		Size midpoint_size = GetVisualTextSize(canvas, clip_start_offset, midpoint - clip_start_offset);
-
-		if (width < midpoint_size.width)
-			search_upper = midpoint;
-		else
-			search_lower = midpoint;
+			clip_start_offset = (int)utf8_reader.position();
+		}
+		clip_start_offset = std::min(clip_start_offset, cursor_pos);
 	}
-	clip_end_offset = search_upper;
 
-	if (cursor_rect.x < 0.0)
+	// Find the first character that does not fit in the widget
+	double clip_end_x = run.GetPosition(canvas, clip_start_offset) + width;
+	clip_end_offset = (int)run.GetCharacterIndex(canvas, clip_end_x);
+	if (clip_end_offset < (int)text.size() && run.GetPosition(canvas, clip_end_offset) <= clip_end_x)
 	{
-		clip_start_offset = cursor_pos;
+		utf8_reader.set_position(clip_end_offset);
+		utf8_reader.next();
+		clip_end_offset = (int)utf8_reader.position();
 	}
 }
 
@@ -878,22 +880,10 @@ Rect LineEdit::GetCursorRect()
 	if (!canvas)
 		return Rect::xywh(0.0, 0.0, 0.0, 0.0);
 
-	int substr_end = cursor_pos - clip_start_offset;
-	if (substr_end < 0)
-		substr_end = 0;
-
-	std::string clipped_text = text.substr(clip_start_offset, substr_end);
-
-	if (password_mode)
-	{
-		// If we are in password mode, we gonna return the right characters
-		clipped_text = CreatePassword(UTF8Reader::utf8_length(clipped_text));
-	}
-
-	Size text_size_before_cursor = canvas->measureText(GetFont(), clipped_text).size();
+	ChunkedTextRun& run = GetTextRun(canvas);
 
 	Rect cursor_rect;
-	cursor_rect.x = text_size_before_cursor.width;
+	cursor_rect.x = run.GetWidth(canvas, clip_start_offset, std::max(cursor_pos, clip_start_offset));
 	cursor_rect.width = 1.0f;
 
 	cursor_rect.y = vertical_text_align.top;
@@ -908,18 +898,16 @@ Rect LineEdit::GetSelectionRect()
 	if (!canvas)
 		return Rect::xywh(0.0, 0.0, 0.0, 0.0);
 
-	// text before selection:
-
-	std::string txt_before = GetVisibleTextBeforeSelection();
-	Size text_size_before_selection = canvas->measureText(GetFont(), txt_before).size();
+	ChunkedTextRun& run = GetTextRun(canvas);
 
-	// selection text:
-	std::string txt_selected = GetVisibleSelectedText();
-	Size text_size_selection = canvas->measureText(GetFont(), txt_selected).size();
+	int sel_start = std::min(selection_start, selection_start + selection_length);
+	int sel_end = std::max(selection_start, selection_start + selection_length);
+	int start = std::clamp(sel_start, clip_start_offset, std::max(clip_start_offset, clip_end_offset));
+	int end = std::clamp(sel_end, start, std::max(start, clip_end_offset));
 
 	Rect selection_rect;
-	selection_rect.x = text_size_before_selection.width;
-	selection_rect.width = text_size_selection.width;
+	selection_rect.x = run.GetWidth(canvas, clip_start_offset, start);
+	selection_rect.width = run.GetWidth(canvas, start, end);
 	selection_rect.y = vertical_text_align.top;
 	selection_rect.height = vertical_text_align.bottom - vertical_text_align.top;
 	return selection_rect;
@@ -976,53 +964,6 @@ void LineEdit::OnGeometryChanged()
 	UpdateTextClipping();
 }
 
-std::string LineEdit::GetVisibleTextBeforeSelection()
-{
-	std::string ret;
-	int sel_start = std::min(selection_start, selection_start + selection_length);
-	int start = std::min(sel_start, clip_start_offset);
-
-	if (start < clip_start_offset)
-		return ret;
-
-	int end = std::min(sel_start, clip_end_offset);
-
-	ret = text.substr(start, end - start);
-
-	// If we are in password mode, we gonna return the right characters
-	if (password_mode)
-		ret = CreatePassword(UTF8Reader::utf8_length(ret));
-
-	return ret;
-}
-
-std::string LineEdit::GetVisibleSelectedText()
-{
-	std::string ret;
-
-	if (selection_length == 0)
-		return ret;
-
-	int sel_start = std::min(selection_start, selection_start + selection_length);
-	int sel_end = std::max(selection_start, selection_start + selection_length);
-	int end = std::min(clip_end_offset, sel_end);
-	int start = std::max(clip_start_offset, sel_start);
-
-	if (start > end)
-		return ret;
-
-	if (start == end)
-		return ret;
-
-	ret = text.substr(start, end - start);
-
-	// If we are in password mode, we gonna return the right characters
-	if (password_mode)
-		ret = CreatePassword(UTF8Reader::utf8_length(ret));
-
-	return ret;
-}
-
 void LineEdit::SetSelectionStart(int start)
 {
 	if (FuncSelectionChanged && selection_length && selection_start != start)
@@ -1048,71 +989,22 @@ void LineEdit::SetTextSelection(int start, int length)
 	selection_length = length;
 }
 
-std::string LineEdit::GetVisibleTextAfterSelection()
-{
-	// returns the whole visible string if there is no selection.
-	std::string ret;
-
-	int sel_end = std::max(selection_start, selection_start + selection_length);
-	int start = std::max(clip_start_offset, sel_end);
-
-	int end = clip_end_offset;
-	if (start > end)
-		return ret;
-
-	if (clip_end_offset == sel_end)
-		return ret;
-
-	if (sel_end <= 0)
-		return ret;
-	else
-	{
-		ret = text.substr(start, end - start);
-		// If we are in password mode, we gonna return the right characters
-		if (password_mode)
-			ret = CreatePassword(UTF8Reader::utf8_length(ret));
-
-		return ret;
-	}
-}
-
 void LineEdit::OnPaint(Canvas* canvas)
 {
-	std::string txt_before = GetVisibleTextBeforeSelection();
-	std::string txt_selected = GetVisibleSelectedText();
-	std::string txt_after = GetVisibleTextAfterSelection();
-
-	if (txt_before.empty() && txt_selected.empty() && txt_after.empty())
-	{
-		txt_after = text.substr(clip_start_offset, clip_end_offset - clip_start_offset);
-
-		// If we are in password mode, we gonna return the right characters
-		if (password_mode)
-			txt_after = CreatePassword(UTF8Reader::utf8_length(txt_after));
-	}
-
-	Size size_before = canvas->measureText(GetFont(), txt_before).size();
-	Size size_selected = canvas->measureText(GetFont(), txt_selected).size();
+	ChunkedTextRun& run = GetTextRun(canvas);
 
-	if (!txt_selected.empty())
+	if (selection_length != 0)
 	{
 		// Draw selection box.
 		Rect selection_rect = GetSelectionRect();
-		canvas->fillRect(selection_rect, HasFocus() ? GetStyleColor("selection-color") : GetStyleColor("no-focus-selection-color"));
+		if (selection_rect.width > 0.0)
+			canvas->fillRect(selection_rect, HasFocus() ? GetStyleColor(StyleProperty::SelectionColor) : GetStyleColor(StyleProperty::NoFocusSelectionColor));
 	}
 
-	// Draw text before selection
-	if (!txt_before.empty())
-	{
-		canvas->drawText(GetFont(), Point(0.0, canvas->verticalTextAlign(GetFont()).baseline), txt_before, GetStyleColor("color"));
-	}
-	if (!txt_selected.empty())
-	{
-		canvas->drawText(GetFont(), Point(size_before.width, canvas->verticalTextAlign(GetFont()).baseline), txt_selected, GetStyleColor("color"));
-	}
-	if (!txt_after.empty())
+	if (clip_start_offset < clip_end_offset)
 	{
-		canvas->drawText(GetFont(), Point(size_before.width + size_selected.width, canvas->verticalTextAlign(GetFont()).baseline), txt_after, GetStyleColor("color"));
+		Point pos(-run.GetPosition(canvas, clip_start_offset), canvas->verticalTextAlign(GetFont()).baseline);
+		run.Draw(canvas, pos, clip_start_offset, clip_end_offset, 0.0, GetWidth(), GetStyleColor(StyleProperty::Color));
 	}
 
 	// draw cursor
@@ -1121,7 +1013,7 @@ void LineEdit::OnPaint(Canvas* canvas)
 		if (cursor_blink_visible)
 		{
 			Rect cursor_rect = GetCursorRect();
-			canvas->fillRect(cursor_rect, GetStyleColor("color"));
+			canvas->fillRect(cursor_rect, GetStyleColor(StyleProperty::Color));
 		}
 	}
 }
@@ -1151,19 +1043,22 @@ bool LineEdit::InputMaskAcceptsInput(int cursor_pos, const std::string& str)
 	return str.find_first_not_of(input_mask) == std::string::npos;
 }
 
-std::string LineEdit::CreatePassword(std::string::size_type num_letters) const
+ChunkedTextRun& LineEdit::GetTextRun(Canvas* canvas)
 {
-	return std::string(num_letters, '*');
+	text_run.SetFont(GetFont(), password_mode ? '*' : 0);
+	return text_run;
 }
 
-Size LineEdit::GetVisualTextSize(Canvas* canvas, int pos, int npos) const
+Size LineEdit::GetVisualTextSize(Canvas* canvas, int pos, int npos)
 {
-	return canvas->measureText(GetFont(), password_mode ? CreatePassword(UTF8Reader::utf8_length(text.substr(pos, npos))) : text.substr(pos, npos)).size();
+	ChunkedTextRun& run = GetTextRun(canvas);
+	return Size(run.GetWidth(canvas, pos, pos + npos), run.GetHeight(canvas));
 }
 
-Size LineEdit::GetVisualTextSize(Canvas* canvas) const
+Size LineEdit::GetVisualTextSize(Canvas* canvas)
 {
-	return canvas->measureText(GetFont(), password_mode ? CreatePassword(UTF8Reader::utf8_length(text)) : text).size();
+	ChunkedTextRun& run = GetTextRun(canvas);
+	return Size(run.GetWidth(canvas), run.GetHeight(canvas));
 }
 
 std::string LineEdit::ToFixed(float number, int num_decimal_places)
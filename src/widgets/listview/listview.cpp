@@ -1,6 +1,8 @@
 #include "widgets/listview/listview.h"
 #include "widgets/scrollbar/scrollbar.h"
+#include "core/timer.h"
 #include <algorithm>
+#include <numeric>
 
 ListView::ListView(Widget* parent) : Widget(parent)
 {
@@ -14,6 +16,36 @@ ListView::ListView(Widget* parent) : Widget(parent)
 	header->SetVisible(false);
 
 	body = new ListViewBody(this);
+
+	sortTimer = new Timer(this);
+	sortTimer->FuncExpired = [this]() { OnSortTimerExpired(); };
+
+	items = std::make_shared<ListViewItemModel>();
+	SetModel(nullptr);
+}
+
+ListView::~ListView()
+{
+	sorter.Stop();
+	auto& views = model->views;
+	views.erase(std::remove(views.begin(), views.end(), this), views.end());
+}
+
+void ListView::SetModel(std::shared_ptr<ListViewModel> newModel)
+{
+	if (!newModel)
+		newModel = items;
+	if (newModel == model)
+		return;
+
+	if (model)
+	{
+		auto& views = model->views;
+		views.erase(std::remove(views.begin(), views.end(), this), views.end());
+	}
+	model = std::move(newModel);
+	model->views.push_back(this);
+	OnModelReset();
 }
 
 int ListView::GetColumnCount() const
@@ -66,61 +98,420 @@ void ListView::ShowHeader(bool value)
 
 void ListView::AddItem(std::initializer_list<std::string> columns, int index)
 {
-	auto item = std::make_unique<ListViewItem>();
-	item->columns = columns;
+	ListViewItem item;
+	item.columns = columns;
+	items->AddItem(std::move(item), index);
+}
 
-	if (index < 0)
-		items.push_back(std::move(item));
-	else
-		items.insert(items.begin() + index, std::move(item));
+void ListView::AddItem(const std::string& text, int index, int column)
+{
+	ListViewItem item;
+	item.columns.resize(column + 1);
+	item.columns[column] = text;
+	items->AddItem(std::move(item), index);
+}
 
-	scrollbar->SetRanges(body->GetHeight(), items.size() * body->GetItemHeight());
-	Update();
+void ListView::UpdateItem(const std::string& text, int index, int column)
+{
+	items->UpdateItem(text, index, column);
 }
 
-void ListView::AddItem(const std::string& text, int index, int column)
+void ListView::SetItemHeight(int index, double height)
 {
-	auto item = std::make_unique<ListViewItem>();
-	item->columns.resize(column + 1);
-	item->columns[column] = text;
+	items->SetItemHeight(index, height);
+}
 
-	if (index < 0)
-		items.push_back(std::move(item));
-	else
-		items.insert(items.begin() + index, std::move(item));
+void ListView::SetVariableRowHeight(bool enable)
+{
+	if (variableRowHeight != enable)
+	{
+		variableRowHeight = enable;
+		rowHeightsChanged = true;
+		scrollRangesChanged = true;
+		Update();
+	}
+}
 
-	scrollbar->SetRanges(body->GetHeight(), items.size() * body->GetItemHeight());
-	Update();
+void ListView::SortByColumn(int column, bool ascending, std::function<bool(const std::string& a, const std::string& b)> less)
+{
+	sortOptions.column = column;
+	sortOptions.ascending = ascending;
+	sortOptions.less = std::move(less);
+	RestartSort();
 }
 
-void ListView::UpdateItem(const std::string& text, int index, int column)
+void ListView::SetFilter(std::function<bool(int row)> filter)
 {
-	if (index < 0 || (size_t)index >= items.size() || column < 0)
-		return;
+	sortOptions.filter = std::move(filter);
+	RestartSort();
+}
 
-	ListViewItem* item = items[index].get();
-	item->columns.resize(std::max((size_t)column + 1, item->columns.size()));
-	item->columns[column] = text;
+void ListView::SetTypeAhead(ListViewTypeAhead mode, bool matchSubstring, int column)
+{
+	typeAheadMode = mode;
+	typeAheadColumn = column;
+	typeAheadIndex.SetMatchSubstring(matchSubstring);
+	typeAheadIndexChanged = true;
+	SetTypeAheadText(std::string());
+}
 
-	Update();
+void ListView::SetTypeAheadText(const std::string& text)
+{
+	bool wasFiltering = typeAheadMode == ListViewTypeAhead::Filter && !typeAheadText.empty();
+	typeAheadText = text;
+	typeAheadTime = std::chrono::steady_clock::now();
+
+	if (typeAheadMode == ListViewTypeAhead::Select && !typeAheadText.empty())
+	{
+		int row = FindTypeAheadMatch();
+		if (row >= 0)
+		{
+			SetSelectedItem(row);
+			ScrollToItem(row);
+		}
+	}
+	else if (typeAheadMode == ListViewTypeAhead::Filter && !typeAheadText.empty() && sortOptions.column < 0 && !sortOptions.filter)
+	{
+		// Without sorting the index already has the matches in model order, so they are shown right away
+		UpdateTypeAheadIndex();
+		sorter.Stop();
+		sortPending = false;
+		sortTimer->Stop();
+		SetViewRows(typeAheadIndex.FindAll(typeAheadText));
+	}
+	else if (wasFiltering || typeAheadMode == ListViewTypeAhead::Filter)
+	{
+		RestartSort();
+	}
+}
+
+void ListView::UpdateTypeAheadIndex()
+{
+	if (typeAheadIndexChanged)
+	{
+		typeAheadIndexChanged = false;
+		typeAheadIndex.Build(model->GetRowCount(), [this](int row) { return model->GetCellText(row, typeAheadColumn); });
+	}
+}
+
+int ListView::FindTypeAheadMatch()
+{
+	// Select the first match shown at or after the selected row, wrapping around at the end
+	UpdateTypeAheadIndex();
+	if (!sorted)
+		return typeAheadIndex.FindNext(typeAheadText, selectedItem);
+
+	int count = GetViewRowCount();
+	int current = std::max(ToViewRow(selectedItem), 0);
+	int match = -1;
+	int matchDistance = count;
+	for (int row : typeAheadIndex.FindAll(typeAheadText))
+	{
+		int position = ToViewRow(row);
+		if (position < 0)
+			continue;
+		int distance = position >= current ? position - current : position - current + count;
+		if (distance < matchDistance)
+		{
+			match = row;
+			matchDistance = distance;
+		}
+	}
+	return match;
 }
 
 void ListView::RemoveItem(int index)
 {
-	if (!items.size() || index >= (int)items.size())
+	int count = items->GetRowCount();
+	if (!count || index >= count)
 		return;
 
 	if (index < 0)
-		index = static_cast<int>(items.size()) - 1;
+		index = count - 1;
 
-	if (selectedItem == index)
+	if (selectedItem == index && model == items)
 		SetSelectedItem(0);
 
-	items.erase(items.begin() + index);
-	scrollbar->SetRanges(body->GetHeight(), items.size() * body->GetItemHeight());
+	items->RemoveItem(index);
+}
+
+void ListView::OnRowsAboutToChange()
+{
+	// The sorter reads the rows, so it has to stop before they change. It starts again on the next timer tick.
+	if (sorter.IsRunning())
+	{
+		sorter.Stop();
+		sortPending = true;
+	}
+}
+
+void ListView::OnRowsChanged(int first, int count)
+{
+	typeAheadIndexChanged = true;
+	if (sorted)
+	{
+		rowHeightsChanged = true;
+		RestartSort();
+	}
+	else if (variableRowHeight && !rowHeightsChanged)
+	{
+		for (int row = first, end = std::min(first + count, (int)rowHeights.GetCount()); row < end; row++)
+			rowHeights.SetHeight(row, model->GetRowHeight(row));
+	}
+	scrollRangesChanged = true;
 	Update();
 }
 
+void ListView::OnRowsInserted(int first, int count)
+{
+	typeAheadIndexChanged = true;
+	if (selectedItem >= first && selectedItem < model->GetRowCount() - count)
+		selectedItem += count;
+
+	if (sorted)
+	{
+		// New rows are shown at the end until they have been sorted
+		if (first < (int)viewPositions.size())
+		{
+			for (int& row : viewRows)
+			{
+				if (row >= first)
+					row += count;
+			}
+			for (int row = first; row < first + count; row++)
+				viewRows.push_back(row);
+			UpdateViewPositions();
+			rowHeightsChanged = true;
+		}
+		else
+		{
+			// Appended rows do not move the others
+			for (int row = first; row < first + count; row++)
+			{
+				viewPositions.push_back((int)viewRows.size());
+				viewRows.push_back(row);
+			}
+		}
+		RestartSort();
+	}
+	else if (variableRowHeight && !rowHeightsChanged && first < (int)rowHeights.GetCount())
+	{
+		// Rows added at the end are measured by the next UpdateRowHeights
+		std::vector<double> heights;
+		for (int row = first; row < first + count; row++)
+			heights.push_back(model->GetRowHeight(row));
+		rowHeights.Insert(first, heights);
+	}
+
+	// The scrollbar is updated once before the next paint, no matter how many rows are added until then
+	scrollRangesChanged = true;
+	Update();
+}
+
+void ListView::OnRowsRemoved(int first, int count)
+{
+	typeAheadIndexChanged = true;
+	if (selectedItem >= first + count)
+		selectedItem -= count;
+	else if (selectedItem >= first)
+		selectedItem = first;
+	selectedItem = std::max(std::min(selectedItem, model->GetRowCount() - 1), 0);
+
+	if (sorted)
+	{
+		// Removing rows does not change the order of the others
+		viewRows.erase(std::remove_if(viewRows.begin(), viewRows.end(), [=](int row) { return row >= first && row < first + count; }), viewRows.end());
+		for (int& row : viewRows)
+		{
+			if (row >= first + count)
+				row -= count;
+		}
+		UpdateViewPositions();
+		rowHeightsChanged = true;
+	}
+	else if (variableRowHeight && !rowHeightsChanged && first < (int)rowHeights.GetCount())
+	{
+		rowHeights.Remove(first, std::min(count, (int)rowHeights.GetCount() - first));
+	}
+
+	scrollRangesChanged = true;
+	Update();
+}
+
+void ListView::OnModelReset()
+{
+	typeAheadIndexChanged = true;
+	selectedItem = std::max(std::min(selectedItem, model->GetRowCount() - 1), 0);
+	sorted = false;
+	viewRows.clear();
+	viewPositions.clear();
+	RestartSort();
+
+	rowHeightsChanged = true;
+	scrollRangesChanged = true;
+	Update();
+}
+
+int ListView::GetViewRowCount() const
+{
+	return sorted ? (int)viewRows.size() : model->GetRowCount();
+}
+
+int ListView::ToModelRow(int viewRow) const
+{
+	return sorted ? viewRows[viewRow] : viewRow;
+}
+
+int ListView::ToViewRow(int modelRow) const
+{
+	if (!sorted)
+		return modelRow;
+	return modelRow >= 0 && (size_t)modelRow < viewPositions.size() ? viewPositions[modelRow] : -1;
+}
+
+void ListView::SetViewRows(std::vector<int> rows)
+{
+	sorted = true;
+	viewRows = std::move(rows);
+	UpdateViewPositions();
+	rowHeightsChanged = true;
+	scrollRangesChanged = true;
+	Update();
+}
+
+void ListView::UpdateViewPositions()
+{
+	viewPositions.assign(model->GetRowCount(), -1);
+	for (size_t i = 0; i < viewRows.size(); i++)
+		viewPositions[viewRows[i]] = (int)i;
+}
+
+bool ListView::IsSortedOrFiltered() const
+{
+	return sortOptions.column >= 0 || sortOptions.filter || (typeAheadMode == ListViewTypeAhead::Filter && !typeAheadText.empty());
+}
+
+ListViewSorter::Options ListView::GetSorterOptions() const
+{
+	ListViewSorter::Options options = sortOptions;
+	if (typeAheadMode == ListViewTypeAhead::Filter && !typeAheadText.empty())
+	{
+		// The model is kept alive by the sorter while it runs
+		const ListViewModel* rows = model.get();
+		options.filter = [rows, filter = sortOptions.filter, column = typeAheadColumn, text = typeAheadText, substring = typeAheadIndex.IsMatchSubstring()](int row)
+		{
+			return TypeAheadIndex::Matches(rows->GetCellText(row, column), text, substring) && (!filter || filter(row));
+		};
+	}
+	return options;
+}
+
+void ListView::RestartSort()
+{
+	sorter.Stop();
+	if (!IsSortedOrFiltered())
+	{
+		sortPending = false;
+		sortTimer->Stop();
+		if (sorted)
+		{
+			sorted = false;
+			viewRows.clear();
+			viewPositions.clear();
+			rowHeightsChanged = true;
+			scrollRangesChanged = true;
+			Update();
+		}
+		return;
+	}
+
+	if (!sortPending)
+	{
+		sortPending = true;
+		sortTimer->Start(30);
+	}
+}
+
+void ListView::OnSortTimerExpired()
+{
+	if (sortPending)
+	{
+		sortPending = false;
+		sorter.Start(model, GetSorterOptions());
+		return;
+	}
+
+	if (!sorter.IsRunning())
+	{
+		sortTimer->Stop();
+		return;
+	}
+
+	double progress = 0.0;
+	std::vector<int> rows;
+	bool finished = sorter.Poll(progress, rows);
+	if (finished)
+	{
+		sortTimer->Stop();
+		SetViewRows(std::move(rows));
+	}
+
+	if (OnSortProgress)
+		OnSortProgress(finished ? 1.0 : progress);
+}
+
+void ListView::UpdateRowHeights()
+{
+	if (!variableRowHeight)
+		return;
+
+	int count = GetViewRowCount();
+	if (rowHeightsChanged || (int)rowHeights.GetCount() > count)
+	{
+		rowHeights.Clear();
+		rowHeightsChanged = false;
+	}
+	for (int row = (int)rowHeights.GetCount(); row < count; row++)
+		rowHeights.Append(model->GetRowHeight(ToModelRow(row)));
+}
+
+void ListView::UpdateScrollRanges()
+{
+	UpdateRowHeights();
+	if (scrollRangesChanged)
+	{
+		scrollRangesChanged = false;
+		double total = variableRowHeight ? rowHeights.GetTotalHeight() : GetViewRowCount() * body->GetItemHeight();
+		scrollbar->SetRanges(body->GetHeight(), total);
+	}
+}
+
+double ListView::GetRowTop(int row)
+{
+	if (!variableRowHeight)
+		return row * body->GetItemHeight();
+	UpdateRowHeights();
+	return rowHeights.GetTop(std::min((size_t)row, rowHeights.GetCount()));
+}
+
+double ListView::GetRowHeight(int row)
+{
+	if (!variableRowHeight)
+		return body->GetItemHeight();
+	UpdateRowHeights();
+	return (size_t)row < rowHeights.GetCount() ? rowHeights.GetHeight(row) : 0.0;
+}
+
+int ListView::GetRowAt(double y)
+{
+	if (y < 0.0)
+		return -1;
+	if (!variableRowHeight)
+		return (int)(y / body->GetItemHeight());
+	UpdateRowHeights();
+	return (int)rowHeights.FindRow(y);
+}
+
 void ListView::Activate()
 {
 	if (OnActivated)
@@ -129,7 +520,7 @@ void ListView::Activate()
 
 void ListView::SetSelectedItem(int index, bool notify)
 {
-	if (selectedItem != index && index >= 0 && index < (int)items.size())
+	if (selectedItem != index && index >= 0 && index < model->GetRowCount())
 	{
 		selectedItem = index;
 		Update();
@@ -140,21 +531,38 @@ void ListView::SetSelectedItem(int index, bool notify)
 
 void ListView::ScrollToItem(int index)
 {
-	double itemHeight = body->GetItemHeight();
-	double y = itemHeight * index;
+	index = ToViewRow(index);
+	if (index < 0)
+		return;
+
+	UpdateScrollRanges();
+
+	double itemHeight = GetRowHeight(index);
+	double y = GetRowTop(index);
 	if (y < scrollbar->GetPosition())
 	{
 		scrollbar->SetPosition(y);
 	}
-	else if (y + itemHeight > scrollbar->GetPosition() + GetHeight())
+	else if (y + itemHeight > scrollbar->GetPosition() + body->GetHeight())
+	{
+		scrollbar->SetPosition(std::max(y + itemHeight - body->GetHeight(), 0.0));
+	}
+	ScrollPaintedRows();
+}
+
+void ListView::ScrollPaintedRows()
+{
+	double scroll = scrollbar->GetPosition();
+	if (scroll != paintedScroll)
 	{
-		scrollbar->SetPosition(std::max(y + itemHeight - GetHeight(), 0.0));
+		body->ScrollRect(Rect::xywh(0.0, 0.0, body->GetWidth(), body->GetHeight()), 0.0, paintedScroll - scroll);
+		paintedScroll = scroll;
 	}
 }
 
 void ListView::OnScrollbarScroll()
 {
-	Update();
+	ScrollPaintedRows();
 }
 
 double ListView::GetHeaderHeight()
@@ -178,7 +586,9 @@ void ListView::OnGeometryChanged()
 	header->SetFrameGeometry(Rect::xywh(0.0, 0.0, w - sw, hh));
 	body->SetFrameGeometry(Rect::xywh(0.0, hh, w - sw, h - hh));
 	scrollbar->SetFrameGeometry(Rect::xywh(w - sw, 0.0, sw, h));
-	scrollbar->SetRanges(body->GetHeight(), items.size() * body->GetItemHeight());
+	scrollRangesChanged = true;
+	UpdateScrollRanges();
+	Update();
 }
 
 double ListView::GetPreferredWidth()
@@ -196,12 +606,12 @@ double ListView::GetPreferredWidth()
 	{
 		auto canvas = GetCanvas();
 		auto font = GetFont();
-		for (const auto& row : items)
+		for (int row = 0, count = model->GetRowCount(); row < count; row++)
 		{
 			double wRow = 0.0;
-			for (const auto& cell : row->columns)
+			for (int col = 0, colCount = header->GetColumnCount(); col < colCount; col++)
 			{
-				wRow += canvas->measureText(font, cell).width;
+				wRow += canvas->measureText(font, model->GetCellText(row, col)).width;
 			}
 			total = std::max(wRow, total);
 		}
@@ -212,7 +622,7 @@ double ListView::GetPreferredWidth()
 
 double ListView::GetPreferredHeight()
 {
-	return items.size()*20.0 + 10.0*2; // Items plus top/bottom padding
+	return model->GetRowCount()*20.0 + 10.0*2; // Items plus top/bottom padding
 }
 
 double ListView::GetMinimumHeight()
@@ -220,21 +630,50 @@ double ListView::GetMinimumHeight()
 	return 20.0 + 10.0*2; // One item plus top/bottom padding
 }
 
+void ListView::OnKeyChar(std::string chars)
+{
+	if (typeAheadMode == ListViewTypeAhead::None || chars.empty() || (uint8_t)chars[0] < 32 || chars[0] == 127)
+		return;
+
+	// Selecting starts over after a pause in typing
+	if (typeAheadMode == ListViewTypeAhead::Select && std::chrono::steady_clock::now() - typeAheadTime > std::chrono::seconds(1))
+		typeAheadText.clear();
+
+	if (typeAheadText.empty() && chars == " ")
+		return;
+
+	SetTypeAheadText(typeAheadText + chars);
+}
+
 void ListView::OnKeyDown(InputKey key)
 {
-	if (key == InputKey::Down)
+	// Keys move through the rows in the order they are shown
+	int count = GetViewRowCount();
+	int current = ToViewRow(selectedItem);
+	if (key == InputKey::Backspace && !typeAheadText.empty())
+	{
+		size_t length = typeAheadText.size() - 1;
+		while (length > 0 && (typeAheadText[length] & 0xc0) == 0x80)
+			length--;
+		SetTypeAheadText(typeAheadText.substr(0, length));
+	}
+	else if (key == InputKey::Escape && !typeAheadText.empty())
 	{
-		if (selectedItem + 1 < (int)items.size())
+		SetTypeAheadText(std::string());
+	}
+	else if (key == InputKey::Down)
+	{
+		if (current + 1 < count)
 		{
-			SetSelectedItem(selectedItem + 1);
+			SetSelectedItem(ToModelRow(current + 1));
 		}
 		ScrollToItem(selectedItem);
 	}
 	else if (key == InputKey::Up)
 	{
-		if (selectedItem > 0)
+		if (current != 0 && count > 0)
 		{
-			SetSelectedItem(selectedItem - 1);
+			SetSelectedItem(ToModelRow(std::max(current - 1, 0)));
 		}
 		ScrollToItem(selectedItem);
 	}
@@ -244,43 +683,43 @@ void ListView::OnKeyDown(InputKey key)
 	}
 	else if (key == InputKey::Home)
 	{
-		if (selectedItem > 0)
+		if (current != 0 && count > 0)
 		{
-			SetSelectedItem(0);
+			SetSelectedItem(ToModelRow(0));
 		}
 		ScrollToItem(selectedItem);
 	}
 	else if (key == InputKey::End)
 	{
-		if (selectedItem + 1 < (int)items.size())
+		if (current + 1 != count && count > 0)
 		{
-			SetSelectedItem((int)items.size() - 1);
+			SetSelectedItem(ToModelRow(count - 1));
 		}
 		ScrollToItem(selectedItem);
 	}
 	else if (key == InputKey::PageUp)
 	{
-		double h = GetHeight();
-		if (h <= 0.0 || items.empty())
+		double h = body->GetHeight();
+		if (h <= 0.0 || count == 0)
 			return;
-		int itemsPerPage = (int)std::max(std::round(h / body->GetItemHeight()), 1.0);
-		int nextItem = std::max(selectedItem - itemsPerPage, 0);
-		if (nextItem != selectedItem)
+		current = std::max(current, 0);
+		int nextItem = std::max(std::min(GetRowAt(GetRowTop(current) - h) + 1, current - 1), 0);
+		if (nextItem != current)
 		{
-			SetSelectedItem(nextItem);
+			SetSelectedItem(ToModelRow(nextItem));
 			ScrollToItem(selectedItem);
 		}
 	}
 	else if (key == InputKey::PageDown)
 	{
-		double h = GetHeight();
-		if (h <= 0.0 || items.empty())
+		double h = body->GetHeight();
+		if (h <= 0.0 || count == 0)
 			return;
-		int itemsPerPage = (int)std::max(std::round(h / body->GetItemHeight()), 1.0);
-		int prevItem = std::min(selectedItem + itemsPerPage, (int)items.size() - 1);
-		if (prevItem != selectedItem)
+		current = std::max(current, 0);
+		int prevItem = std::min(std::max(GetRowAt(GetRowTop(current) + h), current + 1), count - 1);
+		if (prevItem != current)
 		{
-			SetSelectedItem(prevItem);
+			SetSelectedItem(ToModelRow(prevItem));
 			ScrollToItem(selectedItem);
 		}
 	}
@@ -303,43 +742,53 @@ void ListViewBody::OnKeyDown(InputKey key)
 	listview->OnKeyDown(key);
 }
 
+void ListViewBody::OnKeyChar(std::string chars)
+{
+	listview->OnKeyChar(chars);
+}
+
 void ListViewBody::OnPaint(Canvas* canvas)
 {
 	double x = 2.0;
 	double w = GetWidth();
 	double itemHeight = GetItemHeight();
 
-	Colorf textColor = GetStyleColor("color");
-	Colorf selectionColor = GetStyleColor("selection-color");
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
+	Colorf selectionColor = GetStyleColor(StyleProperty::SelectionColor);
 	auto font = GetFont();
 
-	double y = -listview->scrollbar->GetPosition();
+	listview->UpdateScrollRanges();
+	const ListViewModel* model = listview->model.get();
 
-	int itemIndex = 0;
-	for (const std::unique_ptr<ListViewItem>& item : listview->items)
+	// Only the rows in view, and inside the area being painted, are asked for
+	Rect clip = canvas->getClipBox();
+	double scroll = listview->scrollbar->GetPosition();
+	int first = std::max(listview->GetRowAt(scroll + std::max(clip.top(), 0.0)), 0);
+	int last = std::min(listview->GetRowAt(scroll + std::min(clip.bottom(), GetHeight())) + 1, listview->GetViewRowCount());
+	listview->paintedScroll = scroll;
+	int colCount = listview->header->GetColumnCount();
+	double itemY = listview->GetRowTop(first) - scroll;
+	for (int itemIndex = first; itemIndex < last; itemY += itemHeight, itemIndex++)
 	{
-		double itemY = y;
-		if (itemY + itemHeight >= 0.0 && itemY < GetHeight())
+		itemHeight = listview->GetRowHeight(itemIndex);
+		int row = listview->ToModelRow(itemIndex);
+		if (row == listview->selectedItem)
 		{
-			if (itemIndex == listview->selectedItem)
-			{
-				canvas->fillRect(Rect::xywh(x - 2.0, itemY, w, itemHeight), selectionColor);
-			}
-			double cx = x;
-			int colCount = std::min((int)item->columns.size(), listview->header->GetColumnCount());
-			for (int colIndex = 0; colIndex < colCount; ++colIndex)
-			{
-				double colwidth = listview->header->GetColumnWidth(colIndex);
-				if (colIndex + 1 == listview->header->GetColumnCount())
-					colwidth = std::max(w - cx, 0.0);
-				canvas->pushClip(Rect::xywh(cx, itemY, std::max(colwidth - 5.0, 0.0), itemHeight));
-				canvas->drawText(font, Point(cx, y + 15.0), item->columns[colIndex], textColor);
-				canvas->popClip();
-				cx += colwidth;
-			}
+			canvas->fillRect(Rect::xywh(x - 2.0, itemY, w, itemHeight), selectionColor);
+		}
+		double cx = x;
+		for (int colIndex = 0; colIndex < colCount; ++colIndex)
+		{
+			double colwidth = listview->header->GetColumnWidth(colIndex);
+			if (colIndex + 1 == colCount)
+				colwidth = std::max(w - cx, 0.0);
+			Rect box = Rect::xywh(cx, itemY, std::max(colwidth - 5.0, 0.0), itemHeight);
+			canvas->pushClip(box);
+			if (!model->PaintCell(canvas, row, colIndex, box))
+				canvas->drawText(font, Point(cx, itemY + 15.0), model->GetCellText(row, colIndex), textColor);
+			canvas->popClip();
+			cx += colwidth;
 		}
-		y += itemHeight;
-		itemIndex++;
 	}
 }
 
@@ -349,11 +798,12 @@ bool ListViewBody::OnMouseDown(const Point& pos, InputKey key)
 
 	if (key == InputKey::LeftMouse)
 	{
-		int index = (int)((pos.y + listview->scrollbar->GetPosition()) / GetItemHeight());
-		if (index >= 0 && (size_t)index < listview->items.size())
+		int index = listview->GetRowAt(pos.y + listview->scrollbar->GetPosition());
+		if (index >= 0 && index < listview->GetViewRowCount())
 		{
-			listview->ScrollToItem(index);
-			listview->SetSelectedItem(index);
+			int row = listview->ToModelRow(index);
+			listview->ScrollToItem(row);
+			listview->SetSelectedItem(row);
 		}
 	}
 	return true;
@@ -378,6 +828,7 @@ bool ListViewBody::OnMouseWheel(const Point& pos, InputKey key)
 	{
 		listview->scrollbar->SetPosition(std::min(listview->scrollbar->GetPosition() + GetItemHeight(), listview->scrollbar->GetMax()));
 	}
+	listview->ScrollPaintedRows();
 	return true;
 }
 
@@ -410,7 +861,7 @@ void ListViewHeader::SetColumn(int index, const std::string& text, double width)
 
 void ListViewHeader::OnPaint(Canvas* canvas)
 {
-	Colorf textColor = GetStyleColor("color");
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
 	auto font = GetFont();
 	double cx = 0.0;
 	for (size_t idx = 0; idx < columns.size(); idx++)
@@ -424,3 +875,228 @@ double ListViewHeader::GetPreferredHeight()
 {
 	return 20.0;
 }
+
+/////////////////////////////////////////////////////////////////////////////
+
+void ListViewModel::RowsAboutToChange()
+{
+	for (ListView* view : views)
+		view->OnRowsAboutToChange();
+}
+
+void ListViewModel::RowsChanged(int first, int count)
+{
+	for (ListView* view : views)
+		view->OnRowsChanged(first, count);
+}
+
+void ListViewModel::RowsInserted(int first, int count)
+{
+	for (ListView* view : views)
+		view->OnRowsInserted(first, count);
+}
+
+void ListViewModel::RowsRemoved(int first, int count)
+{
+	for (ListView* view : views)
+		view->OnRowsRemoved(first, count);
+}
+
+void ListViewModel::ModelReset()
+{
+	for (ListView* view : views)
+		view->OnModelReset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+double ListViewModel::GetRowHeight(int row) const
+{
+	return ListViewBody::GetItemHeight();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+std::string ListViewItemModel::GetCellText(int row, int column) const
+{
+	const std::vector<std::string>& columns = items[row].columns;
+	return column >= 0 && (size_t)column < columns.size() ? columns[column] : std::string();
+}
+
+void ListViewItemModel::AddItem(ListViewItem item, int index)
+{
+	if (index < 0 || (size_t)index > items.size())
+		index = (int)items.size();
+	RowsAboutToChange();
+	items.insert(items.begin() + index, std::move(item));
+	RowsInserted(index, 1);
+}
+
+void ListViewItemModel::UpdateItem(const std::string& text, int index, int column)
+{
+	if (index < 0 || (size_t)index >= items.size() || column < 0)
+		return;
+
+	RowsAboutToChange();
+	ListViewItem& item = items[index];
+	item.columns.resize(std::max((size_t)column + 1, item.columns.size()));
+	item.columns[column] = text;
+	RowsChanged(index, 1);
+}
+
+double ListViewItemModel::GetRowHeight(int row) const
+{
+	return items[row].height > 0.0 ? items[row].height : ListViewModel::GetRowHeight(row);
+}
+
+void ListViewItemModel::SetItemHeight(int index, double height)
+{
+	if (index < 0 || (size_t)index >= items.size())
+		return;
+
+	RowsAboutToChange();
+	items[index].height = height;
+	RowsChanged(index, 1);
+}
+
+void ListViewItemModel::RemoveItem(int index)
+{
+	if (index < 0 || (size_t)index >= items.size())
+		return;
+
+	RowsAboutToChange();
+	items.erase(items.begin() + index);
+	RowsRemoved(index, 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+ListViewSorter::~ListViewSorter()
+{
+	Stop();
+}
+
+void ListViewSorter::Start(std::shared_ptr<ListViewModel> model, const Options& options)
+{
+	Stop();
+
+	int rowCount = model->GetRowCount();
+	worker = std::thread([this, model = std::move(model), rowCount, options]()
+	{
+		std::vector<int> rows;
+		bool completed = Arrange(model.get(), rowCount, options, stopFlag, [this](double value)
+		{
+			std::unique_lock lock(mutex);
+			progress = value;
+		}, rows);
+
+		std::unique_lock lock(mutex);
+		if (completed)
+		{
+			result = std::move(rows);
+			progress = 1.0;
+			finished = true;
+		}
+	});
+}
+
+void ListViewSorter::Stop()
+{
+	if (worker.joinable())
+	{
+		stopFlag = true;
+		worker.join();
+		stopFlag = false;
+	}
+
+	result.clear();
+	progress = 0.0;
+	finished = false;
+}
+
+bool ListViewSorter::Poll(double& outProgress, std::vector<int>& rows)
+{
+	{
+		std::unique_lock lock(mutex);
+		outProgress = progress;
+		if (!finished)
+			return false;
+		rows = std::move(result);
+	}
+	Stop();
+	return true;
+}
+
+bool ListViewSorter::Arrange(const ListViewModel* model, int rowCount, const Options& options, const std::atomic<bool>& stop, const std::function<void(double)>& onProgress, std::vector<int>& rows)
+{
+	// Filtering and fetching the sort keys count as the first half of the work, sorting as the second half
+	const int step = 4096;
+	rows.clear();
+	for (int row = 0; row < rowCount; row++)
+	{
+		if (row % step == 0)
+		{
+			if (stop)
+				return false;
+			onProgress(0.25 * row / rowCount);
+		}
+		if (!options.filter || options.filter(row))
+			rows.push_back(row);
+	}
+
+	if (options.column < 0 || rows.size() < 2)
+		return true;
+
+	size_t count = rows.size();
+	std::vector<std::string> keys(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (i % step == 0)
+		{
+			if (stop)
+				return false;
+			onProgress(0.25 + 0.25 * i / count);
+		}
+		keys[i] = model->GetCellText(rows[i], options.column);
+	}
+
+	auto less = options.less ? options.less : [](const std::string& a, const std::string& b) { return a < b; };
+	auto compare = [&](int a, int b) { return options.ascending ? less(keys[a], keys[b]) : less(keys[b], keys[a]); };
+
+	// Sort blocks and then merge them, so that a stop request is noticed between the steps. Rows with equal keys keep the model order.
+	const size_t blockSize = 16384;
+	size_t passes = 1;
+	for (size_t width = blockSize; width < count; width *= 2)
+		passes++;
+
+	std::vector<int> order(count);
+	std::iota(order.begin(), order.end(), 0);
+	for (size_t start = 0; start < count; start += blockSize)
+	{
+		if (stop)
+			return false;
+		std::stable_sort(order.begin() + start, order.begin() + std::min(start + blockSize, count), compare);
+	}
+	onProgress(0.5 + 0.5 / passes);
+
+	std::vector<int> merged(count);
+	size_t pass = 1;
+	for (size_t width = blockSize; width < count; width *= 2)
+	{
+		for (size_t start = 0; start < count; start += width * 2)
+		{
+			if (stop)
+				return false;
+			size_t middle = std::min(start + width, count);
+			size_t end = std::min(start + width * 2, count);
+			std::merge(order.begin() + start, order.begin() + middle, order.begin() + middle, order.begin() + end, merged.begin() + start, compare);
+		}
+		order.swap(merged);
+		onProgress(0.5 + 0.5 * ++pass / passes);
+	}
+
+	for (size_t i = 0; i < count; i++)
+		merged[i] = rows[order[i]];
+	rows.swap(merged);
+	return true;
+}
@@ -0,0 +1,411 @@
+
+#include "widgets/logview/logview.h"
+#include "widgets/scrollbar/scrollbar.h"
+#include <algorithm>
+#include <cmath>
+
+LogView::LogView(Widget* parent) : Widget(parent)
+{
+	SetStyleClass("logview");
+
+	severity_colors[(int)LogSeverity::Debug] = Colorf::fromRgba8(128, 128, 128);
+	severity_colors[(int)LogSeverity::Info] = GetStyleColor(StyleProperty::Color);
+	severity_colors[(int)LogSeverity::Warning] = Colorf::fromRgba8(230, 190, 80);
+	severity_colors[(int)LogSeverity::Error] = Colorf::fromRgba8(240, 90, 90);
+
+	vert_scrollbar = new Scrollbar(this);
+	vert_scrollbar->FuncScroll = [this]() { OnVerticalScroll(); };
+	vert_scrollbar->SetVisible(false);
+	vert_scrollbar->SetVertical();
+
+	// Lines added since the last frame are moved into the view in one go, so a burst of lines only repaints once.
+	// The timer only runs once per frame while lines are arriving.
+	ui_thread = std::this_thread::get_id();
+	flush_timer = new Timer(this);
+	flush_timer->FuncExpired = [this]() { OnFlushTimerExpired(); };
+	flush_timer->Start(IdleInterval, true);
+}
+
+LogView::~LogView()
+{
+}
+
+void LogView::AddText(const std::string& text, LogSeverity severity)
+{
+	std::unique_lock lock(pending_mutex);
+	size_t start = 0;
+	while (true)
+	{
+		size_t end = text.find('\n', start);
+		if (end == std::string::npos)
+		{
+			partial_line.append(text, start);
+			break;
+		}
+
+		if (!partial_line.empty())
+		{
+			partial_line.append(text, start, end - start);
+			QueueLine(partial_line.data(), partial_line.size(), severity, false, 0);
+			partial_line.clear();
+		}
+		else
+		{
+			QueueLine(text.data() + start, end - start, severity, false, 0);
+		}
+		start = end + 1;
+	}
+}
+
+void LogView::AddLine(const std::string& text, LogSeverity severity)
+{
+	std::unique_lock lock(pending_mutex);
+	QueueLine(text.data(), text.size(), severity, false, 0);
+}
+
+void LogView::AddLine(const std::string& text, const Colorf& color)
+{
+	std::unique_lock lock(pending_mutex);
+	QueueLine(text.data(), text.size(), LogSeverity::Info, true, color.toBgra8());
+}
+
+void LogView::QueueLine(const char* text, size_t length, LogSeverity severity, bool customColor, uint32_t color)
+{
+	if (length > 0 && text[length - 1] == '\r')
+		length--;
+
+	if (std::this_thread::get_id() == ui_thread && !flushing && pending_lines.empty())
+	{
+		flush_timer->Start(FlushInterval, true);
+		flushing = true;
+	}
+
+	Line line;
+	line.offset = pending_text.size();
+	line.length = (uint32_t)std::min(length, (size_t)UINT32_MAX);
+	line.severity = severity;
+	line.custom_color = customColor;
+	line.color = color;
+	pending_lines.push_back(line);
+	pending_text.append(text, line.length);
+}
+
+void LogView::Clear()
+{
+	{
+		std::unique_lock lock(pending_mutex);
+		pending_text.clear();
+		pending_lines.clear();
+		partial_line.clear();
+	}
+
+	write_pos = 0;
+	first_line = 0;
+	line_count = 0;
+	follow_tail = true;
+	UpdateScrollbar();
+	Update();
+}
+
+void LogView::SetLimits(size_t maxLines, size_t maxBytes)
+{
+	maxLines = std::max(maxLines, (size_t)1);
+	maxBytes = std::max(maxBytes, (size_t)2);
+	if (maxLines == max_lines && maxBytes == max_bytes)
+		return;
+
+	// Add the lines again so that the ring and the arena are laid out for the new limits
+	std::vector<char> oldArena;
+	std::vector<Line> oldLines;
+	oldArena.swap(arena);
+	oldLines.reserve(line_count);
+	for (size_t i = 0; i < line_count; i++)
+		oldLines.push_back(GetLine(i));
+
+	max_lines = maxLines;
+	max_bytes = maxBytes;
+	lines.clear();
+	write_pos = 0;
+	first_line = 0;
+	line_count = 0;
+	for (const Line& line : oldLines)
+		Append(oldArena.data() + line.offset, line.length, line);
+
+	UpdateScrollbar();
+	if (follow_tail)
+		ScrollTo(vert_scrollbar->GetMax());
+	Update();
+}
+
+void LogView::SetSeverityColor(LogSeverity severity, const Colorf& color)
+{
+	severity_colors[(int)severity] = color;
+	Update();
+}
+
+void LogView::SetFollowTail(bool enable)
+{
+	follow_tail = enable;
+	if (follow_tail)
+		ScrollTo(vert_scrollbar->GetMax());
+}
+
+std::string LogView::GetLineText(size_t index) const
+{
+	const Line& line = GetLine(index);
+	return std::string(arena.data() + line.offset, line.length);
+}
+
+LogSeverity LogView::GetLineSeverity(size_t index) const
+{
+	return GetLine(index).severity;
+}
+
+void LogView::OnFlushTimerExpired()
+{
+	std::string text;
+	std::vector<Line> added;
+	{
+		std::unique_lock lock(pending_mutex);
+		if (pending_lines.empty())
+		{
+			if (flushing)
+			{
+				flush_timer->Start(IdleInterval, true);
+				flushing = false;
+			}
+			return;
+		}
+		if (!flushing)
+		{
+			flush_timer->Start(FlushInterval, true);
+			flushing = true;
+		}
+		text.swap(pending_text);
+		added.swap(pending_lines);
+	}
+
+	size_t countBefore = line_count;
+	size_t endBefore = lines_removed + line_count;
+	for (const Line& line : added)
+		Append(text.data() + line.offset, line.length, line);
+	size_t removed = countBefore + added.size() - line_count;
+
+	double position = vert_scrollbar->GetPosition();
+	UpdateScrollbar();
+	if (follow_tail)
+		vert_scrollbar->SetPosition(vert_scrollbar->GetMax());
+	else
+		vert_scrollbar->SetPosition(std::max(position - (double)removed, 0.0));
+	ScrollPaintedLines();
+
+	// The added lines are only painted where the view was empty below the old last line
+	double y = std::max(((double)endBefore - painted_top) * GetLineHeight(), 0.0);
+	if (y < GetHeight())
+		Update(Rect::xywh(0.0, y, GetTextWidth(), GetHeight() - y));
+}
+
+void LogView::Append(const char* text, size_t length, const Line& info)
+{
+	// A line must fit in the arena together with its terminator
+	if (length > max_bytes - 1)
+	{
+		length = max_bytes - 1;
+		while (length > 0 && (text[length] & 0xc0) == 0x80)
+			length--;
+	}
+	size_t needed = length + 1;
+
+	if (line_count == max_lines)
+		RemoveFirstLine();
+
+	if (write_pos + needed > arena.size())
+	{
+		if (arena.size() < max_bytes)
+		{
+			size_t size = std::max(arena.size() * 2, (size_t)65536);
+			while (size < write_pos + needed)
+				size *= 2;
+			arena.resize(std::min(size, max_bytes));
+		}
+
+		if (write_pos + needed > arena.size())
+		{
+			// Wrap around. The lines at the end of the arena are the oldest ones.
+			while (line_count > 0 && GetLine(0).offset >= write_pos)
+				RemoveFirstLine();
+			write_pos = 0;
+		}
+	}
+
+	// Drop the oldest lines where the new line is written
+	while (line_count > 0 && GetLine(0).offset >= write_pos && GetLine(0).offset < write_pos + needed)
+		RemoveFirstLine();
+
+	if (line_count == lines.size())
+	{
+		std::rotate(lines.begin(), lines.begin() + first_line, lines.end());
+		first_line = 0;
+		lines.resize(std::min(std::max(lines.size() * 2, (size_t)1024), max_lines));
+	}
+
+	Line& line = lines[(first_line + line_count) % lines.size()];
+	line = info;
+	line.offset = write_pos;
+	line.length = (uint32_t)length;
+	std::copy(text, text + length, arena.data() + write_pos);
+	arena[write_pos + length] = '\n';
+	write_pos += needed;
+	line_count++;
+}
+
+void LogView::RemoveFirstLine()
+{
+	first_line = (first_line + 1) % lines.size();
+	line_count--;
+	lines_removed++;
+	if (line_count == 0)
+	{
+		first_line = 0;
+		write_pos = 0;
+	}
+}
+
+Colorf LogView::GetLineColor(const Line& line)
+{
+	if (line.custom_color)
+		return Colorf::fromRgba8((line.color >> 16) & 0xff, (line.color >> 8) & 0xff, line.color & 0xff, line.color >> 24);
+	return severity_colors[(int)line.severity];
+}
+
+double LogView::GetLineHeight() const
+{
+	// Lines start on whole pixels, so that scrolling by lines can move the pixels already painted
+	return GridFitSize(std::max(vertical_text_align.bottom - vertical_text_align.top, 1.0));
+}
+
+void LogView::UpdateScrollbar()
+{
+	double visibleLines = std::floor(GetHeight() / GetLineHeight());
+	vert_scrollbar->SetRanges(visibleLines, (double)line_count);
+	vert_scrollbar->SetLineStep(1);
+	vert_scrollbar->SetVisible(line_count > visibleLines);
+}
+
+void LogView::ScrollTo(double position)
+{
+	vert_scrollbar->SetPosition(position);
+	follow_tail = vert_scrollbar->GetPosition() >= vert_scrollbar->GetMax() - 1.0;
+	ScrollPaintedLines();
+}
+
+void LogView::ScrollPaintedLines()
+{
+	double top = vert_scrollbar->GetPosition() + (double)lines_removed;
+	if (top != painted_top)
+	{
+		ScrollRect(Rect::xywh(0.0, 0.0, GetTextWidth(), GetHeight()), 0.0, (painted_top - top) * GetLineHeight());
+		painted_top = top;
+	}
+}
+
+void LogView::OnVerticalScroll()
+{
+	follow_tail = vert_scrollbar->GetPosition() >= vert_scrollbar->GetMax() - 1.0;
+	ScrollPaintedLines();
+}
+
+double LogView::GetTextWidth()
+{
+	// The scrollbar is painted on top of the end of the lines
+	return vert_scrollbar->IsVisible() ? std::max(GetWidth() - 16.0, 0.0) : GetWidth();
+}
+
+void LogView::OnPaint(Canvas* canvas)
+{
+	auto font = GetFont();
+	double lineHeight = GetLineHeight();
+
+	// Only the lines inside the area being painted are drawn
+	Rect clip = canvas->getClipBox();
+	size_t first = (size_t)vert_scrollbar->GetPosition();
+	size_t skipped = (size_t)std::max(std::floor(clip.top() / lineHeight), 0.0);
+	double bottom = std::min(GetHeight(), clip.bottom());
+	painted_top = first + (double)lines_removed;
+
+	std::string text;
+	double y = skipped * lineHeight;
+	for (size_t i = first + skipped; i < line_count && y < bottom; i++, y += lineHeight)
+	{
+		// Very long lines are cut off well past the edge of the view instead of being shaped in full
+		const Line& line = GetLine(i);
+		size_t length = line.length;
+		if (length > MaxDrawnBytes)
+		{
+			length = MaxDrawnBytes;
+			while (length > 0 && (arena[line.offset + length] & 0xc0) == 0x80)
+				length--;
+		}
+		// Most lines are only painted once as they scroll past, so they stay out of the shared text run cache
+		text.assign(arena.data() + line.offset, length);
+		canvas->drawText(*canvas->shapeTextUncached(font, text), Point(0.0, y + vertical_text_align.baseline), GetLineColor(line));
+	}
+}
+
+bool LogView::OnMouseDown(const Point& pos, InputKey key)
+{
+	SetFocus();
+	return true;
+}
+
+bool LogView::OnMouseWheel(const Point& pos, InputKey key)
+{
+	if (key == InputKey::MouseWheelUp)
+	{
+		ScrollTo(vert_scrollbar->GetPosition() - 3);
+	}
+	else if (key == InputKey::MouseWheelDown)
+	{
+		ScrollTo(vert_scrollbar->GetPosition() + 3);
+	}
+	return true;
+}
+
+void LogView::OnKeyDown(InputKey key)
+{
+	double pageSize = std::max(std::floor(GetHeight() / GetLineHeight()) - 1.0, 1.0);
+	if (key == InputKey::Up)
+	{
+		ScrollTo(vert_scrollbar->GetPosition() - 1);
+	}
+	else if (key == InputKey::Down)
+	{
+		ScrollTo(vert_scrollbar->GetPosition() + 1);
+	}
+	else if (key == InputKey::PageUp)
+	{
+		ScrollTo(vert_scrollbar->GetPosition() - pageSize);
+	}
+	else if (key == InputKey::PageDown)
+	{
+		ScrollTo(vert_scrollbar->GetPosition() + pageSize);
+	}
+	else if (key == InputKey::Home)
+	{
+		ScrollTo(0.0);
+	}
+	else if (key == InputKey::End)
+	{
+		ScrollTo(vert_scrollbar->GetMax());
+	}
+}
+
+void LogView::OnGeometryChanged()
+{
+	vertical_text_align = GetCanvas()->verticalTextAlign(GetFont());
+	vert_scrollbar->SetFrameGeometry(Rect::xywh(GetWidth() - 16.0, 0.0, 16.0, GetHeight()));
+	UpdateScrollbar();
+	if (follow_tail)
+		vert_scrollbar->SetPosition(vert_scrollbar->GetMax());
+	Update();
+}
@@ -35,8 +35,12 @@ void Menubar::ShowMenu(MenubarItem* item)
 	modalMode = true;
 	if (item->GetOpenCallback())
 	{
-		openMenu = new Menu(this);
-		openMenu->onCloseMenu = [this]() { CloseMenu(); };
+		if (!menuPopup)
+		{
+			menuPopup = new Menu(this);
+			menuPopup->onCloseMenu = [this]() { CloseMenu(); };
+		}
+		openMenu = menuPopup;
 		item->GetOpenCallback()(openMenu);
 		if (item->AlignRight)
 			openMenu->SetRightPosition(item->MapToGlobal(Point(item->GetWidth(), item->GetHeight())));
@@ -51,8 +55,12 @@ void Menubar::CloseMenu()
 	if (currentMenubarItem != -1)
 		menuItems[currentMenubarItem]->SetStyleState("");
 	currentMenubarItem = -1;
-	delete openMenu;
-	openMenu = nullptr;
+	if (openMenu)
+	{
+		openMenu->Hide();
+		openMenu->Clear();
+		openMenu = nullptr;
+	}
 	ReleaseModalCapture();
 	modalMode = false;
 }
@@ -253,7 +261,7 @@ double MenubarItem::GetPreferredWidth()
 void MenubarItem::OnPaint(Canvas* canvas)
 {
 	double x = (GetWidth() - canvas->measureText(GetFont(), text).width) * 0.5;
-	canvas->drawText(GetFont(), Point(x, 21.0), text, GetStyleColor("color"));
+	canvas->drawText(GetFont(), Point(x, 21.0), text, GetStyleColor(StyleProperty::Color));
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -266,11 +274,16 @@ Menu::Menu(Widget* parent) : Widget(parent, WidgetType::Popup)
 void Menu::SetLeftPosition(const Point& pos)
 {
 	SetFrameGeometry(Rect::xywh(pos.x, pos.y, GetPreferredWidth() + GetNoncontentLeft() + GetNoncontentRight(), GetPreferredHeight() + GetNoncontentTop() + GetNoncontentBottom()));
+
+	// The window may keep its size when the menu is opened again with new items
+	OnGeometryChanged();
 }
 
 void Menu::SetRightPosition(const Point& pos)
 {
-	SetFrameGeometry(Rect::xywh(pos.x - GetWidth() - GetNoncontentLeft() - GetNoncontentRight(), pos.y, GetWidth() + GetNoncontentLeft() + GetNoncontentRight(), GetHeight() + GetNoncontentTop() + GetNoncontentBottom()));
+	double w = GetPreferredWidth() + GetNoncontentLeft() + GetNoncontentRight();
+	SetFrameGeometry(Rect::xywh(pos.x - w, pos.y, w, GetPreferredHeight() + GetNoncontentTop() + GetNoncontentBottom()));
+	OnGeometryChanged();
 }
 
 MenuItem* Menu::AddItem(std::shared_ptr<Image> icon, std::string text, std::function<void()> onClick)
@@ -288,6 +301,13 @@ MenuItemSeparator* Menu::AddSeparator()
 	return sep;
 }
 
+void Menu::Clear()
+{
+	SetSelected(nullptr);
+	while (LastChild())
+		delete LastChild();
+}
+
 double Menu::GetPreferredWidth()
 {
 	return GridFitSize(200.0);
@@ -36,7 +36,7 @@ void PushButton::OnPaint(Canvas* canvas)
 {
 	FontMetrics metrics = canvas->getFontMetrics(GetFont());
 	Rect box = canvas->measureText(GetFont(), text);
-	canvas->drawText(GetFont(), Point((GetWidth() - box.width) * 0.5, (GetHeight() - metrics.height) * 0.5 + metrics.ascent), text, GetStyleColor("color"));
+	canvas->drawText(GetFont(), Point((GetWidth() - box.width) * 0.5, (GetHeight() - metrics.height) * 0.5 + metrics.ascent), text, GetStyleColor(StyleProperty::Color));
 }
 
 void PushButton::OnMouseMove(const Point& pos)
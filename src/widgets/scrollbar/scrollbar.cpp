@@ -58,14 +58,14 @@ void Scrollbar::SetVertical()
 {
 	vertical = true;
 	if (UpdatePartPositions())
-		Update();
+		UpdateBar();
 }
 
 void Scrollbar::SetHorizontal()
 {
 	vertical = false;
 	if (UpdatePartPositions())
-		Update();
+		UpdateBar();
 }
 
 void Scrollbar::SetMin(double new_scroll_min)
@@ -101,7 +101,7 @@ void Scrollbar::SetRanges(double new_scroll_min, double new_scroll_max, double n
 	if (position < scroll_min)
 		position = scroll_min;
 	if (UpdatePartPositions())
-		Update();
+		UpdateBar();
 }
 
 void Scrollbar::SetRanges(double view_size, double total_size)
@@ -127,7 +127,7 @@ void Scrollbar::SetPosition(double pos)
 		position = scroll_min;
 
 	if (UpdatePartPositions())
-		Update();
+		UpdateBar();
 }
 
 void Scrollbar::OnMouseMove(const Point& pos)
@@ -170,7 +170,7 @@ void Scrollbar::OnMouseMove(const Point& pos)
 		}
 	}
 
-	Update();
+	UpdateBar();
 }
 
 bool Scrollbar::OnMouseDown(const Point& pos, InputKey key)
@@ -256,7 +256,7 @@ bool Scrollbar::OnMouseDown(const Point& pos, InputKey key)
 
 	UpdatePartPositions();
 
-	Update();
+	UpdateBar();
 	SetPointerCapture();
 	return true;
 }
@@ -272,14 +272,14 @@ bool Scrollbar::OnMouseUp(const Point& pos, InputKey key)
 	mouse_down_mode = mouse_down_none;
 	mouse_down_timer->Stop();
 
-	Update();
+	UpdateBar();
 	ReleasePointerCapture();
 	return true;
 }
 
 void Scrollbar::OnMouseLeave()
 {
-	Update();
+	UpdateBar();
 }
 
 void Scrollbar::OnGeometryChanged()
@@ -303,11 +303,11 @@ void Scrollbar::OnPaint(Canvas* canvas)
 
 	if (HIDE_SMALL_BAR && !paint) return;
 
-	canvas->fillRect(Rect::shrink(Rect::xywh(0.0, 0.0, GetWidth(), height), 4.0, 0.0, 4.0, 0.0), GetStyleColor("track-color"));
+	canvas->fillRect(Rect::shrink(Rect::xywh(0.0, 0.0, GetWidth(), height), 4.0, 0.0, 4.0, 0.0), GetStyleColor(StyleProperty::TrackColor));
 
 	if (HIDE_SMALL_THUMB && !paint) return;
 
-	canvas->fillRect(Rect::shrink(rect_thumb, 4.0, 0.0, 4.0, 0.0), GetStyleColor("thumb-color"));
+	canvas->fillRect(Rect::shrink(rect_thumb, 4.0, 0.0, 4.0, 0.0), GetStyleColor(StyleProperty::ThumbColor));
 }
 
 // Calculates positions of all parts. Returns true if thumb position was changed compared to previously, false otherwise.
@@ -389,13 +389,19 @@ void Scrollbar::OnTimerExpired()
 		InvokeScrollEvent(FuncScrollOnMouseDown);
 
 		if (UpdatePartPositions())
-			Update();
+			UpdateBar();
 	}
 }
 
 void Scrollbar::OnEnableChanged()
 {
-	Update();
+	UpdateBar();
+}
+
+// Only the scrollbar itself changes when its ranges or position change. The widget it scrolls repaints itself.
+void Scrollbar::UpdateBar()
+{
+	Update(Rect::xywh(-GetNoncontentLeft(), -GetNoncontentTop(), GetFrameGeometry().width, GetFrameGeometry().height));
 }
 
 void Scrollbar::InvokeScrollEvent(std::function<void()>* event_ptr)
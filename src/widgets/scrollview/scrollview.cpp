@@ -0,0 +1,229 @@
+
+#include "widgets/scrollview/scrollview.h"
+#include "widgets/scrollbar/scrollbar.h"
+#include <algorithm>
+#include <cmath>
+
+ScrollView::ScrollView(Widget* parent) : Widget(parent)
+{
+	SetStretching(true);
+
+	viewport = new Widget(this);
+
+	scrollbar = new Scrollbar(this);
+	scrollbar->SetVertical();
+	scrollbar->FuncScroll = [this]() { OnScrollbarScroll(); };
+}
+
+void ScrollView::SetContent(Widget* newContent)
+{
+	ClearRows();
+	createRow = {};
+	bindRow = {};
+	rowCount = 0;
+
+	if (content != newContent)
+	{
+		delete content;
+		content = newContent;
+		if (content)
+			content->SetParent(viewport);
+	}
+	scrollbar->SetPosition(0.0);
+	UpdateScrollRanges();
+	LayoutContent();
+	Update();
+}
+
+void ScrollView::SetRows(int count, double height, std::function<Widget*(Widget* parent)> create, std::function<void(Widget* widget, int row)> bind)
+{
+	delete content;
+	content = nullptr;
+	ClearRows();
+
+	rowCount = std::max(count, 0);
+	rowHeight = std::max(height, 1.0);
+	createRow = std::move(create);
+	bindRow = std::move(bind);
+	scrollbar->SetPosition(0.0);
+	UpdateScrollRanges();
+	LayoutContent();
+	Update();
+}
+
+void ScrollView::UpdateContentHeight()
+{
+	UpdateScrollRanges();
+	LayoutContent();
+	Update();
+}
+
+void ScrollView::SetRowCount(int count)
+{
+	rowCount = std::max(count, 0);
+	RebindRows();
+}
+
+void ScrollView::RebindRows()
+{
+	std::fill(boundRows.begin(), boundRows.end(), -1);
+	UpdateScrollRanges();
+	LayoutContent();
+	Update();
+}
+
+Widget* ScrollView::GetRowWidget(int row) const
+{
+	if (rowWidgets.empty() || row < 0)
+		return nullptr;
+	size_t index = row % rowWidgets.size();
+	return boundRows[index] == row ? rowWidgets[index] : nullptr;
+}
+
+double ScrollView::GetScrollPosition() const
+{
+	return scrollbar->GetPosition();
+}
+
+void ScrollView::SetScrollPosition(double position)
+{
+	scrollbar->SetPosition(position);
+	LayoutContent();
+}
+
+void ScrollView::ScrollToRow(int row)
+{
+	double top = row * rowHeight;
+	double viewHeight = viewport->GetHeight();
+	if (top < scrollbar->GetPosition())
+		scrollbar->SetPosition(top);
+	else if (top + rowHeight > scrollbar->GetPosition() + viewHeight)
+		scrollbar->SetPosition(std::max(top + rowHeight - viewHeight, 0.0));
+	LayoutContent();
+}
+
+void ScrollView::ClearRows()
+{
+	for (Widget* widget : rowWidgets)
+		delete widget;
+	rowWidgets.clear();
+	boundRows.clear();
+}
+
+void ScrollView::UpdateScrollRanges()
+{
+	// Measuring the content lays out all its children, so it is only done when the content or the view changes and not when scrolling
+	contentHeight = content ? content->GetPreferredHeight() + content->GetNoncontentTop() + content->GetNoncontentBottom() : 0.0;
+	scrollbar->SetRanges(viewport->GetHeight(), content ? contentHeight : rowCount * rowHeight);
+}
+
+void ScrollView::LayoutContent()
+{
+	double scroll = scrollbar->GetPosition();
+	double width = viewport->GetWidth();
+	double viewHeight = viewport->GetHeight();
+
+	if (content)
+	{
+		PlaceWidget(content, Rect::xywh(0.0, -scroll, width, std::max(contentHeight, viewHeight)));
+		ScrollPaintedContent();
+		return;
+	}
+
+	if (!createRow)
+		return;
+
+	// Enough widgets to cover the view when it is scrolled to show part of a row at the top and the bottom
+	size_t needed = (size_t)std::ceil(viewHeight / rowHeight) + 1;
+	needed = std::min(needed, (size_t)rowCount);
+	if (needed > rowWidgets.size())
+	{
+		while (rowWidgets.size() < needed)
+		{
+			Widget* widget = createRow(viewport);
+			widget->SetParent(viewport);
+			rowWidgets.push_back(widget);
+		}
+
+		// Rows map to other widgets when the pool grows
+		boundRows.assign(rowWidgets.size(), -1);
+	}
+
+	int first = std::max((int)std::floor(scroll / rowHeight), 0);
+	int last = std::min(first + (int)rowWidgets.size(), rowCount);
+	std::vector<bool> used(rowWidgets.size(), false);
+	for (int row = first; row < last; row++)
+	{
+		size_t index = row % rowWidgets.size();
+		Widget* widget = rowWidgets[index];
+		if (boundRows[index] != row)
+		{
+			bindRow(widget, row);
+			boundRows[index] = row;
+		}
+		PlaceWidget(widget, Rect::xywh(0.0, row * rowHeight - scroll, width, rowHeight));
+		widget->Show();
+		used[index] = true;
+	}
+
+	for (size_t i = 0; i < rowWidgets.size(); i++)
+	{
+		if (!used[i])
+		{
+			rowWidgets[i]->Hide();
+			boundRows[i] = -1;
+		}
+	}
+	ScrollPaintedContent();
+}
+
+void ScrollView::PlaceWidget(Widget* widget, const Rect& box)
+{
+	// Scrolling only moves the widgets, without laying them out again or telling them their geometry changed
+	Rect frame = widget->GetFrameGeometry();
+	if (frame.width == box.width && frame.height == box.height)
+		widget->SetFramePosition(box.pos());
+	else
+		widget->SetFrameGeometry(box);
+}
+
+void ScrollView::ScrollPaintedContent()
+{
+	// Rows bound to new data repaint themselves, everything else only moves
+	double scroll = scrollbar->GetPosition();
+	if (scroll != paintedScroll)
+	{
+		viewport->ScrollRect(Rect::xywh(0.0, 0.0, viewport->GetWidth(), viewport->GetHeight()), 0.0, paintedScroll - scroll);
+		paintedScroll = scroll;
+	}
+}
+
+void ScrollView::OnScrollbarScroll()
+{
+	LayoutContent();
+}
+
+bool ScrollView::OnMouseWheel(const Point& pos, InputKey key)
+{
+	double step = content ? 20.0 : rowHeight;
+	if (key == InputKey::MouseWheelUp)
+	{
+		scrollbar->SetPosition(std::max(scrollbar->GetPosition() - step, 0.0));
+	}
+	else if (key == InputKey::MouseWheelDown)
+	{
+		scrollbar->SetPosition(std::min(scrollbar->GetPosition() + step, scrollbar->GetMax()));
+	}
+	LayoutContent();
+	return true;
+}
+
+void ScrollView::OnGeometryChanged()
+{
+	double sw = scrollbar->GetPreferredWidth();
+	viewport->SetFrameGeometry(Rect::xywh(0.0, 0.0, std::max(GetWidth() - sw, 0.0), GetHeight()));
+	scrollbar->SetFrameGeometry(Rect::xywh(GetWidth() - sw, 0.0, sw, GetHeight()));
+	UpdateScrollRanges();
+	LayoutContent();
+	Update();
+}
@@ -206,8 +206,8 @@ void TabBar::OnGeometryChanged()
 	double h = GetHeight();
 	double x = 0.0;
 
-	leftSpacer->SetFrameGeometry(Rect::xywh(x, 0.0, GetStyleDouble("spacer-left"), h));
-	x += GetStyleDouble("spacer-left");
+	leftSpacer->SetFrameGeometry(Rect::xywh(x, 0.0, GetStyleDouble(StyleProperty::SpacerLeft), h));
+	x += GetStyleDouble(StyleProperty::SpacerLeft);
 
 	for (TabBarTab* tab : Tabs)
 	{
@@ -13,8 +13,8 @@ TextEdit::TextEdit(Widget* parent) : Widget(parent)
 {
 	SetStyleClass("textedit");
 
-	selectionBG = GetStyleColor("selection-color");
-	selectionFG = GetStyleColor("color");
+	selectionBG = GetStyleColor(StyleProperty::SelectionColor);
+	selectionFG = GetStyleColor(StyleProperty::Color);
 
 	timer = new Timer(this);
 	timer->FuncExpired = [this]() { OnTimerExpired(); };
@@ -22,6 +22,9 @@ TextEdit::TextEdit(Widget* parent) : Widget(parent)
 	scroll_timer = new Timer(this);
 	scroll_timer->FuncExpired = [this]() { OnScrollTimerExpired(); };
 
+	search_timer = new Timer(this);
+	search_timer->FuncExpired = [this]() { OnSearchTimerExpired(); };
+
 	SetCursor(StandardCursor::ibeam);
 
 	CreateComponents();
@@ -46,6 +49,11 @@ bool TextEdit::IsUppercase() const
 	return uppercase;
 }
 
+bool TextEdit::IsWordWrap() const
+{
+	return word_wrap;
+}
+
 int TextEdit::GetMaxLength() const
 {
 	return max_length;
@@ -53,42 +61,33 @@ int TextEdit::GetMaxLength() const
 
 std::string TextEdit::GetLineText(int line) const
 {
-	if (line >= 0 && line < (int)lines.size())
-		return lines[line].text;
+	if (line >= 0 && line < GetLineCount())
+		return document.GetLineText(line);
 	else
 		return std::string();
 }
 
 std::string TextEdit::GetText() const
 {
-	std::string::size_type size = 0;
-	for (size_t i = 0; i < lines.size(); i++)
-		size += lines[i].text.size();
-	size += lines.size() - 1;
-
-	std::string text;
-	text.reserve(size);
-
-	for (size_t i = 0; i < lines.size(); i++)
-	{
-		if (i > 0)
-			text.push_back('\n');
-		text += lines[i].text;
-	}
+	return document.GetText();
+}
 
-	return text;
+std::string TextEdit::GetText(size_t offset, size_t length) const
+{
+	offset = std::min(offset, document.GetSize());
+	return document.GetText(offset, std::min(length, document.GetSize() - offset));
 }
 
 int TextEdit::GetLineCount() const
 {
-	return (int)lines.size();
+	return (int)document.GetLineCount();
 }
 
 std::string TextEdit::GetSelection() const
 {
 	std::string::size_type offset = ToOffset(selection_start);
 	int start = (int)std::min(offset, offset + selection_length);
-	return GetText().substr(start, abs(selection_length));
+	return document.GetText(start, abs(selection_length));
 }
 
 int TextEdit::GetSelectionStart() const
@@ -113,11 +112,7 @@ int TextEdit::GetCursorLineNumber() const
 
 void TextEdit::SelectAll()
 {
-	std::string::size_type size = 0;
-	for (size_t i = 0; i < lines.size(); i++)
-		size += lines[i].text.size();
-	size += lines.size() - 1;
-	SetSelection(0, (int)size);
+	SetSelection(0, (int)document.GetSize());
 }
 
 void TextEdit::SetReadOnly(bool enable)
@@ -147,17 +142,29 @@ void TextEdit::SetUppercase(bool enable)
 	}
 }
 
+void TextEdit::SetWordWrap(bool enable)
+{
+	if (word_wrap != enable)
+	{
+		word_wrap = enable;
+		lines.clear();
+		line_heights.assign(document.GetLineCount(), 0.0);
+		measured_height = 0.0;
+		measured_lines = 0;
+		max_line_width = 0.0;
+		scroll_x = 0.0;
+		scrolled_cursor_pos = ivec2(-1, -1);
+		Update();
+	}
+}
+
 void TextEdit::SetMaxLength(int length)
 {
 	if (max_length != length)
 	{
 		max_length = length;
 
-		std::string::size_type size = 0;
-		for (size_t i = 0; i < lines.size(); i++)
-			size += lines[i].text.size();
-		size += lines.size() - 1;
-
+		std::string::size_type size = document.GetSize();
 		if ((int)size > length)
 		{
 			if (FuncBeforeEditChanged)
@@ -173,20 +180,25 @@ void TextEdit::SetMaxLength(int length)
 
 void TextEdit::SetText(const std::string& text)
 {
+	SetText(TextBuffer::Create(text));
+}
+
+void TextEdit::SetText(std::shared_ptr<TextBuffer> buffer)
+{
+	size_t old_size = document.GetSize();
+	int old_last = GetLineCount() - 1;
+	document.Clear();
+	document.Append(std::move(buffer));
+	if (FuncTextChanged)
+		NotifyTextChanged(0, old_size, document.GetSize(), 0, old_last, GetLineCount() - 1);
+	RestartSearch();
+	undo_journal.Clear();
 	lines.clear();
-	std::string::size_type start = 0;
-	std::string::size_type end = text.find('\n');
-	while (end != std::string::npos)
-	{
-		TextEdit::Line line{this};
-		line.text = text.substr(start, end - start);
-		lines.push_back(line);
-		start = end + 1;
-		end = text.find('\n', start);
-	}
-	TextEdit::Line line{this};
-	line.text = text.substr(start);
-	lines.push_back(line);
+	line_heights.assign(document.GetLineCount(), 0.0);
+	measured_height = 0.0;
+	measured_lines = 0;
+	max_line_width = 0.0;
+	scroll_x = 0.0;
 
 	clip_start_offset = 0;
 	SetCursorPos(0);
@@ -196,19 +208,21 @@ void TextEdit::SetText(const std::string& text)
 
 void TextEdit::AddText(const std::string& text)
 {
-	std::string::size_type start = 0;
-	std::string::size_type end = text.find('\n');
-	while (end != std::string::npos)
-	{
-		TextEdit::Line line{this};
-		line.text = text.substr(start, end - start);
-		lines.push_back(line);
-		start = end + 1;
-		end = text.find('\n', start);
-	}
-	TextEdit::Line line{this};
-	line.text = text.substr(start);
-	lines.push_back(line);
+	AddText(TextBuffer::Create(text));
+}
+
+void TextEdit::AddText(std::shared_ptr<TextBuffer> buffer)
+{
+	// The added text always starts on a new line
+	size_t old_size = document.GetSize();
+	int old_last = GetLineCount() - 1;
+	document.Append("\n");
+	document.Append(std::move(buffer));
+	if (FuncTextChanged)
+		NotifyTextChanged(old_size, 0, document.GetSize() - old_size, old_last, old_last, GetLineCount() - 1);
+	RestartSearch();
+	undo_journal.EndTyping();
+	line_heights.resize(document.GetLineCount(), 0.0);
 
 	//	clip_start_offset = 0;
 	//	SetCursorPos(0);
@@ -239,8 +253,8 @@ void TextEdit::DeleteSelectedText()
 	int length = std::abs(selection_length);
 
 	ClearSelection();
-	std::string text = GetText();
-	SetText(text.substr(0, start) + text.substr(start + length));
+	undo_journal.Record(start, document.GetText(start, length), {});
+	ApplyEdit(start, length, {});
 	SetCursorPos(start);
 }
 
@@ -415,7 +429,7 @@ void TextEdit::OnKeyDown(InputKey key)
 		if (cursor_pos.y > 0)
 		{
 			cursor_pos.y--;
-			cursor_pos.x = std::min(lines[cursor_pos.y].text.size(), (size_t)cursor_pos.x);
+			cursor_pos.x = std::min(GetLineLength(cursor_pos.y), cursor_pos.x);
 		}
 
 		if (GetKeyState(InputKey::Shift))
@@ -430,17 +444,17 @@ void TextEdit::OnKeyDown(InputKey key)
 		}
 		MoveVerticalScroll();
 		Update();
-		undo_info.first_text_insert = true;
+		undo_journal.EndTyping();
 	}
 	else if (key == InputKey::Down)
 	{
 		if (GetKeyState(InputKey::Shift) && selection_length == 0)
 			selection_start = cursor_pos;
 
-		if (cursor_pos.y < (int)lines.size() - 1)
+		if (cursor_pos.y < GetLineCount() - 1)
 		{
 			cursor_pos.y++;
-			cursor_pos.x = std::min(lines[cursor_pos.y].text.size(), (size_t)cursor_pos.x);
+			cursor_pos.x = std::min(GetLineLength(cursor_pos.y), cursor_pos.x);
 		}
 
 		if (GetKeyState(InputKey::Shift))
@@ -456,7 +470,7 @@ void TextEdit::OnKeyDown(InputKey key)
 		MoveVerticalScroll();
 
 		Update();
-		undo_info.first_text_insert = true;
+		undo_journal.EndTyping();
 	}
 	else if (key == InputKey::Left)
 	{
@@ -490,9 +504,9 @@ void TextEdit::OnKeyDown(InputKey key)
 	else if (key == InputKey::End)
 	{
 		if (GetKeyState(InputKey::Ctrl))
-			cursor_pos = ivec2(lines.back().text.length(), lines.size() - 1);
+			cursor_pos = ivec2(GetLineLength(GetLineCount() - 1), GetLineCount() - 1);
 		else
-			cursor_pos.x = lines[cursor_pos.y].text.size();
+			cursor_pos.x = GetLineLength(cursor_pos.y);
 
 		if (GetKeyState(InputKey::Shift))
 			selection_length = ToOffset(cursor_pos) - ToOffset(selection_start);
@@ -512,6 +526,7 @@ void TextEdit::OnKeyDown(InputKey key)
 		std::string::const_iterator end_str = std::remove(str.begin(), str.end(), '\r');
 		str.resize(end_str - str.begin());
 		DeleteSelectedText();
+		undo_journal.EndTyping();
 
 		if (input_mask.empty())
 		{
@@ -526,16 +541,19 @@ void TextEdit::OnKeyDown(InputKey key)
 				SetCursorPos(GetCursorPos() + str.length());
 			}
 		}
+		undo_journal.EndTyping();
 		MoveVerticalScroll();
 	}
 	else if (GetKeyState(InputKey::Ctrl) && key == InputKey::Z)
 	{
-		if (!readonly)
-		{
-			std::string tmp = undo_info.undo_text;
-			undo_info.undo_text = GetText();
-			SetText(tmp);
-		}
+		if (GetKeyState(InputKey::Shift))
+			Redo();
+		else
+			Undo();
+	}
+	else if (GetKeyState(InputKey::Ctrl) && key == InputKey::Y)
+	{
+		Redo();
 	}
 	else if (key == InputKey::Shift)
 	{
@@ -561,6 +579,7 @@ bool TextEdit::OnMouseWheel(const Point& pos, InputKey key)
 	{
 		vert_scrollbar->SetPosition(vert_scrollbar->GetPosition() + 1);
 	}
+	ScrollPaintedLines();
 	return true;
 }
 
@@ -571,8 +590,8 @@ void TextEdit::OnSetFocus()
 	if (select_all_on_focus_gain)
 		SelectAll();
 	ignore_mouse_events = true;
-	cursor_pos.y = lines.size() - 1;
-	cursor_pos.x = lines[cursor_pos.y].text.length();
+	cursor_pos.y = GetLineCount() - 1;
+	cursor_pos.x = GetLineLength(cursor_pos.y);
 
 	Update();
 
@@ -597,10 +616,69 @@ void TextEdit::CreateComponents()
 	vert_scrollbar->FuncScroll = [this]() { OnVerticalScroll(); };
 	vert_scrollbar->SetVisible(false);
 	vert_scrollbar->SetVertical();
+
+	horiz_scrollbar = new Scrollbar(this);
+	horiz_scrollbar->FuncScroll = [this]() { OnHorizontalScroll(); };
+	horiz_scrollbar->SetVisible(false);
+	horiz_scrollbar->SetHorizontal();
 }
 
 void TextEdit::OnVerticalScroll()
 {
+	ScrollPaintedLines();
+}
+
+void TextEdit::ScrollPaintedLines()
+{
+	int first = (int)vert_scrollbar->GetPosition();
+	int previous = painted_first_line;
+	if (first == previous)
+		return;
+	painted_first_line = first;
+
+	// The lines in view keep their layouts, so they only move by the height of the lines scrolled past.
+	// Only lines with a current layout are known to have the height they were painted with.
+	if (std::abs(first - previous) < visible_lines)
+	{
+		double dy = 0.0;
+		for (int i = std::min(first, previous); i < std::max(first, previous); i++)
+		{
+			auto it = lines.find(i);
+			if (it == lines.end() || it->second.invalidated)
+			{
+				Update();
+				return;
+			}
+			dy += it->second.box.height;
+		}
+
+		double width = GetWidth() - (vert_scrollbar->IsVisible() ? 16.0 : 0.0);
+		double height = GetHeight() - (horiz_scrollbar->IsVisible() ? 16.0 : 0.0);
+		ScrollRect(Rect::xywh(0.0, 0.0, width, height), 0.0, first > previous ? -dy : dy);
+	}
+	else
+	{
+		Update();
+	}
+}
+
+void TextEdit::OnHorizontalScroll()
+{
+	scroll_x = horiz_scrollbar->GetPosition();
+	Update();
+}
+
+void TextEdit::UpdateHorizontalScroll()
+{
+	double view_width = GetWidth() - (vert_scrollbar->IsVisible() ? 16.0 : 0.0);
+	bool visible = !word_wrap && max_line_width > view_width;
+	if (!visible)
+		scroll_x = 0.0;
+
+	horiz_scrollbar->SetFrameGeometry(Rect(0.0, GetHeight() - 16.0, view_width, 16.0));
+	horiz_scrollbar->SetRanges(view_width, max_line_width);
+	horiz_scrollbar->SetVisible(visible);
+	horiz_scrollbar->SetPosition(scroll_x);
 }
 
 void TextEdit::UpdateVerticalScroll()
@@ -614,7 +692,7 @@ void TextEdit::UpdateVerticalScroll()
 	vert_scrollbar->SetFrameGeometry(rect);
 
 	double total_height = GetTotalLineHeight();
-	double height_per_line = std::max(1.0, total_height / std::max(1.0, (double)lines.size()));
+	double height_per_line = std::max(1.0, total_height / std::max(1.0, (double)GetLineCount()));
 	bool visible = total_height > GetHeight();
 	vert_scrollbar->SetRanges((int)std::round(GetHeight() / height_per_line), (int)std::round(total_height / height_per_line));
 	vert_scrollbar->SetLineStep(1);
@@ -627,7 +705,7 @@ void TextEdit::UpdateVerticalScroll()
 void TextEdit::MoveVerticalScroll()
 {
 	double total_height = GetTotalLineHeight();
-	double height_per_line = std::max(1.0, total_height / std::max((size_t)1, lines.size()));
+	double height_per_line = std::max(1.0, total_height / std::max(1, GetLineCount()));
 	int lines_fit = (int)(GetHeight() / height_per_line);
 	if (cursor_pos.y >= vert_scrollbar->GetPosition() + lines_fit)
 	{
@@ -637,16 +715,65 @@ void TextEdit::MoveVerticalScroll()
 	{
 		vert_scrollbar->SetPosition(cursor_pos.y);
 	}
+	ScrollPaintedLines();
 }
 
 double TextEdit::GetTotalLineHeight()
 {
-	double total = 0;
-	for (std::vector<Line>::const_iterator iter = lines.begin(); iter != lines.end(); iter++)
+	// Lines never laid out are estimated to be as high as the average measured line
+	double estimate = measured_lines > 0 ? measured_height / measured_lines : GetCanvas()->getFontMetrics(GetFont()).height;
+	return measured_height + (GetLineCount() - measured_lines) * estimate;
+}
+
+void TextEdit::SetLineHeight(int line, double height)
+{
+	double& current = line_heights[line];
+	if (current != 0.0)
+	{
+		measured_height -= current;
+		measured_lines--;
+	}
+	current = height;
+	if (current != 0.0)
 	{
-		total += iter->layout.GetSize().height;
+		measured_height += current;
+		measured_lines++;
+	}
+}
+
+int TextEdit::GetLineLength(int line) const
+{
+	return (int)document.GetLineLength(line);
+}
+
+void TextEdit::InvalidateLines(int first, int last, int new_last)
+{
+	// Lines first to last were replaced by lines first to new_last
+	for (int i = first; i <= last; i++)
+		SetLineHeight(i, 0.0);
+	line_heights.erase(line_heights.begin() + first + 1, line_heights.begin() + last + 1);
+	line_heights.insert(line_heights.begin() + first + 1, new_last - first, 0.0);
+
+	auto it = lines.find(first);
+	if (it != lines.end())
+		it->second.invalidated = true;
+
+	it = lines.upper_bound(first);
+	while (it != lines.end() && it->first <= last)
+		it = lines.erase(it);
+
+	int delta = new_last - last;
+	if (delta != 0)
+	{
+		std::map<int, Line> shifted;
+		while (it != lines.end())
+		{
+			auto node = lines.extract(it++);
+			node.key() += delta;
+			shifted.insert(std::move(node));
+		}
+		lines.merge(shifted);
 	}
-	return total;
 }
 
 void TextEdit::Move(int steps, bool shift, bool ctrl)
@@ -659,10 +786,10 @@ void TextEdit::Move(int steps, bool shift, bool ctrl)
 	{
 		if (steps < 0 && cursor_pos.x == 0 && cursor_pos.y > 0)
 		{
-			cursor_pos.x = (int)lines[cursor_pos.y - 1].text.size();
+			cursor_pos.x = GetLineLength(cursor_pos.y - 1);
 			cursor_pos.y--;
 		}
-		else if (steps > 0 && cursor_pos.x == (int)lines[cursor_pos.y].text.size() && cursor_pos.y + 1 < (int)lines.size())
+		else if (steps > 0 && cursor_pos.x == GetLineLength(cursor_pos.y) && cursor_pos.y + 1 < GetLineCount())
 		{
 			cursor_pos.x = 0;
 			cursor_pos.y++;
@@ -678,17 +805,18 @@ void TextEdit::Move(int steps, bool shift, bool ctrl)
 	}
 	else if (steps < 0 && cursor_pos.x == 0 && cursor_pos.y > 0)
 	{
-		cursor_pos.x = (int)lines[cursor_pos.y - 1].text.size();
+		cursor_pos.x = GetLineLength(cursor_pos.y - 1);
 		cursor_pos.y--;
 	}
-	else if (steps > 0 && cursor_pos.x == (int)lines[cursor_pos.y].text.size() && cursor_pos.y + 1 < (int)lines.size())
+	else if (steps > 0 && cursor_pos.x == GetLineLength(cursor_pos.y) && cursor_pos.y + 1 < GetLineCount())
 	{
 		cursor_pos.x = 0;
 		cursor_pos.y++;
 	}
 	else
 	{
-		UTF8Reader utf8_reader(lines[cursor_pos.y].text.data(), lines[cursor_pos.y].text.length());
+		std::string text = document.GetLineText(cursor_pos.y);
+		UTF8Reader utf8_reader(text.data(), text.length());
 		utf8_reader.set_position(cursor_pos.x);
 		if (steps > 0)
 		{
@@ -719,20 +847,21 @@ void TextEdit::Move(int steps, bool shift, bool ctrl)
 	MoveVerticalScroll();
 	Update();
 
-	undo_info.first_text_insert = true;
+	undo_journal.EndTyping();
 }
 
 std::string TextEdit::break_characters = " ::;,.-";
 
 TextEdit::ivec2 TextEdit::FindNextBreakCharacter(ivec2 search_start)
 {
+	std::string text = document.GetLineText(search_start.y);
 	search_start.x++;
-	if (search_start.x >= int(lines[search_start.y].text.size()) - 1)
-		return ivec2(lines[search_start.y].text.size(), search_start.y);
+	if (search_start.x >= int(text.size()) - 1)
+		return ivec2(text.size(), search_start.y);
 
-	size_t pos = lines[search_start.y].text.find_first_of(break_characters, search_start.x);
+	size_t pos = text.find_first_of(break_characters, search_start.x);
 	if (pos == std::string::npos)
-		return ivec2(lines[search_start.y].text.size(), search_start.y);
+		return ivec2(text.size(), search_start.y);
 	return ivec2((int)pos, search_start.y);
 }
 
@@ -741,7 +870,7 @@ TextEdit::ivec2 TextEdit::FindPreviousBreakCharacter(ivec2 search_start)
 	search_start.x--;
 	if (search_start.x <= 0)
 		return ivec2(0, search_start.y);
-	size_t pos = lines[search_start.y].text.find_last_of(break_characters, search_start.x);
+	size_t pos = document.GetLineText(search_start.y).find_last_of(break_characters, search_start.x);
 	if (pos == std::string::npos)
 		return ivec2(0, search_start.y);
 	return ivec2((int)pos, search_start.y);
@@ -749,55 +878,248 @@ TextEdit::ivec2 TextEdit::FindPreviousBreakCharacter(ivec2 search_start)
 
 void TextEdit::InsertText(ivec2 pos, const std::string& str)
 {
-	undo_info.first_erase = false;
-	if (undo_info.first_text_insert)
-	{
-		undo_info.undo_text = GetText();
-		undo_info.first_text_insert = false;
-	}
-
 	// checking if insert exceeds max length
-	if (ToOffset(ivec2((int)lines[lines.size() - 1].text.size(), (int)lines.size() - 1)) + str.length() > (size_t)max_length)
+	if (document.GetSize() + str.length() > (size_t)max_length)
 	{
 		return;
 	}
 
-	std::string::size_type start = 0;
-	while (true)
-	{
-		std::string::size_type next_newline = str.find('\n', start);
+	size_t offset = ToOffset(pos);
+	undo_journal.Record(offset, {}, str, true);
+	ApplyEdit(offset, 0, str);
+
+	MoveVerticalScroll();
+}
+
+void TextEdit::ApplyEdit(size_t offset, size_t length, const std::string& text, bool updateSearch)
+{
+	offset = std::min(offset, document.GetSize());
+	length = std::min(length, document.GetSize() - offset);
+	int first = (int)document.GetLineFromOffset(offset);
+	int last = (int)document.GetLineFromOffset(offset + length);
+	int new_last = first + (int)std::count(text.begin(), text.end(), '\n');
+	document.Erase(offset, length);
+	document.Insert(offset, text);
+	InvalidateLines(first, last, new_last);
+	if (updateSearch)
+		UpdateSearchAfterEdit(offset, length, text.size());
+	Update();
+
+	if (FuncTextChanged)
+		NotifyTextChanged(offset, length, text, first, last, new_last);
+}
+
+void TextEdit::NotifyTextChanged(size_t offset, size_t length, const std::string& text, int first, int last, int new_last)
+{
+	TextChange change;
+	change.start = offset;
+	change.removed_length = length;
+	change.inserted_length = text.size();
+	change.inserted = text;
+	change.first_line = first;
+	change.last_line = last;
+	change.new_last_line = new_last;
+	FuncTextChanged(change);
+}
+
+void TextEdit::NotifyTextChanged(size_t offset, size_t length, size_t inserted_length, int first, int last, int new_last)
+{
+	TextChange change;
+	change.start = offset;
+	change.removed_length = length;
+	change.inserted_length = inserted_length;
+	change.inserted_omitted = true;
+	change.first_line = first;
+	change.last_line = last;
+	change.new_last_line = new_last;
+	FuncTextChanged(change);
+}
+
+void TextEdit::Undo()
+{
+	if (readonly)
+		return;
+
+	const UndoJournal::Edit* edit = undo_journal.Undo();
+	if (!edit)
+		return;
+
+	ClearSelection();
+	ApplyEdit(edit->offset, edit->inserted.size(), edit->removed);
+	SetCursorPos((int)(edit->offset + edit->removed.size()));
+	MoveVerticalScroll();
+}
+
+void TextEdit::Redo()
+{
+	if (readonly)
+		return;
+
+	const UndoJournal::Edit* edit = undo_journal.Redo();
+	if (!edit)
+		return;
+
+	ClearSelection();
+	ApplyEdit(edit->offset, edit->removed.size(), edit->inserted);
+	SetCursorPos((int)(edit->offset + edit->inserted.size()));
+	MoveVerticalScroll();
+}
+
+bool TextEdit::CanUndo() const
+{
+	return !readonly && undo_journal.CanUndo();
+}
+
+bool TextEdit::CanRedo() const
+{
+	return !readonly && undo_journal.CanRedo();
+}
 
-		lines[pos.y].text.insert(pos.x, str.substr(start, next_newline - start));
-		lines[pos.y].invalidated = true;
+void TextEdit::Find(const std::string& text, const TextSearchOptions& options)
+{
+	search_text = text;
+	search_options = options;
+	RestartSearch();
+	Update();
+}
 
-		if (next_newline == std::string::npos)
-			break;
+void TextEdit::ClearFind()
+{
+	Find({});
+}
 
-		pos.x += next_newline - start;
+int TextEdit::GetFindMatchCount() const
+{
+	return (int)search_matches.size();
+}
 
-		Line line{this};
-		line.text = lines[pos.y].text.substr(pos.x);
-		lines.insert(lines.begin() + pos.y + 1, line);
-		lines[pos.y].text = lines[pos.y].text.substr(0, pos.x);
-		lines[pos.y].invalidated = true;
-		pos = ivec2(0, pos.y + 1);
+bool TextEdit::FindNext()
+{
+	if (search_matches.empty())
+		return false;
 
-		start = next_newline + 1;
+	auto it = std::lower_bound(search_matches.begin(), search_matches.end(), (size_t)GetCursorPos(), [](const TextSearch::Match& match, size_t offset) { return match.offset < offset; });
+	if (it == search_matches.end())
+		it = search_matches.begin();
+	SelectMatch(*it);
+	return true;
+}
+
+bool TextEdit::FindPrevious()
+{
+	if (search_matches.empty())
+		return false;
+
+	size_t start = GetCursorPos();
+	if (selection_length != 0)
+		start = std::min(ToOffset(selection_start), ToOffset(selection_start) + selection_length);
+
+	auto it = std::lower_bound(search_matches.begin(), search_matches.end(), start, [](const TextSearch::Match& match, size_t offset) { return match.offset < offset; });
+	if (it == search_matches.begin())
+		it = search_matches.end();
+	SelectMatch(*(--it));
+	return true;
+}
+
+int TextEdit::ReplaceAll(const std::string& replacement)
+{
+	if (readonly || search_text.empty())
+		return 0;
+
+	// The matches follow every edit, so once the background search has finished they are the matches in the current text
+	search.Wait();
+	search.Poll(search_matches);
+	search_timer->Stop();
+	if (search_matches.empty())
+		return 0;
+
+	std::vector<TextSearch::Match> matches = std::move(search_matches);
+	search_matches.clear();
+
+	size_t start = matches.front().offset;
+	size_t end = matches.back().offset + matches.back().length;
+	std::string text;
+	size_t pos = start;
+	for (const TextSearch::Match& match : matches)
+	{
+		text += document.GetText(pos, match.offset - pos);
+		text += replacement;
+		pos = match.offset + match.length;
 	}
 
+	if (FuncBeforeEditChanged)
+		FuncBeforeEditChanged();
+
+	ClearSelection();
+	undo_journal.Record(start, document.GetText(start, end - start), text);
+	// The replaced text is searched again in the background instead of updating the matches around such a large edit
+	ApplyEdit(start, end - start, text, false);
+	RestartSearch();
+	SetCursorPos((int)(start + text.size()));
 	MoveVerticalScroll();
 
+	if (FuncAfterEditChanged)
+		FuncAfterEditChanged();
+
+	return (int)matches.size();
+}
+
+void TextEdit::SelectMatch(const TextSearch::Match& match)
+{
+	selection_start = FromOffset(match.offset);
+	selection_length = (int)match.length;
+	cursor_pos = FromOffset(match.offset + match.length);
+	undo_journal.EndTyping();
+	MoveVerticalScroll();
 	Update();
 }
 
-void TextEdit::Backspace()
+void TextEdit::RestartSearch()
 {
-	if (undo_info.first_erase)
+	search_matches.clear();
+	if (search_text.empty())
 	{
-		undo_info.first_erase = false;
-		undo_info.undo_text = GetText();
+		search.Stop();
+		search_timer->Stop();
+		return;
 	}
 
+	search.Start(document.CreateSnapshot(), search_text, search_options);
+	search_timer->Start(30);
+}
+
+void TextEdit::UpdateSearchAfterEdit(size_t offset, size_t removed, size_t inserted)
+{
+	if (search_text.empty())
+		return;
+
+	// A search still running is scanning the text from before the edit
+	if (search.Poll(search_matches))
+	{
+		RestartSearch();
+		return;
+	}
+
+	if (TextSearch::UpdateMatches(search_matches, document.CreateSnapshot(), search_text, search_options, offset, removed, inserted) && FuncFindResultsChanged)
+		FuncFindResultsChanged();
+}
+
+void TextEdit::OnSearchTimerExpired()
+{
+	size_t count = search_matches.size();
+	if (!search.Poll(search_matches))
+		search_timer->Stop();
+
+	if (search_matches.size() != count)
+	{
+		Update();
+		if (FuncFindResultsChanged)
+			FuncFindResultsChanged();
+	}
+}
+
+void TextEdit::Backspace()
+{
 	if (GetSelectionLength() != 0)
 	{
 		DeleteSelectedText();
@@ -808,18 +1130,19 @@ void TextEdit::Backspace()
 	{
 		if (cursor_pos.x > 0)
 		{
-			UTF8Reader utf8_reader(lines[cursor_pos.y].text.data(), lines[cursor_pos.y].text.length());
+			std::string text = document.GetLineText(cursor_pos.y);
+			UTF8Reader utf8_reader(text.data(), text.length());
 			utf8_reader.set_position(cursor_pos.x);
 			utf8_reader.prev();
 			int length = utf8_reader.char_length();
-			lines[cursor_pos.y].text.erase(cursor_pos.x - length, length);
-			lines[cursor_pos.y].invalidated = true;
+			size_t offset = ToOffset(cursor_pos) - length;
+			undo_journal.Record(offset, text.substr(cursor_pos.x - length, length), {}, true);
+			ApplyEdit(offset, length, {});
 			cursor_pos.x -= length;
-			Update();
 		}
 		else if (cursor_pos.y > 0)
 		{
-			selection_start = ivec2(lines[cursor_pos.y - 1].text.length(), cursor_pos.y - 1);
+			selection_start = ivec2(GetLineLength(cursor_pos.y - 1), cursor_pos.y - 1);
 			selection_length = 1;
 			DeleteSelectedText();
 		}
@@ -829,12 +1152,6 @@ void TextEdit::Backspace()
 
 void TextEdit::Del()
 {
-	if (undo_info.first_erase)
-	{
-		undo_info.first_erase = false;
-		undo_info.undo_text = GetText();
-	}
-
 	if (GetSelectionLength() != 0)
 	{
 		DeleteSelectedText();
@@ -843,18 +1160,19 @@ void TextEdit::Del()
 	}
 	else
 	{
-		if (cursor_pos.x < (int)lines[cursor_pos.y].text.size())
+		if (cursor_pos.x < GetLineLength(cursor_pos.y))
 		{
-			UTF8Reader utf8_reader(lines[cursor_pos.y].text.data(), lines[cursor_pos.y].text.length());
+			std::string text = document.GetLineText(cursor_pos.y);
+			UTF8Reader utf8_reader(text.data(), text.length());
 			utf8_reader.set_position(cursor_pos.x);
 			int length = utf8_reader.char_length();
-			lines[cursor_pos.y].text.erase(cursor_pos.x, length);
-			lines[cursor_pos.y].invalidated = true;
-			Update();
+			size_t offset = ToOffset(cursor_pos);
+			undo_journal.Record(offset, text.substr(cursor_pos.x, length), {}, true);
+			ApplyEdit(offset, length, {});
 		}
-		else if (cursor_pos.y + 1 < (int)lines.size())
+		else if (cursor_pos.y + 1 < GetLineCount())
 		{
-			selection_start = ivec2((int)lines[cursor_pos.y].text.length(), cursor_pos.y);
+			selection_start = ivec2(GetLineLength(cursor_pos.y), cursor_pos.y);
 			selection_length = 1;
 			DeleteSelectedText();
 		}
@@ -883,15 +1201,24 @@ void TextEdit::OnGeometryChanged()
 {
 	Canvas* canvas = GetCanvas();
 
-	for (auto& line : lines)
+	for (auto& it : lines)
+	{
+		it.second.invalidated = true;
+	}
+
+	// Wrapped lines change height with the width, including the lines not laid out right now
+	if (word_wrap)
 	{
-		line.invalidated = true;
+		line_heights.assign(document.GetLineCount(), 0.0);
+		measured_height = 0.0;
+		measured_lines = 0;
 	}
 
 	vertical_text_align = canvas->verticalTextAlign(GetFont());
 
 	clip_start_offset = 0;
 	UpdateVerticalScroll();
+	Update();
 }
 
 void TextEdit::OnScrollTimerExpired()
@@ -920,52 +1247,26 @@ bool TextEdit::InputMaskAcceptsInput(ivec2 cursor_pos, const std::string& str)
 
 std::string::size_type TextEdit::ToOffset(ivec2 pos) const
 {
-	if (pos.y < (int)lines.size())
+	if (pos.y < GetLineCount())
 	{
-		std::string::size_type offset = 0;
-		for (int line = 0; line < pos.y; line++)
-		{
-			offset += lines[line].text.size() + 1;
-		}
-		return offset + std::min((size_t)pos.x, lines[pos.y].text.size());
+		return document.GetLineStart(pos.y) + std::min((size_t)pos.x, document.GetLineLength(pos.y));
 	}
 	else
 	{
-		std::string::size_type offset = 0;
-		for (size_t line = 0; line < lines.size(); line++)
-		{
-			offset += lines[line].text.size() + 1;
-		}
-		return offset - 1;
+		return document.GetSize();
 	}
 }
 
 TextEdit::ivec2 TextEdit::FromOffset(std::string::size_type offset) const
 {
-	int line_offset = 0;
-	for (int line = 0; line < (int)lines.size(); line++)
-	{
-		if (offset <= line_offset + lines[line].text.size())
-		{
-			return ivec2(offset - line_offset, line);
-		}
-		line_offset += lines[line].text.size() + 1;
-	}
-	return ivec2(lines.back().text.size(), lines.size() - 1);
+	offset = std::min(offset, document.GetSize());
+	size_t line = document.GetLineFromOffset(offset);
+	return ivec2(offset - document.GetLineStart(line), line);
 }
 
 double TextEdit::GetTotalHeight()
 {
-	Canvas* canvas = GetCanvas();
-	LayoutLines(canvas);
-	if (!lines.empty())
-	{
-		return lines.back().box.bottom();
-	}
-	else
-	{
-		return GetHeight();
-	}
+	return GetTotalLineHeight();
 }
 
 void TextEdit::LayoutLines(Canvas* canvas)
@@ -985,42 +1286,80 @@ void TextEdit::LayoutLines(Canvas* canvas)
 		sel_end = selection_start;
 	}
 
-	Colorf textColor = GetStyleColor("color");
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
+	// Only the visible lines are laid out. Layouts for a few lines around them are kept for scrolling.
+	const int margin = 4;
+	int first = vert_scrollbar->GetPosition();
+	int count = GetLineCount();
+	lines.erase(lines.begin(), lines.lower_bound(first - margin));
+	painted_first_line = first;
+
 	Point draw_pos;
-	for (size_t i = (size_t)vert_scrollbar->GetPosition(); i < lines.size(); i++)
+	int i = first;
+	int last = count;
+	for (; i < count && i < last + margin; i++)
 	{
-		Line& line = lines[i];
+		if (last == count && draw_pos.y >= GetHeight())
+			last = i;
+
+		Line& line = lines.try_emplace(i, this).first->second;
 		if (line.invalidated)
 		{
-			line.layout.Clear();
-			if (!line.text.empty())
-				line.layout.AddText(line.text, font, textColor);
+			// Heights are whole pixels, so that scrolling by lines can move the pixels already painted
+			if (word_wrap)
+			{
+				std::string text = document.GetLineText(i);
+				if (!text.empty())
+					line.layout.SetText(text, font, textColor);
+				else
+					line.layout.SetText(" ", font, textColor); // Draw one space character to get the correct height
+				line.layout.Layout(canvas, GetWidth());
+				line.box = Rect(draw_pos, Size(line.layout.GetSize().width, GridFitSize(line.layout.GetSize().height)));
+			}
 			else
-				line.layout.AddText(" ", font, textColor); // Draw one space character to get the correct height
-			line.layout.Layout(canvas, GetWidth());
-			line.box = Rect(draw_pos, line.layout.GetSize());
+			{
+				line.run.SetText(document.GetLineText(i), font);
+				line.box = Rect(draw_pos, Size(line.run.GetWidth(canvas), GridFitSize(line.run.GetHeight(canvas))));
+				max_line_width = std::max(max_line_width, line.box.width);
+			}
 			line.invalidated = false;
+			SetLineHeight(i, line.box.height);
 		}
 
-		if (sel_start != sel_end && sel_start.y <= (int)i && sel_end.y >= (int)i)
-		{
-			line.layout.SetSelectionRange(sel_start.y < (int)i ? 0 : sel_start.x, sel_end.y > (int)i ? line.text.size() : sel_end.x);
-		}
-		else
+		std::vector<std::pair<std::string::size_type, std::string::size_type>> highlights;
+		if (!search_matches.empty())
 		{
-			line.layout.SetSelectionRange(0, 0);
+			size_t line_start = document.GetLineStart(i);
+			size_t line_end = line_start + GetLineLength(i);
+			auto match = std::lower_bound(search_matches.begin(), search_matches.end(), line_start, [](const TextSearch::Match& m, size_t offset) { return m.offset + m.length <= offset; });
+			for (; match != search_matches.end() && match->offset < line_end; ++match)
+				highlights.push_back({ std::max(match->offset, line_start) - line_start, std::min(match->offset + match->length, line_end) - line_start });
 		}
 
-		line.layout.HideCursor();
-		if (HasFocus())
+		std::pair<std::string::size_type, std::string::size_type> selection;
+		if (sel_start != sel_end && sel_start.y <= i && sel_end.y >= i)
+			selection = { sel_start.y < i ? 0 : sel_start.x, sel_end.y > i ? GetLineLength(i) : sel_end.x };
+
+		bool show_cursor = HasFocus() && cursor_blink_visible && cursor_pos.y == i;
+
+		if (word_wrap)
 		{
-			if (cursor_blink_visible && cursor_pos.y == (int)i)
+			line.layout.SetHighlightRanges(std::move(highlights));
+			line.layout.SetSelectionRange(selection.first, selection.second);
+			line.layout.HideCursor();
+			if (show_cursor)
 			{
 				line.layout.SetCursorPos(cursor_pos.x);
 				line.layout.SetCursorColor(textColor);
 				line.layout.ShowCursor();
 			}
 		}
+		else
+		{
+			line.highlights = std::move(highlights);
+			line.selection = selection;
+			line.cursor = show_cursor ? cursor_pos.x : -1;
+		}
 
 		line.box.x = draw_pos.x;
 		line.box.y = draw_pos.y;
@@ -1028,37 +1367,128 @@ void TextEdit::LayoutLines(Canvas* canvas)
 
 		draw_pos = line.box.bottomLeft();
 	}
+	lines.erase(lines.lower_bound(i), lines.end());
+	visible_lines = last - first;
 	UpdateVerticalScroll();
+
+	// The scroll range changes as lines are measured, which can move the lines that were just laid out
+	if ((int)vert_scrollbar->GetPosition() != first)
+		Update();
+
+	if (!word_wrap)
+	{
+		// Scroll horizontally to the cursor when it has moved
+		auto it = lines.find(cursor_pos.y);
+		if (cursor_pos != scrolled_cursor_pos && it != lines.end())
+		{
+			double view_width = GetWidth() - (vert_scrollbar->IsVisible() ? 16.0 : 0.0);
+			double cursor_x = it->second.run.GetPosition(canvas, cursor_pos.x);
+			if (cursor_x < scroll_x)
+				scroll_x = cursor_x;
+			else if (cursor_x + 1.0 > scroll_x + view_width)
+				scroll_x = cursor_x + 1.0 - view_width;
+			scrolled_cursor_pos = cursor_pos;
+		}
+	}
+	UpdateHorizontalScroll();
 }
 
 void TextEdit::OnPaint(Canvas* canvas)
 {
 	LayoutLines(canvas);
-	for (size_t i = (size_t)vert_scrollbar->GetPosition(); i < lines.size(); i++)
-		lines[i].layout.DrawLayout(canvas);
+
+	// Lines outside the area being painted are skipped
+	Rect clip = canvas->getClipBox();
+	for (auto it = lines.lower_bound(vert_scrollbar->GetPosition()); it != lines.end() && it->first < vert_scrollbar->GetPosition() + visible_lines; ++it)
+	{
+		const Rect& box = it->second.box;
+		if (box.y + box.height <= clip.y || box.y >= clip.y + clip.height)
+			continue;
+		if (word_wrap)
+			it->second.layout.DrawLayout(canvas);
+		else
+			DrawUnwrappedLine(canvas, it->second);
+	}
+}
+
+void TextEdit::DrawUnwrappedLine(Canvas* canvas, Line& line)
+{
+	ChunkedTextRun& run = line.run;
+	const std::string& text = run.GetText();
+	double x = line.box.x - scroll_x;
+	double width = GetWidth();
+
+	// Find the characters in view. Nothing outside them is shaped.
+	UTF8Reader utf8_reader(text.data(), text.size());
+	size_t visible_start = run.GetCharacterIndex(canvas, -x);
+	if (visible_start > 0 && run.GetPosition(canvas, visible_start) > -x)
+	{
+		utf8_reader.set_position(visible_start);
+		utf8_reader.prev();
+		visible_start = utf8_reader.position();
+	}
+	size_t visible_end = run.GetCharacterIndex(canvas, width - x);
+	if (visible_end < text.size() && run.GetPosition(canvas, visible_end) < width - x)
+	{
+		utf8_reader.set_position(visible_end);
+		utf8_reader.next();
+		visible_end = utf8_reader.position();
+	}
+
+	VerticalTextPosition align = canvas->verticalTextAlign(GetFont());
+	double top = line.box.y + align.top;
+	double bottom = line.box.y + align.bottom;
+	auto fill = [&](size_t start, size_t end, const Colorf& color)
+	{
+		start = std::max(start, visible_start);
+		end = std::min(end, visible_end);
+		if (start < end)
+			canvas->fillRect(Rect::ltrb(x + run.GetPosition(canvas, start), top, x + run.GetPosition(canvas, end), bottom), color);
+	};
+
+	Colorf highlightBG(selectionBG.r, selectionBG.g, selectionBG.b, selectionBG.a * 0.5f);
+	for (const auto& range : line.highlights)
+		fill(range.first, range.second, highlightBG);
+	fill(line.selection.first, line.selection.second, selectionBG);
+
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
+	Point pos(x, line.box.y + align.baseline);
+	run.Draw(canvas, pos, visible_start, line.selection.first, 0.0, width, textColor);
+	run.Draw(canvas, pos, std::max(line.selection.first, visible_start), line.selection.second, 0.0, width, selectionFG);
+	run.Draw(canvas, pos, std::max(line.selection.second, visible_start), visible_end, 0.0, width, textColor);
+
+	if (line.cursor >= 0)
+	{
+		double cursor_x = x + run.GetPosition(canvas, line.cursor);
+		canvas->fillRect(Rect::ltrb(cursor_x, top, cursor_x + 1.0, bottom), textColor);
+	}
 }
 
 TextEdit::ivec2 TextEdit::GetCharacterIndex(Point mouse_wincoords)
 {
 	Canvas* canvas = GetCanvas();
-	for (size_t i = 0; i < lines.size(); i++)
+	for (auto it = lines.lower_bound(vert_scrollbar->GetPosition()); it != lines.end(); ++it)
 	{
-		Line& line = lines[i];
+		int i = it->first;
+		Line& line = it->second;
 		if (line.box.top() <= mouse_wincoords.y && line.box.bottom() > mouse_wincoords.y)
 		{
+			if (!word_wrap)
+				return ivec2(clamp((int)line.run.GetCharacterIndex(canvas, mouse_wincoords.x + scroll_x - line.box.x), 0, GetLineLength(i)), i);
+
 			SpanLayout::HitTestResult result = line.layout.HitTest(canvas, mouse_wincoords);
 			switch (result.type)
 			{
 			case SpanLayout::HitTestResult::inside:
-				return ivec2(clamp(result.offset, (size_t)0, line.text.size()), i);
+				return ivec2(clamp((int)result.offset, 0, GetLineLength(i)), i);
 			case SpanLayout::HitTestResult::outside_left:
 				return ivec2(0, i);
 			default:
 			case SpanLayout::HitTestResult::outside_right:
-				return ivec2(line.text.size(), i);
+				return ivec2(GetLineLength(i), i);
 			}
 		}
 	}
 
-	return ivec2(lines.back().text.size(), lines.size() - 1);
+	return ivec2(GetLineLength(GetLineCount() - 1), GetLineCount() - 1);
 }
@@ -57,5 +57,5 @@ void TextLabel::OnPaint(Canvas* canvas)
 	}
 
 	FontMetrics metrics = canvas->getFontMetrics(GetFont());
-	canvas->drawText(GetFont(), Point(x, (GetHeight() - metrics.height) * 0.5 + metrics.ascent), text, GetStyleColor("color"));
+	canvas->drawText(GetFont(), Point(x, (GetHeight() - metrics.height) * 0.5 + metrics.ascent), text, GetStyleColor(StyleProperty::Color));
 }
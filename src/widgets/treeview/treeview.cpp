@@ -0,0 +1,663 @@
+
+#include "widgets/treeview/treeview.h"
+#include "widgets/scrollbar/scrollbar.h"
+#include "core/timer.h"
+#include <algorithm>
+#include <cmath>
+
+void TreeViewFetch::Complete(std::vector<TreeViewItem> items)
+{
+	std::unique_lock lock(mutex);
+	children = std::move(items);
+	completed = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+TreeView::TreeView(Widget* parent) : Widget(parent)
+{
+	SetStretching(true);
+	SetStyleClass("treeview");
+
+	scrollbar = new Scrollbar(this);
+	scrollbar->FuncScroll = [this]() { OnScrollbarScroll(); };
+
+	fetchTimer = new Timer(this);
+	fetchTimer->FuncExpired = [this]() { OnFetchTimerExpired(); };
+
+	SetModel(nullptr);
+}
+
+TreeView::~TreeView()
+{
+	for (Node& node : nodes)
+	{
+		if (node.fetch)
+			node.fetch->cancelled = true;
+	}
+}
+
+void TreeView::SetModel(std::shared_ptr<TreeViewModel> newModel)
+{
+	for (Node& node : nodes)
+	{
+		if (node.fetch)
+			node.fetch->cancelled = true;
+	}
+
+	model = std::move(newModel);
+	nodes.clear();
+	freeNodes.clear();
+	fetchingNodes.clear();
+	fetchTimer->Stop();
+	rows.clear();
+	selectedRow = -1;
+
+	nodes.emplace_back();
+	UpdateScrollRanges();
+	scrollbar->SetPosition(0.0);
+	Expand(0);
+	Update();
+}
+
+void TreeView::Expand(int node)
+{
+	Expand(node, GetNodeRow(node));
+}
+
+void TreeView::Expand(int node, int row)
+{
+	if (nodes[node].expanded || (node != 0 && !nodes[node].item.hasChildren))
+		return;
+
+	nodes[node].expanded = true;
+	if (!nodes[node].fetched && !nodes[node].fetch)
+		StartFetch(node);
+
+	if (node == 0 || row >= 0)
+	{
+		std::vector<int> newRows;
+		AppendRows(node, newRows);
+		InsertRows(row + 1, newRows);
+	}
+	Update();
+}
+
+void TreeView::Collapse(int node)
+{
+	Collapse(node, GetNodeRow(node));
+}
+
+void TreeView::Collapse(int node, int row)
+{
+	if (!nodes[node].expanded || node == 0)
+		return;
+
+	if (row >= 0)
+		EraseRows(row + 1, GetSubtreeRowCount(row));
+	nodes[node].expanded = false;
+	Update();
+}
+
+void TreeView::Reload(int node)
+{
+	bool expanded = nodes[node].expanded;
+	if (expanded)
+	{
+		int row = GetNodeRow(node);
+		if (node == 0)
+			EraseRows(0, (int)rows.size());
+		else if (row >= 0)
+			EraseRows(row + 1, GetSubtreeRowCount(row));
+	}
+
+	Node& n = nodes[node];
+	if (n.fetch)
+	{
+		n.fetch->cancelled = true;
+		n.fetch.reset();
+	}
+	n.fetched = false;
+	n.expanded = false;
+	FreeChildren(node);
+
+	if (expanded)
+		Expand(node);
+	Update();
+}
+
+void TreeView::SetFetchingText(const std::string& text)
+{
+	fetchingText = text;
+	Update();
+}
+
+void TreeView::SetSelectedNode(int node, bool notify)
+{
+	if (node <= 0)
+		return;
+
+	std::vector<int> parents;
+	for (int parent = nodes[node].parent; parent > 0; parent = nodes[parent].parent)
+		parents.push_back(parent);
+	for (auto it = parents.rbegin(); it != parents.rend(); ++it)
+		Expand(*it);
+
+	SelectRow(GetNodeRow(node), notify);
+}
+
+void TreeView::ScrollToNode(int node)
+{
+	int row = GetNodeRow(node);
+	if (row >= 0)
+		ScrollToRow(row);
+}
+
+void TreeView::Activate()
+{
+	int node = GetSelectedNode();
+	if (node > 0 && OnActivated)
+		OnActivated(node);
+}
+
+int TreeView::CreateNode(TreeViewItem item, int parent)
+{
+	int index;
+	if (!freeNodes.empty())
+	{
+		index = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else
+	{
+		index = (int)nodes.size();
+		nodes.emplace_back();
+	}
+
+	Node& node = nodes[index];
+	node.item = std::move(item);
+	node.parent = parent;
+	node.depth = nodes[parent].depth + 1;
+	return index;
+}
+
+void TreeView::FreeChildren(int node)
+{
+	// Uses a list instead of recursion, so that deep trees do not overflow the stack
+	std::vector<int> pending = std::move(nodes[node].children);
+	nodes[node].children.clear();
+	while (!pending.empty())
+	{
+		int index = pending.back();
+		pending.pop_back();
+
+		Node& child = nodes[index];
+		pending.insert(pending.end(), child.children.begin(), child.children.end());
+		if (child.fetch)
+			child.fetch->cancelled = true;
+
+		// A freed node can still be in fetchingNodes, and the entry serves the node that reuses the index
+		bool queued = child.queued;
+		child = Node();
+		child.queued = queued;
+		freeNodes.push_back(index);
+	}
+}
+
+void TreeView::StartFetch(int node)
+{
+	if (!model)
+	{
+		nodes[node].fetched = true;
+		return;
+	}
+
+	auto fetch = std::make_shared<TreeViewFetch>();
+	fetch->parent = nodes[node].item;
+	fetch->root = node == 0;
+	nodes[node].fetch = fetch;
+	model->FetchChildren(fetch);
+
+	// Models that have the children at hand complete the fetch right away and no fetching row is shown.
+	// Large fetches still only add one tick worth of children here and leave the rest to the timer.
+	if (!ApplyFetch(node, MaxChildrenPerTick) && !nodes[node].queued)
+	{
+		if (fetchingNodes.empty())
+			fetchTimer->Start(16, true);
+		fetchingNodes.push_back(node);
+		nodes[node].queued = true;
+	}
+}
+
+bool TreeView::ApplyFetch(int node, size_t maxCount)
+{
+	std::shared_ptr<TreeViewFetch> fetch = nodes[node].fetch;
+	{
+		std::unique_lock lock(fetch->mutex);
+		if (!fetch->completed)
+			return false;
+	}
+
+	// Once the fetch is complete only the view uses its children
+	std::vector<TreeViewItem>& items = fetch->children;
+	size_t end = fetch->applied + std::min(items.size() - fetch->applied, maxCount);
+	size_t count = end - fetch->applied;
+	if (nodes.size() + count > nodes.capacity())
+		nodes.reserve(std::max(nodes.capacity() * 2, nodes.size() + count));
+	nodes[node].children.reserve(items.size());
+	for (size_t i = fetch->applied; i < end; i++)
+	{
+		int child = CreateNode(std::move(items[i]), node);
+		nodes[node].children.push_back(child);
+	}
+	fetch->applied = end;
+
+	if (end < items.size())
+		return false;
+
+	nodes[node].fetch.reset();
+	nodes[node].fetched = true;
+	return true;
+}
+
+void TreeView::OnFetchTimerExpired()
+{
+	// Large fetches are added over several ticks, with the fetching row staying below the children added so far
+	std::vector<int> pending;
+	pending.swap(fetchingNodes);
+	for (int node : pending)
+	{
+		nodes[node].queued = false;
+
+		// Nodes removed by Reload no longer have the fetch they were waiting for
+		if (!nodes[node].fetch)
+			continue;
+
+		size_t first = nodes[node].children.size();
+		bool done = ApplyFetch(node, MaxChildrenPerTick);
+		if (!done)
+		{
+			fetchingNodes.push_back(node);
+			nodes[node].queued = true;
+		}
+		if (!done && nodes[node].children.size() == first)
+			continue;
+
+		if (nodes[node].expanded)
+		{
+			int row = nodes[node].fetchingRow;
+			if (row >= 0)
+			{
+				if (done)
+					EraseRows(row, 1);
+				InsertRows(row, std::vector<int>(nodes[node].children.begin() + first, nodes[node].children.end()));
+			}
+		}
+		Update();
+	}
+
+	if (fetchingNodes.empty())
+		fetchTimer->Stop();
+}
+
+void TreeView::AppendRows(int node, std::vector<int>& result) const
+{
+	// Walks the expanded nodes with a stack of (node, next child) pairs instead of recursing
+	std::vector<std::pair<int, size_t>> stack;
+	stack.emplace_back(node, 0);
+	while (!stack.empty())
+	{
+		int current = stack.back().first;
+		size_t index = stack.back().second++;
+		const Node& n = nodes[current];
+		if (index < n.children.size())
+		{
+			int child = n.children[index];
+			result.push_back(child);
+			if (nodes[child].expanded)
+				stack.emplace_back(child, 0);
+		}
+		else
+		{
+			if (n.fetch)
+				result.push_back(-1 - current);
+			stack.pop_back();
+		}
+	}
+}
+
+int TreeView::GetRowDepth(int row) const
+{
+	int node = rows[row];
+	return node >= 0 ? nodes[node].depth : nodes[-1 - node].depth + 1;
+}
+
+int TreeView::GetSubtreeRowCount(int row) const
+{
+	int depth = GetRowDepth(row);
+	int end = row + 1;
+	while (end < (int)rows.size() && GetRowDepth(end) > depth)
+		end++;
+	return end - row - 1;
+}
+
+void TreeView::InsertRows(int position, const std::vector<int>& newRows)
+{
+	if (newRows.empty())
+		return;
+
+	int count = (int)newRows.size();
+	rows.insert(rows.begin() + position, newRows.begin(), newRows.end());
+	UpdateNodeRows(position);
+	if (selectedRow >= position)
+		selectedRow += count;
+
+	// Keep the rows in view where they are when rows are added above them
+	UpdateScrollRanges();
+	double scroll = scrollbar->GetPosition();
+	if (position * GetRowHeight() < scroll)
+		scrollbar->SetPosition(scroll + count * GetRowHeight());
+}
+
+void TreeView::EraseRows(int position, int count)
+{
+	if (count <= 0)
+		return;
+
+	for (int row = position; row < position + count; row++)
+	{
+		if (rows[row] >= 0)
+			nodes[rows[row]].row = -1;
+		else
+			nodes[-1 - rows[row]].fetchingRow = -1;
+	}
+	rows.erase(rows.begin() + position, rows.begin() + position + count);
+	UpdateNodeRows(position);
+	if (selectedRow >= position + count)
+		selectedRow -= count;
+	else if (selectedRow >= position)
+	{
+		// The node the removed rows belonged to takes over the selection
+		selectedRow = -1;
+		SelectRow(position - 1);
+	}
+
+	double scroll = scrollbar->GetPosition();
+	double top = position * GetRowHeight();
+	UpdateScrollRanges();
+	if (top < scroll)
+		scrollbar->SetPosition(std::max(scroll - count * GetRowHeight(), top));
+}
+
+void TreeView::UpdateNodeRows(int position)
+{
+	// The rows after an insert or erase move, like the rows in the list do
+	for (int row = position; row < (int)rows.size(); row++)
+	{
+		if (rows[row] >= 0)
+			nodes[rows[row]].row = row;
+		else
+			nodes[-1 - rows[row]].fetchingRow = row;
+	}
+}
+
+void TreeView::SelectRow(int row, bool notify)
+{
+	if (row >= 0 && row < (int)rows.size() && rows[row] >= 0 && selectedRow != row)
+	{
+		selectedRow = row;
+		Update();
+		if (notify && OnChanged)
+			OnChanged(rows[row]);
+	}
+}
+
+void TreeView::MoveSelection(int row, int direction)
+{
+	int count = (int)rows.size();
+	if (count == 0)
+		return;
+
+	// Rows shown while children are being fetched cannot be selected
+	row = std::clamp(row, 0, count - 1);
+	if (rows[row] < 0)
+	{
+		if (row + direction >= 0 && row + direction < count)
+			row += direction;
+		else
+			row -= direction;
+	}
+	if (row >= 0 && row < count)
+	{
+		SelectRow(row);
+		ScrollToRow(row);
+	}
+}
+
+int TreeView::GetRowAt(double y)
+{
+	int row = (int)std::floor((y + scrollbar->GetPosition()) / GetRowHeight());
+	return row >= 0 && row < (int)rows.size() ? row : -1;
+}
+
+void TreeView::ScrollToRow(int row)
+{
+	double y = row * GetRowHeight();
+	if (y < scrollbar->GetPosition())
+	{
+		scrollbar->SetPosition(y);
+	}
+	else if (y + GetRowHeight() > scrollbar->GetPosition() + GetHeight())
+	{
+		scrollbar->SetPosition(std::max(y + GetRowHeight() - GetHeight(), 0.0));
+	}
+	ScrollPaintedRows();
+}
+
+void TreeView::UpdateScrollRanges()
+{
+	scrollbar->SetRanges(GetHeight(), rows.size() * GetRowHeight());
+}
+
+void TreeView::ScrollPaintedRows()
+{
+	double scroll = scrollbar->GetPosition();
+	if (scroll != paintedScroll)
+	{
+		ScrollRect(Rect::xywh(0.0, 0.0, GetWidth() - scrollbar->GetPreferredWidth(), GetHeight()), 0.0, paintedScroll - scroll);
+		paintedScroll = scroll;
+	}
+}
+
+void TreeView::OnScrollbarScroll()
+{
+	ScrollPaintedRows();
+}
+
+void TreeView::OnPaint(Canvas* canvas)
+{
+	const double indent = 16.0;
+	double rowHeight = GetRowHeight();
+	double w = GetWidth() - scrollbar->GetPreferredWidth();
+
+	Colorf textColor = GetStyleColor(StyleProperty::Color);
+	Colorf selectionColor = GetStyleColor(StyleProperty::SelectionColor);
+	Colorf fetchingColor(textColor.r, textColor.g, textColor.b, textColor.a * 0.5f);
+	auto font = GetFont();
+
+	// Only the rows in view, and inside the area being painted, are looked at
+	Rect clip = canvas->getClipBox();
+	double scroll = scrollbar->GetPosition();
+	int first = std::max((int)std::floor((scroll + std::max(clip.top(), 0.0)) / rowHeight), 0);
+	int last = std::min((int)((scroll + std::min(clip.bottom(), GetHeight())) / rowHeight) + 1, (int)rows.size());
+	paintedScroll = scroll;
+
+	canvas->pushClip(Rect::xywh(0.0, 0.0, w, GetHeight()));
+	for (int row = first; row < last; row++)
+	{
+		double y = row * rowHeight - scroll;
+		double x = GetRowDepth(row) * indent;
+		if (row == selectedRow)
+		{
+			canvas->fillRect(Rect::xywh(0.0, y, w, rowHeight), selectionColor);
+		}
+
+		if (rows[row] < 0)
+		{
+			canvas->drawText(font, Point(x + indent, y + 15.0), fetchingText, fetchingColor);
+			continue;
+		}
+
+		const Node& node = nodes[rows[row]];
+		if (node.item.hasChildren)
+		{
+			double cx = x + indent * 0.5;
+			double cy = y + rowHeight * 0.5;
+			if (node.expanded)
+			{
+				canvas->line(Point(cx - 4.0, cy - 2.0), Point(cx, cy + 2.0), textColor);
+				canvas->line(Point(cx, cy + 2.0), Point(cx + 4.0, cy - 2.0), textColor);
+			}
+			else
+			{
+				canvas->line(Point(cx - 2.0, cy - 4.0), Point(cx + 2.0, cy), textColor);
+				canvas->line(Point(cx + 2.0, cy), Point(cx - 2.0, cy + 4.0), textColor);
+			}
+		}
+		canvas->drawText(font, Point(x + indent, y + 15.0), node.item.text, textColor);
+	}
+	canvas->popClip();
+}
+
+bool TreeView::OnMouseDown(const Point& pos, InputKey key)
+{
+	SetFocus();
+
+	if (key == InputKey::LeftMouse)
+	{
+		int row = GetRowAt(pos.y);
+		if (row >= 0 && rows[row] >= 0)
+		{
+			int node = rows[row];
+			double x = nodes[node].depth * 16.0;
+			if (nodes[node].item.hasChildren && pos.x >= x && pos.x < x + 16.0)
+			{
+				if (nodes[node].expanded)
+					Collapse(node, row);
+				else
+					Expand(node, row);
+			}
+			else
+			{
+				SelectRow(row);
+				ScrollToRow(row);
+			}
+		}
+	}
+	return true;
+}
+
+bool TreeView::OnMouseDoubleclick(const Point& pos, InputKey key)
+{
+	if (key == InputKey::LeftMouse)
+	{
+		int row = GetRowAt(pos.y);
+		if (row >= 0 && rows[row] >= 0)
+		{
+			int node = rows[row];
+			if (nodes[node].item.hasChildren)
+			{
+				if (nodes[node].expanded)
+					Collapse(node, row);
+				else
+					Expand(node, row);
+			}
+			if (row == selectedRow)
+				Activate();
+		}
+	}
+	return true;
+}
+
+bool TreeView::OnMouseWheel(const Point& pos, InputKey key)
+{
+	if (key == InputKey::MouseWheelUp)
+	{
+		scrollbar->SetPosition(std::max(scrollbar->GetPosition() - GetRowHeight(), 0.0));
+	}
+	else if (key == InputKey::MouseWheelDown)
+	{
+		scrollbar->SetPosition(std::min(scrollbar->GetPosition() + GetRowHeight(), scrollbar->GetMax()));
+	}
+	ScrollPaintedRows();
+	return true;
+}
+
+void TreeView::OnKeyDown(InputKey key)
+{
+	int pageSize = std::max((int)(GetHeight() / GetRowHeight()) - 1, 1);
+	int node = GetSelectedNode();
+	if (key == InputKey::Down)
+	{
+		MoveSelection(selectedRow + 1, 1);
+	}
+	else if (key == InputKey::Up)
+	{
+		MoveSelection(selectedRow >= 0 ? selectedRow - 1 : 0, -1);
+	}
+	else if (key == InputKey::PageDown)
+	{
+		MoveSelection(selectedRow + pageSize, 1);
+	}
+	else if (key == InputKey::PageUp)
+	{
+		MoveSelection(selectedRow - pageSize, -1);
+	}
+	else if (key == InputKey::Home)
+	{
+		MoveSelection(0, 1);
+	}
+	else if (key == InputKey::End)
+	{
+		MoveSelection((int)rows.size() - 1, -1);
+	}
+	else if (key == InputKey::Right && node > 0)
+	{
+		// Expands the node, or moves to its first child when it is already expanded
+		if (!nodes[node].expanded)
+		{
+			Expand(node, selectedRow);
+		}
+		else if (selectedRow + 1 < (int)rows.size() && rows[selectedRow + 1] >= 0 && GetRowDepth(selectedRow + 1) > nodes[node].depth)
+		{
+			SelectRow(selectedRow + 1);
+			ScrollToRow(selectedRow);
+		}
+	}
+	else if (key == InputKey::Left && node > 0)
+	{
+		// Collapses the node, or moves to its parent when it is already collapsed
+		if (nodes[node].expanded)
+		{
+			Collapse(node, selectedRow);
+		}
+		else if (nodes[node].parent > 0)
+		{
+			int row = GetNodeRow(nodes[node].parent);
+			SelectRow(row);
+			ScrollToRow(row);
+		}
+	}
+	else if (key == InputKey::Enter)
+	{
+		Activate();
+	}
+}
+
+void TreeView::OnGeometryChanged()
+{
+	double sw = scrollbar->GetPreferredWidth();
+	scrollbar->SetFrameGeometry(Rect::xywh(GetWidth() - sw, 0.0, sw, GetHeight()));
+	UpdateScrollRanges();
+	Update();
+}
@@ -318,6 +318,25 @@ void SDL2DisplayWindow::PresentBitmap(int width, int height, const uint32_t* pix
 	SDL_RenderPresent(RendererHandle);
 }
 
+void SDL2DisplayWindow::PresentBitmapRegion(int width, int height, const uint32_t* pixels, int x, int y, int regionWidth, int regionHeight)
+{
+	if (!RendererHandle)
+		return;
+
+	if (!BackBufferTexture || BackBufferWidth != width || BackBufferHeight != height)
+	{
+		PresentBitmap(width, height, pixels);
+		return;
+	}
+
+	SDL_Rect rect = { x, y, regionWidth, regionHeight };
+	if (SDL_UpdateTexture(BackBufferTexture, &rect, pixels + y * width + x, width * sizeof(uint32_t)) != 0)
+		return;
+
+	SDL_RenderCopy(RendererHandle, BackBufferTexture, nullptr, nullptr);
+	SDL_RenderPresent(RendererHandle);
+}
+
 void SDL2DisplayWindow::SetBorderColor(uint32_t bgra8)
 {
 	// SDL doesn't have this
@@ -42,6 +42,7 @@ public:
 	double GetDpiScale() const override;
 
 	void PresentBitmap(int width, int height, const uint32_t* pixels) override;
+	void PresentBitmapRegion(int width, int height, const uint32_t* pixels, int x, int y, int regionWidth, int regionHeight) override;
 
 	void SetBorderColor(uint32_t bgra8) override;
 	void SetCaptionColor(uint32_t bgra8) override;
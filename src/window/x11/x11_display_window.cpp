@@ -511,10 +511,32 @@ void X11DisplayWindow::PresentBitmap(int width, int height, const uint32_t* pixe
 		memcpy(backbuffer.pixels, pixels, width * height * sizeof(uint32_t));
 		GC gc = XDefaultGC(display, screen);
 		XPutImage(display, backbuffer.pixmap, gc, backbuffer.image, 0, 0, 0, 0, width, height);
-		XCopyArea(display, backbuffer.pixmap, window, gc, 0, 0, width, height, BlackPixel(display, screen), WhitePixel(display, screen));
+		XCopyArea(display, backbuffer.pixmap, window, gc, 0, 0, width, height, 0, 0);
+		backbufferExposed = false;
 	}
 }
 
+void X11DisplayWindow::PresentBitmapRegion(int width, int height, const uint32_t* pixels, int x, int y, int regionWidth, int regionHeight)
+{
+	if (backbuffer.width != width || backbuffer.height != height)
+	{
+		PresentBitmap(width, height, pixels);
+		return;
+	}
+
+	uint32_t* dest = (uint32_t*)backbuffer.pixels;
+	for (int line = y; line < y + regionHeight; line++)
+		memcpy(dest + line * width + x, pixels + line * width + x, regionWidth * sizeof(uint32_t));
+
+	GC gc = XDefaultGC(display, screen);
+	XPutImage(display, backbuffer.pixmap, gc, backbuffer.image, x, y, x, y, regionWidth, regionHeight);
+	if (backbufferExposed)
+		XCopyArea(display, backbuffer.pixmap, window, gc, 0, 0, width, height, 0, 0);
+	else
+		XCopyArea(display, backbuffer.pixmap, window, gc, x, y, regionWidth, regionHeight, x, y);
+	backbufferExposed = false;
+}
+
 void X11DisplayWindow::SetBorderColor(uint32_t bgra8)
 {
 }
@@ -697,6 +719,7 @@ void X11DisplayWindow::OnClientMessage(XEvent* event)
 
 void X11DisplayWindow::OnExpose(XEvent* event)
 {
+	backbufferExposed = true;
 	windowHost->OnWindowPaint();
 }
 
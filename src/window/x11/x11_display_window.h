@@ -46,6 +46,7 @@ public:
 	double GetDpiScale() const override;
 
 	void PresentBitmap(int width, int height, const uint32_t* pixels) override;
+	void PresentBitmapRegion(int width, int height, const uint32_t* pixels, int x, int y, int regionWidth, int regionHeight) override;
 
 	void SetBorderColor(uint32_t bgra8) override;
 	void SetCaptionColor(uint32_t bgra8) override;
@@ -132,6 +133,7 @@ private:
 		int width = 0;
 		int height = 0;
 	} backbuffer;
+	bool backbufferExposed = false; // The window lost its contents and all of the backbuffer has to be copied to it again
 
 	bool needsUpdate = false;
 
@@ -0,0 +1,516 @@
+// Checks the document and index data structures against simple reference implementations.
+//
+// Usage: zwidget_core_tests
+//
+// Random edits and queries are run against both the data structure and a plain std::string or std::vector doing the
+// same thing the slow way. The program prints the failed checks and returns a non-zero exit code if there are any.
+
+#include "core/text_document.h"
+#include "core/text_search.h"
+#include "core/row_height_index.h"
+#include "core/undo_journal.h"
+#include "core/type_ahead_index.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static std::string RandomText(std::mt19937& random, size_t maxLength, const char* alphabet)
+{
+	std::string text;
+	size_t length = random() % (maxLength + 1);
+	size_t count = strlen(alphabet);
+	for (size_t i = 0; i < length; i++)
+		text.push_back(alphabet[random() % count]);
+	return text;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void CheckDocument(const TextDocument& document, const std::string& text)
+{
+	CHECK(document.GetSize() == text.size());
+	CHECK(document.GetText() == text);
+
+	size_t lineCount = std::count(text.begin(), text.end(), '\n') + 1;
+	CHECK(document.GetLineCount() == lineCount);
+
+	size_t lineStart = 0;
+	for (size_t line = 0; line < lineCount; line++)
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == std::string::npos)
+			lineEnd = text.size();
+		CHECK(document.GetLineStart(line) == lineStart);
+		CHECK(document.GetLineLength(line) == lineEnd - lineStart);
+		CHECK(document.GetLineText(line) == text.substr(lineStart, lineEnd - lineStart));
+		lineStart = lineEnd + 1;
+	}
+
+	// Every offset including the one at the end of the text
+	size_t line = 0;
+	for (size_t offset = 0; offset <= text.size(); offset++)
+	{
+		CHECK(document.GetLineFromOffset(offset) == line);
+		if (offset < text.size() && text[offset] == '\n')
+			line++;
+	}
+
+	if (!text.empty())
+	{
+		size_t offset = text.size() / 3;
+		size_t length = text.size() / 2;
+		CHECK(document.GetText(offset, length) == text.substr(offset, length));
+	}
+	CHECK(document.GetText(text.size(), 10).empty());
+
+	TextSnapshot snapshot = document.CreateSnapshot();
+	std::string joined;
+	for (const TextSnapshot::Span& span : snapshot.GetSpans())
+		joined.append(span.data, span.length);
+	CHECK(snapshot.GetSize() == text.size());
+	CHECK(joined == text);
+}
+
+static void TestTextDocument()
+{
+	// Empty document
+	TextDocument document;
+	CheckDocument(document, {});
+	document.Erase(0, 10);
+	document.Insert(5, {});
+	CheckDocument(document, {});
+
+	// Typing at the end continues the previous insert instead of adding a piece per character
+	for (int i = 0; i < 1000; i++)
+		document.Insert(document.GetSize(), i % 50 == 49 ? "\n" : "x");
+	CHECK(document.CreateSnapshot().GetSpans().size() == 1);
+
+	std::string text = document.GetText();
+	CheckDocument(document, text);
+
+	// Random edits, many of them spanning several pieces, against a plain string
+	std::mt19937 random(1);
+	for (int iteration = 0; iteration < 2000; iteration++)
+	{
+		int action = random() % 10;
+		if (action < 4)
+		{
+			std::string insert = RandomText(random, 20, "ab\n");
+			size_t offset = random() % (text.size() + 1);
+			document.Insert(offset, insert);
+			text.insert(offset, insert);
+		}
+		else if (action < 7)
+		{
+			size_t offset = random() % (text.size() + 1);
+			size_t length = random() % 200;
+			document.Erase(offset, length);
+			if (offset < text.size())
+				text.erase(offset, length);
+		}
+		else if (action < 9)
+		{
+			std::string append = RandomText(random, 40, "cd\n");
+			document.Append(TextBuffer::Create(append));
+			text += append;
+		}
+		else
+		{
+			// Edits at the very end of the text
+			document.Insert(text.size(), "\n");
+			text += "\n";
+			document.Erase(text.size() - 1, 1);
+			text.pop_back();
+		}
+
+		if (iteration % 50 == 0 || text.size() < 20)
+			CheckDocument(document, text);
+	}
+	CheckDocument(document, text);
+
+	document.Clear();
+	text.clear();
+	CheckDocument(document, text);
+	document.Append("\n\n");
+	CheckDocument(document, "\n\n");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+// Non-overlapping matches found left to right, like TextSearch does
+static std::vector<size_t> FindReference(const std::string& text, const std::string& pattern, const TextSearchOptions& options, size_t start, size_t end)
+{
+	auto fold = [&](char c) { return !options.match_case && c >= 'A' && c <= 'Z' ? (char)(c + 'a' - 'A') : c; };
+	auto isWord = [](unsigned char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c >= 0x80; };
+
+	std::vector<size_t> matches;
+	size_t pos = start;
+	while (pos < end && pos + pattern.size() <= text.size())
+	{
+		bool found = true;
+		for (size_t i = 0; i < pattern.size() && found; i++)
+			found = fold(text[pos + i]) == fold(pattern[i]);
+		if (found && options.whole_word)
+			found = (pos == 0 || !isWord(text[pos - 1])) && (pos + pattern.size() == text.size() || !isWord(text[pos + pattern.size()]));
+
+		if (found)
+		{
+			matches.push_back(pos);
+			pos += pattern.size();
+		}
+		else
+		{
+			pos++;
+		}
+	}
+	return matches;
+}
+
+static bool SameMatches(const std::vector<TextSearch::Match>& matches, const std::vector<size_t>& expected, size_t length)
+{
+	if (matches.size() != expected.size())
+		return false;
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		if (matches[i].offset != expected[i] || matches[i].length != length)
+			return false;
+	}
+	return true;
+}
+
+static void TestTextSearch()
+{
+	TextDocument empty;
+	CHECK(TextSearch::FindAll(empty.CreateSnapshot(), "a", {}).empty());
+
+	std::mt19937 random(2);
+	const char* patterns[] = { "a", "ab", "aba", "Ab", "a_b", "b a" };
+	for (int iteration = 0; iteration < 300; iteration++)
+	{
+		// Build the text from many small buffers and inserts so that matches cross the spans of the snapshot
+		TextDocument document;
+		std::string text;
+		int pieces = random() % 20;
+		for (int i = 0; i < pieces; i++)
+		{
+			std::string piece = RandomText(random, 6, "aAb_ \n");
+			if (random() % 2)
+			{
+				document.Append(TextBuffer::Create(piece));
+				text += piece;
+			}
+			else
+			{
+				size_t offset = random() % (text.size() + 1);
+				document.Insert(offset, piece);
+				text.insert(offset, piece);
+			}
+		}
+
+		TextSnapshot snapshot = document.CreateSnapshot();
+		std::string pattern = patterns[random() % 6];
+		TextSearchOptions options;
+		options.match_case = random() % 2;
+		options.whole_word = random() % 2;
+
+		CHECK(SameMatches(TextSearch::FindAll(snapshot, pattern, options), FindReference(text, pattern, options, 0, text.size()), pattern.size()));
+
+		size_t start = random() % (text.size() + 1);
+		size_t end = start + random() % (text.size() - start + 1);
+		CHECK(SameMatches(TextSearch::FindRange(snapshot, pattern, options, start, end), FindReference(text, pattern, options, start, end), pattern.size()));
+	}
+
+	// Updating the matches after an edit gives the same matches as searching the whole text again, also for patterns overlapping themselves
+	TextDocument overlapping;
+	overlapping.Append("baaaaaaaaa");
+	std::vector<TextSearch::Match> matches = TextSearch::FindAll(overlapping.CreateSnapshot(), "aa", {});
+	overlapping.Insert(1, "a");
+	TextSearch::UpdateMatches(matches, overlapping.CreateSnapshot(), "aa", {}, 1, 0, 1);
+	CHECK(SameMatches(matches, { 1, 3, 5, 7, 9 }, 2));
+
+	const char* editPatterns[] = { "a", "aa", "aba", "abab", "Ab", "b a" };
+	for (int iteration = 0; iteration < 200; iteration++)
+	{
+		TextDocument document;
+		document.Append(RandomText(random, 200, "aAb_ \n"));
+		std::string pattern = editPatterns[random() % 6];
+		TextSearchOptions options;
+		options.match_case = random() % 2;
+		options.whole_word = random() % 2;
+
+		std::vector<TextSearch::Match> matches = TextSearch::FindAll(document.CreateSnapshot(), pattern, options);
+		for (int i = 0; i < 30; i++)
+		{
+			size_t offset = random() % (document.GetSize() + 1);
+			size_t length = std::min<size_t>(random() % 8, document.GetSize() - offset);
+			std::string inserted = RandomText(random, 6, "aAb_ \n");
+			document.Erase(offset, length);
+			document.Insert(offset, inserted);
+
+			TextSnapshot snapshot = document.CreateSnapshot();
+			TextSearch::UpdateMatches(matches, snapshot, pattern, options, offset, length, inserted.size());
+			std::vector<TextSearch::Match> expected = TextSearch::FindAll(snapshot, pattern, options);
+			std::vector<size_t> offsets;
+			for (const TextSearch::Match& match : expected)
+				offsets.push_back(match.offset);
+			CHECK(SameMatches(matches, offsets, pattern.size()));
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void TestRowHeightIndex()
+{
+	RowHeightIndex index;
+	CHECK(index.GetTotalHeight() == 0.0);
+	CHECK(index.FindRow(0.0) == 0);
+	CHECK(index.FindRow(100.0) == 0);
+
+	// Whole numbers keep the sums exact, so they can be compared with the reference directly
+	std::mt19937 random(3);
+	std::vector<double> heights;
+	for (int iteration = 0; iteration < 3000; iteration++)
+	{
+		int action = random() % 10;
+		if (action < 4)
+		{
+			double height = (double)(random() % 4);
+			index.Append(height);
+			heights.push_back(height);
+		}
+		else if (action < 6)
+		{
+			// Inserting rows rebuilds the tree, appending extends it
+			size_t row = random() % (heights.size() + 1);
+			std::vector<double> rows;
+			for (int i = random() % 5; i > 0; i--)
+				rows.push_back((double)(random() % 30));
+			index.Insert(row, rows);
+			heights.insert(heights.begin() + row, rows.begin(), rows.end());
+		}
+		else if (action < 7 && !heights.empty())
+		{
+			size_t row = random() % heights.size();
+			size_t count = std::min<size_t>(random() % 4, heights.size() - row);
+			index.Remove(row, count);
+			heights.erase(heights.begin() + row, heights.begin() + row + count);
+		}
+		else if (!heights.empty())
+		{
+			size_t row = random() % heights.size();
+			double height = (double)(random() % 30);
+			index.SetHeight(row, height);
+			heights[row] = height;
+		}
+
+		if (iteration % 20 != 0)
+			continue;
+
+		CHECK(index.GetCount() == heights.size());
+		double top = 0.0;
+		for (size_t row = 0; row < heights.size(); row++)
+		{
+			CHECK(index.GetHeight(row) == heights[row]);
+			CHECK(index.GetTop(row) == top);
+			top += heights[row];
+		}
+		CHECK(index.GetTotalHeight() == top);
+
+		// The row containing the position skips rows without any height
+		for (double y = 0.0; y <= top + 2.0; y += 0.5)
+		{
+			size_t expected = 0;
+			double bottom = 0.0;
+			while (expected < heights.size() && bottom + heights[expected] <= y)
+				bottom += heights[expected++];
+			CHECK(index.FindRow(y) == expected);
+		}
+	}
+
+	index.Clear();
+	CHECK(index.GetCount() == 0);
+	CHECK(index.FindRow(5.0) == 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static void ApplyEdit(std::string& text, size_t offset, const std::string& removed, const std::string& inserted)
+{
+	text.replace(offset, removed.size(), inserted);
+}
+
+static void RevertEdit(std::string& text, size_t offset, const std::string& removed, const std::string& inserted)
+{
+	text.replace(offset, inserted.size(), removed);
+}
+
+static void TestUndoJournal()
+{
+	UndoJournal journal;
+	CHECK(!journal.CanUndo());
+	CHECK(!journal.CanRedo());
+	CHECK(journal.Undo() == nullptr);
+	CHECK(journal.Redo() == nullptr);
+
+	// Typing one character at a time is a single step until a new line or EndTyping
+	journal.Record(0, {}, "a", true);
+	journal.Record(1, {}, "b", true);
+	journal.Record(2, {}, "\n", true);
+	journal.Record(3, {}, "c", true);
+	journal.EndTyping();
+	journal.Record(4, {}, "d", true);
+	const UndoJournal::Edit* edit = journal.Undo();
+	CHECK(edit && edit->offset == 4 && edit->inserted == "d");
+	edit = journal.Undo();
+	CHECK(edit && edit->offset == 3 && edit->inserted == "c");
+	edit = journal.Undo();
+	CHECK(edit && edit->offset == 0 && edit->inserted == "ab\n");
+	CHECK(!journal.CanUndo());
+	edit = journal.Redo();
+	CHECK(edit && edit->inserted == "ab\n");
+
+	// Recording after an undo forgets the edits that were undone
+	journal.Record(3, {}, "x");
+	CHECK(!journal.CanRedo());
+
+	// Backspace and delete merge into the removed text
+	journal.Clear();
+	journal.Record(5, "e", {}, true);
+	journal.Record(4, "d", {}, true);
+	journal.Record(4, "f", {}, true);
+	edit = journal.Undo();
+	CHECK(edit && edit->offset == 4 && edit->removed == "def");
+	CHECK(!journal.CanUndo());
+
+	// Edits that are not typing are never merged
+	journal.Clear();
+	journal.Record(0, {}, "a");
+	journal.Record(1, {}, "b");
+	CHECK(journal.Undo() && journal.Undo() && !journal.CanUndo());
+
+	// Undoing all random edits restores the original text and redoing them restores the final text
+	std::mt19937 random(4);
+	for (int round = 0; round < 50; round++)
+	{
+		journal.Clear();
+		std::string original = RandomText(random, 30, "ab\n");
+		std::string text = original;
+		for (int i = 0; i < 100; i++)
+		{
+			if (random() % 8 == 0)
+				journal.EndTyping();
+
+			size_t offset = random() % (text.size() + 1);
+			std::string removed = text.substr(offset, random() % 2 ? 0 : random() % 3);
+			std::string inserted = random() % 2 ? RandomText(random, 2, "ab\n") : std::string();
+			ApplyEdit(text, offset, removed, inserted);
+			journal.Record(offset, removed, inserted, random() % 4 != 0);
+		}
+
+		std::string final = text;
+		while (const UndoJournal::Edit* undo = journal.Undo())
+			RevertEdit(text, undo->offset, undo->removed, undo->inserted);
+		CHECK(text == original);
+		while (const UndoJournal::Edit* redo = journal.Redo())
+			ApplyEdit(text, redo->offset, redo->removed, redo->inserted);
+		CHECK(text == final);
+	}
+
+	// The oldest edits go first when the limit is reached, but the last edit is always kept
+	journal.Clear();
+	journal.SetMemoryLimit(10);
+	journal.Record(0, {}, "0123456789");
+	journal.Record(10, {}, "abc");
+	CHECK(journal.GetMemoryUsage() == 3);
+	CHECK(journal.Undo() && !journal.CanUndo());
+	journal.Record(0, {}, std::string(20, 'x'));
+	CHECK(journal.CanUndo());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+static std::vector<int> FindRowsReference(const std::vector<std::string>& texts, const std::string& pattern, bool matchSubstring)
+{
+	auto fold = [](std::string text)
+	{
+		for (char& c : text)
+		{
+			if (c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+		}
+		return text;
+	};
+
+	std::string needle = fold(pattern);
+	std::vector<int> rows;
+	for (int row = 0; row < (int)texts.size(); row++)
+	{
+		std::string haystack = fold(texts[row]);
+		if (matchSubstring ? haystack.find(needle) != std::string::npos : haystack.compare(0, needle.size(), needle) == 0)
+			rows.push_back(row);
+	}
+	return rows;
+}
+
+static void TestTypeAheadIndex()
+{
+	TypeAheadIndex index;
+	index.Build(0, [](int row) { return std::string(); });
+	CHECK(index.FindAll("a").empty());
+	CHECK(index.FindNext("a", 0) == -1);
+
+	std::mt19937 random(5);
+	for (int round = 0; round < 40; round++)
+	{
+		std::vector<std::string> texts;
+		for (int i = random() % 200; i > 0; i--)
+			texts.push_back(RandomText(random, 8, "abAB c"));
+
+		bool matchSubstring = round % 2 == 1;
+		index.SetMatchSubstring(matchSubstring);
+		index.Build((int)texts.size(), [&](int row) { return texts[row]; });
+
+		for (int i = 0; i < 50; i++)
+		{
+			// Patterns shorter than a trigram, exactly one, and longer
+			std::string pattern = RandomText(random, 5, "abAB c");
+			std::vector<int> expected = FindRowsReference(texts, pattern, matchSubstring);
+			CHECK(index.FindAll(pattern) == expected);
+
+			int start = texts.empty() ? 0 : (int)(random() % texts.size());
+			auto next = std::lower_bound(expected.begin(), expected.end(), start);
+			int expectedNext = expected.empty() ? -1 : next != expected.end() ? *next : expected.front();
+			CHECK(index.FindNext(pattern, start) == expectedNext);
+
+			if (!texts.empty())
+				CHECK(TypeAheadIndex::Matches(texts[start], pattern, matchSubstring) == std::binary_search(expected.begin(), expected.end(), start));
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+	TestTextDocument();
+	TestTextSearch();
+	TestRowHeightIndex();
+	TestUndoJournal();
+	TestTypeAheadIndex();
+
+	if (failures > 0)
+	{
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}